@@ -0,0 +1,56 @@
+/**
+ * @file loader.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief UART chain-loader protocol and memory layout
+ *
+ * The loader is installed as the kernel image. It moves itself up to
+ * LOADER_BASE, waits for a kernel on the console PL011 and runs it from
+ * LOADER_KERNEL_ADDR, where the firmware would have put it.
+ *
+ * Protocol (all words little-endian), host side in scripts/uart_boot.py:
+ * - loader -> host: "rpios-loader: ready <baud>" banner on boot
+ * - host -> loader: LOADER_MAGIC, image size, CRC-32 of the image
+ * - loader -> host: "OK", or "SZ" if the size is 0 or too big
+ * - host -> loader: the image
+ * - loader -> host: "OK" and it jumps to the image, or "CR" (CRC
+ *   mismatch) / "TO" (the line went quiet) and it waits for a new header
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#define LOADER_MAGIC 0x4C425052 /**< "RPBL" */
+
+#define LOADER_KERNEL_ADDR 0x80000 /**< Where the kernel is linked */
+#define LOADER_BASE 0x2000000 /**< Where the loader runs (32 MiB) */
+#define LOADER_MAX_SIZE (LOADER_BASE - LOADER_KERNEL_ADDR)
+
+#define LOADER_TIMEOUT_US 1000000 /**< Max gap between bytes of a transfer */
+
+#ifndef LOADER_BAUD
+#define LOADER_BAUD 921600
+#endif
+
+#define LOADER_REPLY_OK "OK"
+#define LOADER_REPLY_SIZE "SZ"
+#define LOADER_REPLY_CRC "CR"
+#define LOADER_REPLY_TIMEOUT "TO"
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+/**
+ * @brief Run a loaded image (loader boot.S)
+ * @param entry: image entry point
+ * @param dtb: device tree pointer, passed on in x0 as the firmware does
+ *
+ * Invalidates the instruction cache first, as the image was written
+ * through the data side. Does not return.
+ */
+void loader_jump(u64 entry, u64 dtb);
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file loader.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief UART chain-loader (protocol in loader.h)
+ *
+ * Receives a kernel image over the console PL011 and runs it, so a new
+ * build can be tried without rewriting the SD card:
+ *   make loader-deploy             (once)
+ *   make && make uart-boot         (every iteration)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "loader.h"
+#include "crc32.h"
+#include "mailbox.h"
+#include "pl011.h"
+#include "timer.h"
+
+#ifndef CONSOLE_UART
+#define CONSOLE_UART 5
+#endif
+
+#if CONSOLE_UART == 0
+static const uart_gpio loader_gpio = {.tx = 14, .rx = 15, .func = GFAlt0};
+static pl011_uart loader_uart = {.regs = (pl011_regs *)UART0,
+								 .gpio = &loader_gpio};
+#else
+static const uart_gpio loader_gpio = {.tx = 12, .rx = 13, .func = GFAlt4};
+static pl011_uart loader_uart = {.regs = (pl011_regs *)UART5,
+								 .gpio = &loader_gpio};
+#endif
+
+/**
+ * Receive a byte, giving up when the line stays quiet
+ * - Returns the byte, or -1 after timeout ticks without one
+ */
+static int loader_getc(u64 timeout) {
+  u64 start = timer_get_ticks();
+
+  while (!pl011_can_recv(&loader_uart)) {
+	if (timer_get_ticks() - start > timeout) {
+	  return -1;
+	}
+  }
+  return (u8)pl011_recv(&loader_uart);
+}
+
+/**
+ * Receive a little-endian word (*ok = 0 on timeout)
+ */
+static u32 loader_get32(u64 timeout, int *ok) {
+  u32 w = 0;
+  int i, c;
+
+  for (i = 0; i < 4; i++) {
+	c = loader_getc(timeout);
+	if (c < 0) {
+	  *ok = 0;
+	  return 0;
+	}
+	w |= (u32)c << (8 * i);
+  }
+  *ok = 1;
+  return w;
+}
+
+/**
+ * Wait for the magic, sliding a 4-byte window over the input so line
+ * noise and stray keystrokes before the header are skipped
+ */
+static void loader_sync() {
+  u32 window = 0;
+
+  while (window != LOADER_MAGIC) {
+	window = (window >> 8) | ((u32)(u8)pl011_recv(&loader_uart) << 24);
+  }
+}
+
+static void loader_reply(char *reply) {
+  pl011_send_string(&loader_uart, reply);
+  pl011_send(&loader_uart, '\n');
+}
+
+/**
+ * Print an unsigned number (no printf in the loader)
+ */
+static void loader_put_u32(u32 n) {
+  char buf[11];
+  int i = sizeof(buf) - 1;
+
+  buf[i] = 0;
+  do {
+	buf[--i] = '0' + n % 10;
+	n /= 10;
+  } while (n);
+  pl011_send_string(&loader_uart, &buf[i]);
+}
+
+/**
+ * Receive one image
+ * - Read the header and check the size fits below the loader
+ * - Receive the image straight to LOADER_KERNEL_ADDR
+ * - Check the CRC over what was received
+ * - Returns 0 when the image is ready to run
+ */
+static int loader_receive() {
+  u8 *dst = (u8 *)LOADER_KERNEL_ADDR;
+  u64 timeout = LOADER_TIMEOUT_US * timer_get_freq() / USEC_PER_SEC;
+  u32 size, crc = 0, i;
+  int ok, c;
+
+  loader_sync();
+  size = loader_get32(timeout, &ok);
+  if (ok) {
+	crc = loader_get32(timeout, &ok);
+  }
+  if (!ok) {
+	loader_reply(LOADER_REPLY_TIMEOUT);
+	return -1;
+  }
+  if (size == 0 || size > LOADER_MAX_SIZE) {
+	loader_reply(LOADER_REPLY_SIZE);
+	return -1;
+  }
+  loader_reply(LOADER_REPLY_OK);
+
+  for (i = 0; i < size; i++) {
+	c = loader_getc(timeout);
+	if (c < 0) {
+	  loader_reply(LOADER_REPLY_TIMEOUT);
+	  return -1;
+	}
+	dst[i] = c;
+  }
+
+  if (crc32(dst, size) != crc) {
+	loader_reply(LOADER_REPLY_CRC);
+	return -1;
+  }
+  loader_reply(LOADER_REPLY_OK);
+  return 0;
+}
+
+/**
+ * Loader main loop
+ * - Take the UART clock from the firmware and open the console at
+ *   LOADER_BAUD
+ * - Announce ourselves and receive until an image checks out
+ * - Let the reply drain (the kernel reprograms the UART) and jump
+ */
+void loader_main(u64 dtb) {
+  pl011_set_uartclk(mbox_get_clock_rate(MBOX_CLK_UART));
+  pl011_init(&loader_uart, LOADER_BAUD);
+
+  pl011_send_string(&loader_uart, "\nrpios-loader: ready ");
+  loader_put_u32(LOADER_BAUD);
+  pl011_send_string(&loader_uart, "\n");
+
+  while (loader_receive() != 0) {
+	;
+  }
+
+  pl011_wait_idle(&loader_uart);
+  loader_jump(LOADER_KERNEL_ADDR, dtb);
+}
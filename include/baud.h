@@ -0,0 +1,69 @@
+/**
+ * @file baud.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Console baud rate negotiation and detection
+ *
+ * Negotiation (baud_negotiate()), driven by the shell `baud <rate>`:
+ *   1. board: "BAUD <rate>\n" at the current rate, then switches
+ *   2. host:  switches too and sends "OK" at the new rate
+ *   3. board: "BAUD OK <rate>\n" at the new rate; without the "OK"
+ *      within BAUD_ACK_TIMEOUT_US it switches back and prints
+ *      "BAUD FAIL <rate>\n" at the old rate
+ * If the board's output does not drain (CTS held deasserted), it does
+ * not switch and prints "BAUD FAIL <rate> (TX stalled)\n".
+ * scripts/uart_boot.py --console follows it automatically.
+ *
+ * Detection (baud_detect(), `baud auto`): the board prints
+ * "BAUD DETECT\n" and times the low pulses of 'U' (0x55) chars sent by
+ * the host at its rate on the RX pin, read as a GPIO. Every bit of 'U'
+ * framed with its start and stop bits alternates, so each low pulse is
+ * one bit time. Timing is done with the system counter polled with the
+ * GPIO level, which is good for a few hundred kbaud up to about
+ * 1 Mbaud; faster links should negotiate instead.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pl011.h"
+
+#define BAUD_ANNOUNCE "BAUD "
+#define BAUD_ACK "OK"
+#define BAUD_DETECT_ANNOUNCE "BAUD DETECT"
+#define BAUD_DETECT_CHAR 'U'
+
+#define BAUD_ACK_TIMEOUT_US 2000000    /**< Wait for the host's OK */
+#define BAUD_DETECT_TIMEOUT_US 5000000 /**< Wait for the host's 'U's */
+#define BAUD_DETECT_PULSES 32          /**< Low pulses averaged */
+
+/**
+ * @brief Switch the console rate together with the host
+ * @param uart: console UART
+ * @param rate: new rate (bps)
+ * @return 0 if the host followed, -1 if the rate is invalid, the output
+ *         did not drain or the host did not acknowledge (the old rate
+ *         is restored)
+ */
+int baud_negotiate(pl011_uart *uart, u32 rate);
+
+/**
+ * @brief Detect the host's rate and switch to it
+ * @param uart: console UART
+ * @return the new rate, or 0 if the output did not drain or nothing
+ *         usable was received (the rate is unchanged)
+ */
+u32 baud_detect(pl011_uart *uart);
+
+/**
+ * @brief Current console rate (as last set through this module)
+ */
+u32 baud_get_rate();
+
+/**
+ * @brief Record the rate the console was initialized with
+ */
+void baud_set_rate(u32 rate);
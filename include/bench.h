@@ -0,0 +1,75 @@
+/**
+ * @file bench.h
+ * @author Jose Pires
+ * @date 2024-10-16
+ *
+ * @brief Micro-benchmark harness
+ *
+ * Benchmarks are registered with BENCH() into the .bench linker
+ * section. The runner does warm-up rounds, then times BENCH_REPS
+ * repetitions with the PMU cycle counter and the system counter, and
+ * prints one machine-readable line per benchmark on the console:
+ *
+ *   BENCH name=<id> unit=<unit> units=<n> reps=<n> cyc_min=<n>
+ *         cyc_avg=<n> cyc_max=<n> ns_avg=<n> units_per_s=<n>
+ *
+ * framed by "BENCH_BEGIN ..." and "BENCH_END" lines. `make bench`
+ * builds kernel8-bench.img, which runs them all at boot.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pl011.h"
+
+#define BENCH_WARMUP 2 /**< Untimed repetitions */
+#define BENCH_REPS 10 /**< Timed repetitions */
+
+/**
+ * @brief Benchmark descriptor
+ */
+struct bench {
+  const char *name;          /**< Identifier printed in the results */
+  const char *unit;          /**< What run() processes (bytes, ops...) */
+  u32 iters;                 /**< Iterations per repetition */
+  u64 (*run)(u32 iters);     /**< One repetition; returns units processed */
+};
+
+/**
+ * @brief Define and register a benchmark
+ * @param id: identifier (C name)
+ * @param unit_str: unit of the value returned by the body
+ * @param n: iterations per repetition
+ *
+ * Followed by the body of `u64 fn(u32 iters)`:
+ *   BENCH(foo, "ops", 1000) { ...; return iters; }
+ */
+#define BENCH(id, unit_str, n)											\
+  static u64 bench_run_##id(u32 iters);								\
+  static const struct bench bench_##id									\
+  __attribute__((section(".bench"), used, aligned(8))) = {			\
+	.name = #id, .unit = unit_str, .iters = n, .run = bench_run_##id	\
+  };																	\
+  static u64 bench_run_##id(u32 iters)
+
+/**
+ * @brief Run every registered benchmark and print the results
+ * @param uart: console UART, used by the UART benchmarks (may be NULL)
+ */
+void bench_run_all(pl011_uart *uart);
+
+/**
+ * @brief Run the benchmarks whose name matches
+ * @param uart: console UART (may be NULL)
+ * @param name: benchmark name (NULL runs them all)
+ * @return nr of benchmarks run
+ */
+u32 bench_run(pl011_uart *uart, const char *name);
+
+/**
+ * @brief Console UART given to the harness (for the benchmarks)
+ * @return UART, or NULL if the console is not a PL011
+ */
+pl011_uart *bench_uart();
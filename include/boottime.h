@@ -0,0 +1,59 @@
+/**
+ * @file boottime.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Boot phase timing
+ *
+ * The system counter (CNTPCT_EL0) starts at reset, so a counter value
+ * read at the end of each boot phase times everything from power-on:
+ * - firmware:     reset (GPU firmware, armstub) to the first
+ *                 instruction of _start
+ * - el2_to_el1:   the exception level drop in boot.S
+ * - bss_clear:    memzero of the BSS in boot.S
+ * - kernel_entry: stack setup, the identity map and MMU on (mmu.h), and
+ *                 the jump to kernel_main
+ * - then one mark per init step in kernel_main (boot_mark())
+ *
+ * boot.S reads the counter into x19-x21 (kept by memzero) and stores
+ * them in boot_early_ticks once the BSS is clear; boot_time_init()
+ * turns them into the first marks. Marks are recorded by the boot core
+ * only, before the other cores run, so the table is not locked.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+#define BOOT_EARLY_NR 3    /**< Marks taken in boot.S */
+#define BOOT_MARKS_MAX 24
+
+struct boot_mark {
+  const char *phase; /**< Phase ending at this mark */
+  u64 ticks;         /**< System counter at the end of the phase */
+};
+
+/**< Written by boot.S: _start, EL1 entry, BSS cleared */
+extern u64 boot_early_ticks[BOOT_EARLY_NR];
+
+/**
+ * @brief Record the boot.S marks and the kernel_main entry; first call
+ * in kernel_main
+ */
+__cold void boot_time_init();
+
+/**
+ * @brief Record the end of a boot phase (dropped once the table is full)
+ * @param phase: name of the phase that just ended (static string)
+ */
+void boot_mark(const char *phase);
+
+/**
+ * @brief Print the breakdown, one line per phase:
+ *   BOOT phase=<name> us=<duration> end_us=<since reset>
+ * after the kernel_main entry line parsed by scripts/qemu_test.py
+ */
+__cold void boot_report();
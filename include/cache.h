@@ -0,0 +1,80 @@
+/**
+ * @file cache.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Data cache maintenance by address range
+ *
+ * Memory shared with a bus master that does not snoop the ARM caches
+ * (the VideoCore, the DMA engines, the EMMC) has to be handed over
+ * explicitly, to the point of coherency:
+ * - before the device reads it: clean (write dirty lines back)
+ * - before the CPU reads what the device wrote: invalidate (drop stale
+ *   lines)
+ * The line size is read from CTR_EL0 (DminLine), so the same code runs
+ * on the Cortex-A53 and A72. Each operation ends with a DSB, so it is
+ * complete when the call returns.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#ifdef __ASSEMBLER__
+
+/* Data cache maintenance by VA over [\start, \end), to the point of
+ * coherency: \op is cvac (clean), civac (clean and invalidate) or ivac
+ * (invalidate). At least one line is done. Clobbers x9-x11. The loop
+ * label is unique per expansion, so numeric labels around it keep
+ * resolving to the caller's own. */
+.macro dcache_range op, start, end
+    mrs x9, ctr_el0 /* DminLine: log2(words) of the smallest line */
+    ubfx x9, x9, #16, #4
+    mov x10, #4
+    lsl x10, x10, x9 /* line size in bytes */
+    sub x11, x10, #1
+    bic x9, \start, x11 /* first line */
+.Ldcache_range\@:
+    dc \op, x9
+    add x9, x9, x10
+    cmp x9, \end
+    b.lo .Ldcache_range\@
+    dsb sy
+.endm
+
+#else
+
+#include "common.h"
+
+/**
+ * @brief Smallest data cache line, in bytes
+ */
+static inline u32 dcache_line_size() {
+  u64 ctr;
+  asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+  return 4 << ((ctr >> 16) & 0xF);
+}
+
+/**
+ * @brief Write the dirty lines of [start, start + size) back to memory
+ * (before a device reads the range)
+ */
+void dcache_clean_range(const void *start, u64 size);
+
+/**
+ * @brief Drop the lines of [start, start + size) (before the CPU reads
+ * what a device wrote)
+ *
+ * Partial lines at either end are cleaned first, so data sharing those
+ * lines is not lost; buffers given to devices should still be whole
+ * lines (dma.h) or the device's writes to them may be overwritten.
+ */
+void dcache_invalidate_range(const void *start, u64 size);
+
+/**
+ * @brief Clean and drop the lines of [start, start + size) (memory
+ * written by the CPU and then by a device)
+ */
+void dcache_clean_invalidate_range(const void *start, u64 size);
+
+#endif
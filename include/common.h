@@ -11,4 +11,6 @@ typedef uint64_t u64;
 typedef volatile u8 reg8;
 typedef volatile u32 reg32;
 
+#ifndef NULL
 #define NULL ((void*)0)
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file console_link.h
+ * @author Jose Pires
+ * @date 2024-10-20
+ *
+ * @brief Framed console: the console UART carrying link.h frames
+ *
+ * `link on` (shell) switches the console to framed mode: printf output
+ * goes out on the console channel, streamed trace records on the trace
+ * channel, `link send` dumps memory on the bulk channel, and received
+ * chars are read as frames. `link off` goes back to plain text.
+ * scripts/link_demux.py is the host side.
+ *
+ * The console UART itself stays with its driver (kernel.c), which hands
+ * over its raw output and its plain-text handlers at boot.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "link.h"
+#include "sections.h"
+#include "trace.h"
+
+/**
+ * @brief What the framed mode needs from the console driver
+ */
+struct console_link_ops {
+  link_write_fn write;   /**< Raw UART output (no CR before LF) */
+  void (*key)(char c);   /**< Char received on the console channel */
+  void (*printf_init)(); /**< Point printf back at the UART (`link off`) */
+};
+
+/**
+ * @brief Register the console driver; the link starts off
+ * @param ops: driver handlers (kept, not copied)
+ */
+__cold void console_link_init(const struct console_link_ops *ops);
+
+/**
+ * @brief 1 if the console is in framed mode
+ */
+int console_link_active();
+
+/**
+ * @brief Feed a char received in framed mode; console channel payloads
+ * go to the driver's key handler
+ */
+void console_link_input(u8 c);
+
+/**
+ * @brief Trace sink (trace_stream_to()): one record per trace frame
+ */
+void console_link_trace(const struct trace_rec *rec, void *arg);
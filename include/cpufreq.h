@@ -0,0 +1,83 @@
+/**
+ * @file cpufreq.h
+ * @author Jose Pires
+ * @date 2024-10-09
+ *
+ * @brief ARM frequency scaling with a thermal-aware governor
+ *
+ * The governor runs the ARM cores at the highest allowed frequency
+ * while there is work, drops to the minimum after a stretch of idle
+ * time, and lowers the allowed ceiling (cap) as the SoC approaches the
+ * firmware throttling temperature, so the firmware never has to
+ * throttle behind our back.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+#define CPUFREQ_STEP_HZ 100000000U /**< Cap adjustment step (100 MHz) */
+#define CPUFREQ_PERIOD_US 100000U /**< Governor evaluation period (100 ms) */
+#define CPUFREQ_IDLE_PERIODS 10 /**< Idle periods before dropping to min */
+#define CPUFREQ_HOT_MARGIN 5000 /**< Back off this far below the limit (m°C) */
+#define CPUFREQ_COOL_MARGIN 10000 /**< Raise the cap this far below (m°C) */
+
+/**
+ * @brief Initialize the governor
+ *
+ * Query the ARM clock limits and the throttling temperature from the
+ * firmware and start at the maximum frequency
+ */
+__cold void cpufreq_init();
+
+/**
+ * @brief Signal that there is work to do
+ *
+ * Cheap enough to be called on every unit of work (e.g. per byte)
+ */
+void cpufreq_mark_busy();
+
+/**
+ * @brief Run the governor
+ * @return 1 if the ARM frequency was changed, 0 otherwise
+ *
+ * Call it from the main loop; it only evaluates once per
+ * CPUFREQ_PERIOD_US, so calling it often is cheap
+ */
+int cpufreq_update();
+
+/**
+ * @brief Run the governor now (no rate limit), for a periodic timer
+ * event of CPUFREQ_PERIOD_US
+ * @return 1 if the ARM frequency was changed, 0 otherwise
+ */
+int cpufreq_evaluate();
+
+/**
+ * @brief Check if evaluating the governor again would change nothing
+ * @return 1 if idle at the minimum rate with no work seen since the
+ *         last evaluation, 0 otherwise
+ *
+ * The periodic evaluation can stop then, until cpufreq_mark_busy()
+ */
+int cpufreq_settled();
+
+/**
+ * @brief Get the ARM frequency last set by the governor
+ * @return frequency in Hz
+ */
+u32 cpufreq_get_rate();
+
+/**
+ * @brief Get the SoC temperature last sampled by the governor
+ * @return temperature in thousandths of a degree C
+ */
+u32 cpufreq_get_temp();
+
+/**
+ * @brief Print the governor state (frequency, cap, temperature)
+ */
+__cold void cpufreq_report();
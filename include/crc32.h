@@ -0,0 +1,35 @@
+/**
+ * @file crc32.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief CRC-32 (IEEE 802.3, as zlib/Python binascii.crc32)
+ *
+ * Used to check images and frames received over the UART, and to
+ * protect the link.h frames. Table-driven with a 16-entry nibble table
+ * (small enough for the bootloader), or the ARMv8 CRC32 instructions
+ * when the CRC extension is enabled (the kernel).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+/**
+ * @brief Continue a CRC-32 over more data
+ * @param crc: CRC of the data so far (0 to start)
+ * @param buf: data
+ * @param len: nr of bytes
+ * @return CRC of the data so far, including buf
+ */
+u32 crc32_update(u32 crc, const void *buf, u32 len);
+
+/**
+ * @brief CRC-32 of a buffer
+ * @param buf: data
+ * @param len: nr of bytes
+ * @return CRC-32 (crc32("123456789") == 0xCBF43926)
+ */
+u32 crc32(const void *buf, u32 len);
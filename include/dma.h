@@ -0,0 +1,90 @@
+/**
+ * @file dma.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief DMA buffers: allocation, bus addresses and ownership hand-over
+ *
+ * Buffers come from a dedicated page-aligned pool (the .dma section,
+ * see linker.ld), in whole cache lines, so cache maintenance on one
+ * buffer never touches another object. The pool is its own region so
+ * that it can be mapped non-cacheable (MT_NORMAL_NC, mmu.h) once the
+ * kernel maps its image in pages; the identity map (mmu.c) uses 2 MiB
+ * blocks, so it is cacheable for now and ownership is handed over
+ * explicitly:
+ *
+ *   struct dma_buf b;
+ *   dma_alloc(&b, 512);
+ *   ... fill b.cpu ...
+ *   dma_sync_for_device(&b, 0, b.size); // clean
+ *   ... start the transfer with b.bus, wait for it ...
+ *   dma_sync_for_cpu(&b, 0, b.size);    // invalidate
+ *   dma_free(&b);
+ *
+ * Devices see ARM RAM through the VideoCore bus: the first GiB at
+ * DMA_BUS_ALIAS ("C" alias, not cached in the VPU L2).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "mm.h"
+
+#define DMA_BUS_ALIAS 0xC0000000U /**< ARM RAM as seen by bus masters */
+#define DMA_POOL_SIZE (64 * 1024) /**< .dma pool (page multiple) */
+#define DMA_BLOCK 64              /**< Allocation unit: a cache line */
+
+/**
+ * @brief A DMA buffer: the same memory seen by the CPU and by devices
+ */
+struct dma_buf {
+  void *cpu; /**< CPU (physical) address */
+  u32 bus;   /**< Bus address, to program into a device */
+  u32 size;  /**< Size in bytes (whole DMA_BLOCKs) */
+};
+
+/**
+ * @brief Bus address of a CPU address in the first GiB
+ */
+static inline u32 dma_bus_addr(const volatile void *cpu) {
+  return (u32)(u64)cpu | DMA_BUS_ALIAS;
+}
+
+/**
+ * @brief CPU address of a bus address
+ */
+static inline void *dma_cpu_addr(u32 bus) {
+  return (void *)(u64)(bus & ~DMA_BUS_ALIAS);
+}
+
+/**
+ * @brief Allocate a buffer from the DMA pool
+ * @param buf: filled in on success
+ * @param size: bytes (rounded up to whole DMA_BLOCKs)
+ * @return 0, or -1 if the pool has no free run that large
+ */
+int dma_alloc(struct dma_buf *buf, u32 size);
+
+/**
+ * @brief Give a buffer back to the pool
+ */
+void dma_free(struct dma_buf *buf);
+
+/**
+ * @brief Hand [off, off + len) of a buffer to the device (clean)
+ */
+void dma_sync_for_device(const struct dma_buf *buf, u32 off, u32 len);
+
+/**
+ * @brief Take [off, off + len) of a buffer back from the device
+ * (invalidate)
+ */
+void dma_sync_for_cpu(const struct dma_buf *buf, u32 off, u32 len);
+
+/**
+ * @brief Free bytes in the pool, and the largest free run
+ */
+u32 dma_pool_free();
+u32 dma_pool_largest();
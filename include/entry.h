@@ -0,0 +1,58 @@
+/**
+ * @file entry.h
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief Exception entry definitions
+ *
+ * Layout of the register frame saved by kernel_entry (entry.S), shared
+ * between the assembly and the C handlers
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#define S_FRAME_SIZE 272 /**< x0-x30, ELR, SPSR (16-byte aligned) */
+#define S_X30 240 /**< Offset of x30 */
+#define S_ELR 248 /**< Offset of ELR_EL1 */
+#define S_SPSR 256 /**< Offset of SPSR_EL1 */
+
+/**
+ * Vector table entry types (index in the table)
+ */
+#define SYNC_INVALID_EL1t 0
+#define IRQ_INVALID_EL1t 1
+#define FIQ_INVALID_EL1t 2
+#define ERROR_INVALID_EL1t 3
+
+#define SYNC_INVALID_EL1h 4
+#define IRQ_INVALID_EL1h 5
+#define FIQ_INVALID_EL1h 6
+#define ERROR_INVALID_EL1h 7
+
+#define SYNC_INVALID_EL0_64 8
+#define IRQ_INVALID_EL0_64 9
+#define FIQ_INVALID_EL0_64 10
+#define ERROR_INVALID_EL0_64 11
+
+#define SYNC_INVALID_EL0_32 12
+#define IRQ_INVALID_EL0_32 13
+#define FIQ_INVALID_EL0_32 14
+#define ERROR_INVALID_EL0_32 15
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+/**
+ * @brief Registers of the interrupted context
+ */
+struct pt_regs {
+  u64 regs[31]; /**< x0 - x30 */
+  u64 elr;      /**< Return address (ELR_EL1) */
+  u64 spsr;     /**< Saved PSTATE (SPSR_EL1) */
+  u64 pad;      /**< Keep the frame 16-byte aligned */
+};
+
+#endif
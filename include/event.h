@@ -0,0 +1,94 @@
+/**
+ * @file event.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Run-to-completion event loop and deferred work
+ *
+ * IRQ handlers only do what cannot wait (acknowledge, mask the source,
+ * grab the data the hardware would otherwise lose) and queue a work
+ * item; the rest runs later from event_loop(), with IRQs unmasked, on
+ * the core the work was queued to:
+ *
+ *   static void rx_work(void *arg) { ...drain the FIFO... }
+ *   static struct work rx = WORK_INIT(rx_work, NULL);
+ *
+ *   static void rx_irq(void *arg, struct pt_regs *regs) {
+ *     ...mask RX...
+ *     work_queue(&rx);
+ *   }
+ *
+ * A work item is queued at most once: queueing it again before it runs
+ * is a no-op, so a burst of interrupts costs one run. Items queued while
+ * it runs (including by itself) run again in the next batch.
+ *
+ * Event sources built on this:
+ * - timer expiry: struct timer_event (timer.h)
+ * - GPIO edges: event_gpio()
+ * - console RX: the UART interrupt queues the console work (kernel.c,
+ *   serial_set_rx_work())
+ * - jobs posted with smp_run() to a secondary core (smp.h)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "gpio.h"
+#include "sections.h"
+
+/**
+ * @brief Deferred work function
+ * @param arg: argument given to WORK_INIT()
+ */
+typedef void (*work_fn)(void *arg);
+
+/**
+ * @brief Work item; statically allocated by its owner
+ */
+struct work {
+  work_fn fn;
+  void *arg;
+  struct work *next; /**< Queue link */
+  u32 pending;       /**< 1 from queued until it starts running */
+};
+
+#define WORK_INIT(f, a) { .fn = (f), .arg = (a) }
+
+/**
+ * @brief Queue a work item on the calling core
+ * @param w: work item
+ * @return 0 if queued, 1 if it was already pending
+ *
+ * Lock-free: may be called from IRQ handlers and with IRQs masked
+ */
+int work_queue(struct work *w);
+
+/**
+ * @brief Queue a work item on another core and wake it up
+ * @param core: core id (the core must be running event_loop())
+ * @param w: work item
+ * @return 0 if queued, 1 if it was already pending
+ */
+int work_queue_on(u32 core, struct work *w);
+
+/**
+ * @brief Run the calling core's work forever
+ *
+ * Each pass takes everything queued so far as one batch and runs it in
+ * the order queued. With nothing queued the core sleeps in WFI until an
+ * interrupt; the check and the WFI run with IRQs masked, so an item
+ * queued by an interrupt in between is not slept on (a pending IRQ
+ * wakes WFI even when masked).
+ */
+void event_loop() __attribute__((noreturn));
+
+/**
+ * @brief Queue a work item on the edges of a GPIO pin
+ * @param pin: pin number (0-53), already set up as an input
+ * @param edges: GPIO_EDGE_RISING and/or GPIO_EDGE_FALLING (0 stops)
+ * @param w: queued on the calling core on each detected edge
+ * @return 0, or -1 if the pin is out of range
+ */
+int event_gpio(u8 pin, u32 edges, struct work *w);
@@ -0,0 +1,63 @@
+/**
+ * @file fdt.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Read-only flattened device tree (DTB) access
+ *
+ * The firmware passes the address of the DTB it loaded (and patched:
+ * memory, command line, initramfs location) in x0 at the kernel entry;
+ * boot.S hands it to kernel_main(). Only lookups are supported: walk
+ * the structure block for a node path and return a pointer to the
+ * property value inside the blob, nothing is copied.
+ *
+ * Every field is big endian and only 4-byte aligned, so all reads are
+ * done byte by byte; the same parser runs in the host tests.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+#define FDT_MAGIC 0xD00DFEED
+#define FDT_MAX_DEPTH 16 /**< Deepest node path looked up */
+
+/**
+ * @brief Check a DTB header
+ * @param fdt: blob
+ * @return 0 if it looks valid (magic, version, block offsets), -1
+ *         otherwise
+ */
+int fdt_check(const void *fdt);
+
+/**
+ * @brief Total size of a DTB
+ * @param fdt: blob, checked with fdt_check()
+ * @return size in bytes
+ */
+u32 fdt_size(const void *fdt);
+
+/**
+ * @brief Find a property
+ * @param fdt: blob, checked with fdt_check()
+ * @param path: absolute node path ("/chosen"); a component without a
+ *        unit address also matches "name@unit"
+ * @param name: property name ("linux,initrd-start")
+ * @param len: value length, if not NULL
+ * @return pointer to the value in the blob, or NULL if not found
+ */
+const void *fdt_getprop(const void *fdt, const char *path, const char *name,
+						u32 *len);
+
+/**
+ * @brief Read a property as a number
+ * @param fdt: blob, checked with fdt_check()
+ * @param path: absolute node path
+ * @param name: property name
+ * @param val: the value (one or two big endian cells)
+ * @return 0, or -1 if the property is missing or not 4 or 8 bytes long
+ */
+int fdt_getprop_u64(const void *fdt, const char *path, const char *name,
+					u64 *val);
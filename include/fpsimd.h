@@ -0,0 +1,69 @@
+/**
+ * @file fpsimd.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Lazy FP/SIMD (NEON) context handling
+ *
+ * The kernel is built with -mgeneral-regs-only, so the compiler never
+ * touches the V-registers on its own. The files listed in NEON_FILES in
+ * the Makefile are built without it and may use FP/SIMD freely; this
+ * module keeps their registers consistent without saving anything on
+ * the paths that do not use them.
+ *
+ * Each core runs one thread context (kernel_main/event_loop, or the
+ * secondary job loop) and IRQ handlers, which do not nest. FP/SIMD
+ * starts disabled (CPACR_EL1.FPEN traps):
+ * - thread context: the first use traps once, FP/SIMD is enabled and
+ *   stays enabled
+ * - IRQ entry: if the thread has live FP/SIMD state, disable it (one
+ *   CPACR write); a handler that uses it traps, and the trap saves the
+ *   thread's registers before enabling it
+ * - IRQ exit: if they were saved, restore them; give the thread back
+ *   its CPACR setting
+ *
+ * An IRQ that does not use FP/SIMD pays two CPACR writes at most; the
+ * 528-byte save/restore only happens when a handler did use it.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+/**
+ * @brief V-registers and their control/status
+ */
+struct fpsimd_state {
+  u64 vregs[64]; /**< q0 - q31 */
+  u32 fpsr;
+  u32 fpcr;
+} __attribute__((aligned(16)));
+
+/**
+ * @brief Disable FP/SIMD on the calling core until its first use
+ *
+ * Called by every core after its vector table is installed, before any
+ * NEON_FILES code runs on it
+ */
+__cold void fpsimd_init_cpu();
+
+/**
+ * @brief FP/SIMD access trap (ESR_EL1.EC 0x07), from handle_sync()
+ */
+void fpsimd_trap();
+
+/**
+ * @brief IRQ entry/exit hooks (entry.S, around handle_irq())
+ */
+__hot void fpsimd_irq_enter();
+__hot void fpsimd_irq_exit();
+
+/**
+ * @brief Store/load the V-registers, FPSR and FPCR (fpsimd.S); FP/SIMD
+ * must be enabled
+ */
+void fpsimd_save(struct fpsimd_state *state);
+void fpsimd_load(const struct fpsimd_state *state);
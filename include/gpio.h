@@ -41,6 +41,9 @@ typedef enum _GpioPUD {
   GPUD_PullUp = 0b10, /**< Enable Pull Up control */
 } GpioPUD;
 
+#define GPIO_EDGE_RISING 1  /**< Detect low to high transitions */
+#define GPIO_EDGE_FALLING 2 /**< Detect high to low transitions */
+
 /**
  * @brief Set the GPIO Pin function
  * @param pinNumber: pin number to set function (0-54)
@@ -58,3 +61,27 @@ void gpio_pin_set_func(u8 pinNumber, GpioFunc func);
  * Enable the GPIO clock
  */
 void gpio_pin_enable(u8 pinNumber);
+
+/**
+ * @brief Read the level of a GPIO pin (GPLEVn)
+ * @param pinNumber: pin to read (0-54)
+ * @return 1 if high, 0 if low
+ */
+u32 gpio_pin_read(u8 pinNumber);
+
+/**
+ * @brief Select the edges latched in the pin's event detect status
+ * @param pinNumber: pin (0-53)
+ * @param edges: GPIO_EDGE_RISING and/or GPIO_EDGE_FALLING (0: none)
+ *
+ * The GPIO interrupt of the pin's bank is raised while its status is set
+ */
+void gpio_pin_set_edge(u8 pinNumber, u32 edges);
+
+/**
+ * @brief Take the latched events of a bank (GPEDSn): read, then clear
+ * what was read (write 1 to clear)
+ * @param bank: 0 (pins 0-31) or 1 (pins 32-53)
+ * @return pins with an event, bit n = pin 32 * bank + n
+ */
+u32 gpio_events_take(u8 bank);
@@ -0,0 +1,39 @@
+/**
+ * @file idle.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Tickless idle with wake-up latency accounting
+ *
+ * A core with nothing queued sleeps in WFI (event_loop()). There is no
+ * periodic tick: the only timer wake-up is the earliest armed timer
+ * event (timer.h), programmed one-shot, and the other wake-ups are the
+ * interrupts of the event sources (UART RX, GPIO, IPIs). Periodic users
+ * stop their timer event when they have nothing left to do.
+ *
+ * Every sleep is accounted per core: time asleep (residency) and, when
+ * the timer ends it, the wake-up latency, from the programmed deadline
+ * to the first instruction after WFI. That is the cost the tickless
+ * sleep adds to a deadline (interrupt delivery plus leaving the
+ * low-power state), before the handler itself runs.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+/**
+ * @brief Sleep until an interrupt
+ *
+ * Called with IRQs masked, after the caller found nothing to do; the
+ * interrupt that ends the sleep is taken once the caller unmasks them
+ */
+__hot void idle_enter();
+
+/**
+ * @brief Clear the calling core's idle statistics
+ */
+void idle_reset();
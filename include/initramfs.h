@@ -0,0 +1,97 @@
+/**
+ * @file initramfs.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Read-only files from the initramfs the firmware loaded
+ *
+ * `initramfs <file> <address>` in config.txt makes the firmware load an
+ * archive at that address and record where in the device tree
+ * (/chosen linux,initrd-start and linux,initrd-end, see fdt.h). At boot
+ * the archive is indexed once: one hash table entry per regular file,
+ * pointing at its name and data inside the blob. Lookups hash the path
+ * and return those pointers; nothing is copied or parsed per access.
+ *
+ * Formats: cpio "newc" (`find . | cpio -o -H newc`, as built by
+ * `make initramfs`) and POSIX ustar. Directories, links and devices are
+ * not indexed; neither are tar names longer than 100 chars (prefix
+ * field). When a path appears twice, the later entry wins (an archive
+ * can be appended to).
+ *
+ * Where to load it (config.txt uses 0x8000000, 128 MiB):
+ * - above the kernel image, its BSS and the stacks (_end, LOW_MEMORY);
+ *   the firmware's `followkernel` puts it right after the image, where
+ *   the BSS clear overwrites it
+ * - above the UART chain-loader (bootloader/include/loader.h), which
+ *   moves itself to LOADER_BASE (0x2000000) with its BSS and 64 KiB
+ *   stack after it, and overwrites an archive loaded there
+ * - above the compressed kernel stub (make COMPRESS=y), which copies
+ *   itself and the compressed kernel to ZBOOT_BASE (0x4000000,
+ *   zboot/include/zboot.h) and puts its BSS (translation tables) and
+ *   16 KiB stack after them; the kernel is at most ZBOOT_MAX_SIZE, so
+ *   all of it is below 128 MiB
+ * - within the first GiB, the RAM the kernel maps Normal (mmu.c)
+ *
+ * The data of a file is 4-byte aligned in a cpio archive, 512-byte
+ * aligned in a tar one.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+#define INITRAMFS_MAX_FILES 256 /**< Files indexed, the rest are skipped */
+#define INITRAMFS_HASH_SIZE 512 /**< Index slots (power of 2, 2x the files) */
+
+/**
+ * @brief Indexed file; points into the archive
+ */
+struct file {
+  const char *name; /**< Path without a leading "./" or "/"; not always
+					   NUL-terminated (tar), use name_len */
+  u32 name_len;
+  u32 hash;         /**< FNV-1a of the name */
+  const u8 *data;
+  u64 size;
+};
+
+/**
+ * @brief Index an archive in memory
+ * @param base: archive
+ * @param size: archive size in bytes
+ * @return nr of files indexed, or -1 if the format is not recognized
+ *
+ * Replaces any previous index. The archive must stay in place and
+ * unchanged while files are used.
+ */
+__cold int initramfs_init(const void *base, u64 size);
+
+/**
+ * @brief Look up a file
+ * @param path: path in the archive (a leading "/" or "./" is ignored)
+ * @return the file, or NULL if it is not in the index
+ */
+const struct file *file_open(const char *path);
+
+/**
+ * @brief Look up a file and get its contents
+ * @param path: path in the archive
+ * @param size: file size, if not NULL
+ * @return pointer to the data in the archive, or NULL if not found
+ */
+const void *file_map(const char *path, u64 *size);
+
+/**
+ * @brief Nr of files indexed
+ */
+u32 initramfs_count();
+
+/**
+ * @brief Get an indexed file by position (archive order)
+ * @param i: 0 - initramfs_count()-1
+ * @return the file, or NULL if i is out of range
+ */
+const struct file *initramfs_file(u32 i);
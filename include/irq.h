@@ -0,0 +1,122 @@
+/**
+ * @file irq.h
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief Interrupt handling interface
+ *
+ * Exception vectors plus a small dispatcher on top of the interrupt
+ * controller (GIC-400 on the RPi 4, ARM-local + BCM2835 controller on
+ * the RPi 3). Handlers run with IRQs masked.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "entry.h"
+#include "peripherals/irq.h"
+#include "sections.h"
+
+/**
+ * @brief IRQ handler
+ * @param arg: argument given to irq_register()
+ * @param regs: registers of the interrupted context
+ */
+typedef void (*irq_handler)(void *arg, struct pt_regs *regs);
+
+/**
+ * @brief Install the vector table and set up the interrupt controller
+ *
+ * Called once, by the boot core. IRQs stay masked on the core.
+ */
+__cold void irq_init();
+
+/**
+ * @brief Set up the per-core parts (vector table, GIC CPU interface)
+ *
+ * Called by every core, including the boot core (irq_init() does it)
+ */
+__cold void irq_init_cpu();
+
+/**
+ * @brief Install a handler for an IRQ
+ * @param irq: IRQ number (IRQ_*)
+ * @param fn: handler (NULL removes it)
+ * @param arg: passed to the handler
+ */
+void irq_register(u32 irq, irq_handler fn, void *arg);
+
+/**
+ * @brief Unmask an IRQ in the controller, routed to the calling core
+ * @param irq: IRQ number (IRQ_*)
+ */
+void irq_enable(u32 irq);
+
+/**
+ * @brief Mask an IRQ in the controller
+ * @param irq: IRQ number (IRQ_*)
+ */
+void irq_disable(u32 irq);
+
+/**
+ * @brief Raise IRQ_IPI on a core (it must have it enabled)
+ * @param core: target core id
+ *
+ * RPi 4: SGI through the GIC distributor; RPi 3: write-set of the
+ * target's ARM-local mailbox 0. Memory written before the call is
+ * visible to the target's handler.
+ */
+void irq_send_ipi(u32 core);
+
+/**
+ * @brief Acknowledge IRQ_IPI on the calling core (first thing in its
+ * handler)
+ */
+void irq_ack_ipi();
+
+/**
+ * @brief Dispatch the pending IRQs (called from the vector table)
+ * @param regs: registers of the interrupted context
+ */
+__hot void handle_irq(struct pt_regs *regs);
+
+/**
+ * @brief Handle a synchronous exception taken at EL1 (called from the
+ * vector table): FP/SIMD access traps; anything else hangs the core
+ * @param regs: registers of the interrupted context
+ */
+void handle_sync(struct pt_regs *regs);
+
+/**
+ * @brief Unmask IRQs on the calling core
+ */
+static inline void irq_local_enable() {
+  asm volatile("msr daifclr, #2" ::: "memory");
+}
+
+/**
+ * @brief Mask IRQs on the calling core
+ */
+static inline void irq_local_disable() {
+  asm volatile("msr daifset, #2" ::: "memory");
+}
+
+/**
+ * @brief Mask IRQs on the calling core and return the previous state
+ * @return DAIF flags to give back to irq_local_restore()
+ */
+static inline u64 irq_local_save() {
+  u64 flags;
+  asm volatile("mrs %0, daif\n\tmsr daifset, #2" : "=r"(flags) :: "memory");
+  return flags;
+}
+
+/**
+ * @brief Restore the IRQ mask saved by irq_local_save()
+ * @param flags: DAIF flags
+ */
+static inline void irq_local_restore(u64 flags) {
+  asm volatile("msr daif, %0" :: "r"(flags) : "memory");
+}
@@ -0,0 +1,146 @@
+/**
+ * @file link.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Multiplexed framed transport over a byte link (the console UART)
+ *
+ * Several streams (console text, trace records, bulk data) share the
+ * link as frames:
+ *
+ *   0x00 COBS( chan | seq | payload (0 - LINK_MTU bytes) | CRC-32 LE ) 0x00
+ *
+ * COBS removes every 0x00 from the frame, so 0x00 only ever delimits
+ * frames: a receiver resynchronizes on the leading one after any
+ * garbage and a frame is never mixed with another (empty frames between
+ * two delimiters are ignored). The CRC-32 (crc32.h) covers chan, seq and
+ * the payload; corrupt frames are dropped.
+ *
+ * Every frame sent takes the next sequence number (mod 256) and is kept
+ * in a history of the last LINK_HISTORY frames. The receiver finds lost
+ * or corrupt frames as gaps in the sequence and asks for them with a
+ * NAK on the control channel; the frame is sent again with its original
+ * seq, or answered with LOST if it has left the history. The sender
+ * never waits for the receiver, so the link runs at full rate.
+ *
+ * Frames from the host carry a seq too, but are not retransmitted
+ * (keystrokes and control). scripts/link_demux.py is the host side.
+ *
+ * Not thread-safe: callers serialize link_send() and link_input().
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+#define LINK_MTU 248 /**< Max payload per frame */
+#define LINK_HDR 2   /**< chan, seq */
+#define LINK_CRC 4   /**< CRC-32, little endian */
+#define LINK_FRAME_MAX (LINK_HDR + LINK_MTU + LINK_CRC) /**< 254: 1 COBS block */
+#define LINK_ENC_MAX (LINK_FRAME_MAX + LINK_FRAME_MAX / 254 + 1)
+#define LINK_HISTORY 16 /**< Frames kept for retransmission (power of 2) */
+
+/**
+ * @brief Channel ids
+ */
+enum link_chan {
+  LINK_CH_CTL,     /**< Control: NAK/LOST */
+  LINK_CH_CONSOLE, /**< Console text (both ways) */
+  LINK_CH_TRACE,   /**< struct trace_rec, one per frame */
+  LINK_CH_BULK,    /**< Raw data */
+  LINK_CH_NR
+};
+
+/**
+ * @brief Control channel payload: type, then the seq it refers to
+ */
+enum link_ctl {
+  LINK_CTL_NAK = 1,  /**< host: send seq again */
+  LINK_CTL_LOST = 2, /**< board: seq is no longer in the history */
+};
+
+/**
+ * @brief Output of the encoded frames
+ * @param arg: argument given to link_init()
+ * @param buf: bytes to send, in order, untranslated
+ * @param len: nr of bytes
+ */
+typedef void (*link_write_fn)(void *arg, const u8 *buf, u32 len);
+
+/**
+ * @brief Data frame received by link_input()
+ */
+struct link_frame {
+  u32 chan;
+  u32 seq;
+  const u8 *data; /**< Valid until the next link_input() */
+  u32 len;
+};
+
+/**
+ * @brief Frame kept for retransmission (len 0: empty)
+ */
+struct link_hist {
+  u32 len;
+  u8 frame[LINK_FRAME_MAX];
+};
+
+struct link {
+  link_write_fn write;
+  void *arg;
+  u8 seq;                                 /**< Next seq to send */
+  struct link_hist hist[LINK_HISTORY];    /**< [seq % LINK_HISTORY] */
+  u8 tx_enc[LINK_ENC_MAX + 2];            /**< Encoded frame + delimiters */
+  u8 rx_enc[LINK_ENC_MAX];                /**< Encoded bytes received */
+  u32 rx_len;                             /**< LINK_ENC_MAX + 1: overflow */
+  u8 rx_frame[LINK_ENC_MAX];              /**< Decoded frame */
+  u32 tx_frames, rx_frames, rx_bad, retransmits, lost;
+};
+
+/**
+ * @brief COBS-encode a buffer
+ * @param src: data
+ * @param len: nr of bytes
+ * @param dst: output, room for len + len / 254 + 1 bytes
+ * @return nr of bytes written (no 0x00 among them; no delimiter added)
+ */
+u32 cobs_encode(const u8 *src, u32 len, u8 *dst);
+
+/**
+ * @brief Decode a COBS block (without the delimiter)
+ * @param src: encoded data
+ * @param len: nr of bytes
+ * @param dst: output, room for len bytes
+ * @return nr of bytes decoded, or -1 if src is not valid COBS
+ */
+int cobs_decode(const u8 *src, u32 len, u8 *dst);
+
+/**
+ * @brief Start a link: seq 0, empty history
+ * @param l: link
+ * @param write: output of the encoded frames
+ * @param arg: passed to write
+ */
+void link_init(struct link *l, link_write_fn write, void *arg);
+
+/**
+ * @brief Send data on a channel, in frames of up to LINK_MTU bytes
+ * @param l: link
+ * @param chan: channel (enum link_chan)
+ * @param buf: data
+ * @param len: nr of bytes (0 sends one empty frame)
+ * @return 0, or -1 if the channel is invalid
+ */
+int link_send(struct link *l, u32 chan, const void *buf, u32 len);
+
+/**
+ * @brief Feed one received byte
+ * @param l: link
+ * @param c: byte
+ * @param f: the frame, when one completes
+ * @return 1 if f holds a data frame, 0 otherwise (more bytes needed, a
+ *         corrupt frame was dropped, or a control frame was handled)
+ */
+int link_input(struct link *l, u8 c, struct link_frame *f);
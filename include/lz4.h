@@ -0,0 +1,40 @@
+/**
+ * @file lz4.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief LZ4 block decompression and the compressed kernel format
+ *
+ * A compressed kernel (make COMPRESS=y) is a struct lz4_image: this
+ * header followed by one LZ4 block (lz4.org block format), produced by
+ * tools/lz4pack from kernel8.img and unpacked by the stub in zboot/.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+#define LZ4_IMAGE_MAGIC 0x4B345A4C /**< "LZ4K" */
+
+/**
+ * @brief Compressed image header (little-endian)
+ */
+struct lz4_image {
+  u32 magic; /**< LZ4_IMAGE_MAGIC */
+  u32 raw_size; /**< Size of the uncompressed image */
+  u32 comp_size; /**< Size of the LZ4 block that follows */
+  u32 reserved; /**< 0; keeps the block 16-byte aligned */
+};
+
+/**
+ * @brief Decompress one LZ4 block
+ * @param src: compressed block
+ * @param src_len: size of the compressed block
+ * @param dst: output buffer
+ * @param dst_cap: size of the output buffer
+ * @return nr of bytes written, or -1 if the block is malformed or does
+ *         not fit in dst_cap
+ */
+int lz4_decompress(const u8 *src, u32 src_len, u8 *dst, u32 dst_cap);
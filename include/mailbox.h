@@ -0,0 +1,102 @@
+/**
+ * @file mailbox.h
+ * @author Jose Pires
+ * @date 2024-10-07
+ *
+ * @brief VideoCore mailbox property interface
+ *
+ * Talk to the firmware through the property channel (8) to query and
+ * change clocks, and to get the board information (revision, memory)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "peripherals/mailbox.h"
+
+/**
+ * @brief Firmware clock identifiers
+ *
+ * Clock IDs as defined by the mailbox property interface
+ */
+typedef enum _MboxClock {
+  MBOX_CLK_EMMC  = 1,  /**< EMMC */
+  MBOX_CLK_UART  = 2,  /**< UART (PL011 UARTCLK) */
+  MBOX_CLK_ARM   = 3,  /**< ARM cores */
+  MBOX_CLK_CORE  = 4,  /**< VPU core (Mini-UART clock) */
+  MBOX_CLK_V3D   = 5,  /**< V3D */
+  MBOX_CLK_H264  = 6,  /**< H264 */
+  MBOX_CLK_ISP   = 7,  /**< ISP */
+  MBOX_CLK_SDRAM = 8,  /**< SDRAM */
+  MBOX_CLK_PIXEL = 9,  /**< Pixel */
+  MBOX_CLK_PWM   = 10, /**< PWM */
+  MBOX_CLK_EMMC2 = 12, /**< EMMC2 (RPi 4) */
+} MboxClock;
+
+/**
+ * @brief Send a property buffer to the firmware and wait for the reply
+ * @param buf: 16-byte aligned property buffer (buf[0] holds its size),
+ *        in the first GiB; best in whole cache lines (dma.h)
+ * @return 1 if the firmware processed the request, 0 otherwise
+ *
+ * The buffer is overwritten in place with the response; caches are
+ * maintained around the exchange
+ */
+int mbox_property(volatile u32 *buf);
+
+/**
+ * @brief Get the current rate of a clock
+ * @param clk: clock id
+ * @return rate in Hz (0 on failure)
+ */
+u32 mbox_get_clock_rate(MboxClock clk);
+
+/**
+ * @brief Get the maximum rate of a clock
+ * @param clk: clock id
+ * @return rate in Hz (0 on failure)
+ */
+u32 mbox_get_max_clock_rate(MboxClock clk);
+
+/**
+ * @brief Get the minimum rate of a clock
+ * @param clk: clock id
+ * @return rate in Hz (0 on failure)
+ */
+u32 mbox_get_min_clock_rate(MboxClock clk);
+
+/**
+ * @brief Set the rate of a clock
+ * @param clk: clock id
+ * @param hz: requested rate in Hz
+ * @return rate actually set by the firmware in Hz (0 on failure)
+ */
+u32 mbox_set_clock_rate(MboxClock clk, u32 hz);
+
+/**
+ * @brief Get the board revision code
+ * @return board revision (0 on failure)
+ */
+u32 mbox_get_board_revision();
+
+/**
+ * @brief Get the memory split assigned to the ARM cores
+ * @param base: where to store the base address [out]
+ * @param size: where to store the size in bytes [out]
+ * @return 1 on success, 0 on failure
+ */
+int mbox_get_arm_memory(u32 *base, u32 *size);
+
+/**
+ * @brief Get the SoC temperature
+ * @return temperature in thousandths of a degree C (0 on failure)
+ */
+u32 mbox_get_temperature();
+
+/**
+ * @brief Get the temperature at which the firmware starts throttling
+ * @return temperature in thousandths of a degree C (0 on failure)
+ */
+u32 mbox_get_max_temperature();
@@ -13,6 +13,16 @@
 
 #pragma once
 
+#include "common.h"
+
+/**
+ * @brief Set the core clock the Mini UART baudrate is derived from
+ * @param hz: VPU core clock in Hz (e.g. from the firmware mailbox)
+ *
+ * Call it before uart_init(); the Mini UART follows the core clock
+ */
+void uart_set_sysclk(u32 hz);
+
 /**
  * @brief Initialize the Mini UART
  *
@@ -28,6 +38,21 @@ void uart_init();
  */
 char uart_recv();
 
+/**
+ * @brief Check if a character can be read without blocking
+ * @return 1 if data is available, 0 otherwise
+ */
+int uart_can_recv();
+
+/**
+ * @brief Unmask or mask the receive interrupt (IRQ_AUX)
+ * @param on: 1 to unmask, 0 to mask
+ *
+ * Same use as pl011_rx_irq(): the handler masks RX and hands over to
+ * code that drains the FIFO and unmasks it again
+ */
+void uart_rx_irq(int on);
+
 /**
  * @brief Send a character via UART
  * @param c: character to send
@@ -20,6 +20,8 @@
 
 #define LOW_MEMORY (2 * SECTION_SIZE)
 
+#define CORE_STACK_SIZE (64 * 1024) /**< Stack per core, below LOW_MEMORY */
+
 /**< Make sure the functions below are only included in C compilations */
 #ifndef __ASSEMBLER__
 
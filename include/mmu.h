@@ -0,0 +1,104 @@
+/**
+ * @file mmu.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief MMU translation table and attribute definitions
+ *
+ * 4 KiB granule, 32-bit (4 GiB) address space: translation starts at
+ * level 1 (1 GiB blocks); level 2 tables map 2 MiB blocks.
+ * See ARM ARM, D8: The AArch64 Virtual Memory System Architecture.
+ *
+ * Used by the zboot stub (at EL2, while it unpacks) and by the kernel,
+ * which runs with the MMU and caches on from boot.S onwards (mmu.c).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "mm.h"
+
+/**
+ * Descriptors
+ */
+#define MM_TYPE_TABLE 0x3 /**< Next-level table */
+#define MM_TYPE_BLOCK 0x1 /**< Block (1 GiB at level 1, 2 MiB at level 2) */
+#define MM_ATTRINDX(n) ((n) << 2) /**< MAIR attribute index */
+#define MM_SH_INNER (3 << 8) /**< Inner shareable */
+#define MM_ACCESS (1 << 10) /**< Access flag (no access faults) */
+
+#define MM_ENTRIES (1 << TABLE_SHIFT) /**< Descriptors per table */
+#define MM_L1_SHIFT 30 /**< 1 GiB per level 1 entry */
+#define MM_L2_SHIFT SECTION_SHIFT /**< 2 MiB per level 2 entry */
+
+/**
+ * MAIR_ELx, Memory Attribute Indirection Register
+ */
+#define MT_DEVICE_nGnRnE 0 /**< Attribute index: peripherals */
+#define MT_NORMAL 1 /**< Attribute index: RAM, write-back cacheable */
+#define MT_NORMAL_NC 2 /**< Attribute index: RAM, non-cacheable (DMA pool) */
+#define MT_DEVICE_nGnRnE_FLAGS 0x00
+#define MT_NORMAL_FLAGS 0xFF /**< Inner/outer WB, read/write allocate */
+#define MT_NORMAL_NC_FLAGS 0x44 /**< Inner/outer non-cacheable */
+#define MAIR_VALUE ((MT_DEVICE_nGnRnE_FLAGS << (8 * MT_DEVICE_nGnRnE)) | \
+  (MT_NORMAL_FLAGS << (8 * MT_NORMAL)) | \
+  (MT_NORMAL_NC_FLAGS << (8 * MT_NORMAL_NC)))
+
+#define MMU_FLAGS_NORMAL (MM_TYPE_BLOCK | MM_ATTRINDX(MT_NORMAL) | \
+  MM_SH_INNER | MM_ACCESS)
+#define MMU_FLAGS_DEVICE (MM_TYPE_BLOCK | MM_ATTRINDX(MT_DEVICE_nGnRnE) | \
+  MM_ACCESS)
+
+/**
+ * TCR_EL2, Translation Control Register (EL2, non-VHE layout)
+ */
+#define TCR_T0SZ (64 - 32) /**< 32-bit VA: start at level 1 */
+#define TCR_IRGN0_WBWA (1 << 8) /**< Table walks: inner write-back */
+#define TCR_ORGN0_WBWA (1 << 10) /**< Table walks: outer write-back */
+#define TCR_SH0_INNER (3 << 12) /**< Table walks: inner shareable */
+#define TCR_TG0_4K (0 << 14) /**< 4 KiB granule */
+#define TCR_EL2_PS_4G (0 << 16) /**< 32-bit physical address */
+#define TCR_EL2_RES1 ((1 << 31) | (1 << 23))
+#define TCR_EL2_VALUE (TCR_T0SZ | TCR_IRGN0_WBWA | TCR_ORGN0_WBWA | \
+  TCR_SH0_INNER | TCR_TG0_4K | TCR_EL2_PS_4G | TCR_EL2_RES1)
+
+/**
+ * TCR_EL1: same walks as above for TTBR0; TTBR1 is not used
+ */
+#define TCR_EPD1 (1 << 23) /**< No walks through TTBR1_EL1 */
+#define TCR_TG1_4K (2 << 30) /**< TTBR1 granule (unused, kept valid) */
+#define TCR_EL1_IPS_4G 0 /**< IPS (bits 34:32) 0: 32-bit physical address */
+#define TCR_EL1_VALUE (TCR_T0SZ | TCR_IRGN0_WBWA | TCR_ORGN0_WBWA | \
+  TCR_SH0_INNER | TCR_TG0_4K | TCR_EPD1 | TCR_TG1_4K | TCR_EL1_IPS_4G)
+
+/**
+ * SCTLR_ELx enable bits
+ */
+#define SCTLR_MMU_ENABLED (1 << 0)
+#define SCTLR_D_CACHE_ENABLED (1 << 2)
+#define SCTLR_I_CACHE_ENABLED (1 << 12)
+
+/**
+ * Kernel identity map (mmu.c)
+ */
+#define MMU_L1_USED 4 /**< Level 1 entries mapped: 4 GiB */
+#define MMU_NR_TABLES 2 /**< Level 1, then level 2 for the first GiB */
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+/**< Translation tables, written once by mmu_map() */
+extern u64 mmu_tables[MMU_NR_TABLES][MM_ENTRIES];
+
+/**
+ * @brief Build the kernel identity map
+ * @return level 1 table, for TTBR0_EL1
+ *
+ * Called by boot.S on the boot core, with the MMU still off; every core
+ * then turns its MMU on with these tables (mmu_enable, boot.S).
+ */
+u64 mmu_map();
+
+#endif
@@ -0,0 +1,29 @@
+/**
+ * @file neon.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief FP/SIMD (NEON) accelerated routines
+ *
+ * Built from NEON_FILES (see the Makefile) without -mgeneral-regs-only;
+ * the registers they use are handled lazily by fpsimd.h. The vector
+ * paths only take aligned buffers, so no load or store straddles a
+ * cache line, and fall back to byte loops otherwise.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+/**
+ * @brief Copy len bytes (non-overlapping)
+ * @param dst: destination
+ * @param src: source
+ * @param len: nr of bytes
+ *
+ * 64 bytes per iteration through four Q registers when dst and src are
+ * both 16-byte aligned
+ */
+void neon_copy(void *dst, const void *src, u64 len);
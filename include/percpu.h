@@ -0,0 +1,85 @@
+/**
+ * @file percpu.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Per-CPU variables
+ *
+ * Variables defined with DEFINE_PER_CPU go to the .data..percpu
+ * section. At boot that section is copied once per core (percpu_init())
+ * and each core keeps, in TPIDR_EL1, the distance from the section to
+ * its own copy. Accessing the calling core's copy is then one mrs plus
+ * one load/store, and no two cores ever write the same cache line.
+ *
+ *   DEFINE_PER_CPU(u64, irq_count);
+ *   this_cpu_add(irq_count, 1);
+ *   total += per_cpu(irq_count, core);
+ *
+ * Only go through these macros: the variable itself is the template
+ * the copies are made from.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "smp.h"
+
+#define PER_CPU_SECTION ".data..percpu"
+
+/**
+ * @brief Define (or declare) a per-CPU variable
+ */
+#define DEFINE_PER_CPU(type, name)											\
+  __attribute__((section(PER_CPU_SECTION))) __typeof__(type) name
+#define DECLARE_PER_CPU(type, name)										\
+  extern __attribute__((section(PER_CPU_SECTION))) __typeof__(type) name
+
+#if defined(HOST_TEST)
+/**< Host tests: a single CPU, the template is its copy */
+#define __my_cpu_offset() 0UL
+#define __cpu_offset(cpu) 0UL
+#else
+/**< Offset of each core's copy from the template (percpu.c) */
+extern u64 __per_cpu_offset[NR_CPUS];
+
+/**
+ * @brief Offset of the calling core's copy
+ *
+ * volatile: the compiler must not hoist the read above percpu_init_cpu()
+ */
+static inline u64 __my_cpu_offset() {
+  u64 off;
+  asm volatile("mrs %0, tpidr_el1" : "=r"(off));
+  return off;
+}
+#define __cpu_offset(cpu) (__per_cpu_offset[cpu])
+#endif
+
+/**
+ * @brief Pointer to a core's copy / to the calling core's copy
+ */
+#define per_cpu_ptr(var, cpu)												\
+  ((__typeof__(&(var)))((char *)&(var) + __cpu_offset(cpu)))
+#define this_cpu_ptr(var)													\
+  ((__typeof__(&(var)))((char *)&(var) + __my_cpu_offset()))
+
+#define per_cpu(var, cpu) (*per_cpu_ptr(var, cpu))
+#define this_cpu_read(var) (*this_cpu_ptr(var))
+#define this_cpu_write(var, val) (*this_cpu_ptr(var) = (val))
+#define this_cpu_add(var, val) (*this_cpu_ptr(var) += (val))
+
+/**
+ * @brief Copy the per-CPU section for every core (boot core, once)
+ *
+ * Also points the boot core at its copy. Must run before any other
+ * core starts and before the per-CPU variables are first written.
+ */
+__cold void percpu_init();
+
+/**
+ * @brief Point TPIDR_EL1 at the calling core's copy
+ * @param core: calling core id
+ */
+void percpu_init_cpu(u32 core);
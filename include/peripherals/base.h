@@ -12,7 +12,14 @@
 
 #pragma once
 
-#if RPI_VERSION == 3
+#if defined(HOST_TEST)
+// Host unit tests (make test-host): the peripherals are a block of RAM
+// the tests inspect, see test/host/fake_periph.c
+extern unsigned char host_periph[];
+#define PBASE ((unsigned long)host_periph)
+#define HOST_PERIPH_SIZE 0x00300000
+
+#elif RPI_VERSION == 3
 // PBASE: Peripheral Base (see bcm2836 datasheet)
 #define PBASE 0x3F000000
 
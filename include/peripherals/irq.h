@@ -0,0 +1,147 @@
+/**
+ * @file irq.h
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief Interrupt controller register definitions
+ *
+ * It follows the documentation:
+ * - RPi 4: ARM GIC-400 (GICv2) TRM, BCM2711 peripherals (GIC-400)
+ * - RPi 3: BCM2836 ARM-local peripherals (QA7), BCM2835 peripherals
+ *   (Interrupts)
+ *
+ * IRQ numbers are controller specific, but the IRQ_* names below are
+ * the same on both boards.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "peripherals/base.h"
+
+/**
+ * @brief ARM-local peripherals (core timers, mailboxes, routing)
+ *
+ * See BCM2836 ARM-local peripherals (QA7_rev3.4)
+ */
+struct ArmLocalRegs {
+  reg32 control;             /**< Control (0x00) */
+  reg32 reserved0;           /**< (0x04) */
+  reg32 core_timer_prescaler; /**< Core timer prescaler (0x08) */
+  reg32 gpu_int_routing;     /**< GPU interrupt routing (0x0C) */
+  reg32 pmu_int_routing_set; /**< PMU interrupt routing set (0x10) */
+  reg32 pmu_int_routing_clr; /**< PMU interrupt routing clear (0x14) */
+  reg32 reserved1[10];       /**< (0x18 - 0x3C) */
+  reg32 timer_int_ctrl[4];   /**< Core n timers interrupt control (0x40) */
+  reg32 mbox_int_ctrl[4];    /**< Core n mailboxes interrupt control (0x50) */
+  reg32 irq_source[4];       /**< Core n IRQ source (0x60) */
+  reg32 fiq_source[4];       /**< Core n FIQ source (0x70) */
+  reg32 mbox_set[16];        /**< Core n mailbox m write-set (0x80 + 16n + 4m) */
+  reg32 mbox_clr[16];        /**< Core n mailbox m read/write-clear (0xC0 + ...) */
+};
+
+#if RPI_VERSION == 4
+
+#define ARM_LOCAL_BASE 0xFF800000
+#define GIC_BASE 0xFF840000
+
+/**
+ * @brief GIC-400 distributor registers
+ */
+struct GicdRegs {
+  reg32 ctlr;              /**< Control (0x000) */
+  reg32 typer;             /**< Type (0x004) */
+  reg32 iidr;              /**< Implementer id (0x008) */
+  reg32 reserved0[29];     /**< (0x00C - 0x07C) */
+  reg32 igroupr[32];       /**< Group (0x080) */
+  reg32 isenabler[32];     /**< Set-enable (0x100) */
+  reg32 icenabler[32];     /**< Clear-enable (0x180) */
+  reg32 ispendr[32];       /**< Set-pending (0x200) */
+  reg32 icpendr[32];       /**< Clear-pending (0x280) */
+  reg32 isactiver[32];     /**< Set-active (0x300) */
+  reg32 icactiver[32];     /**< Clear-active (0x380) */
+  reg8 ipriorityr[1024];   /**< Priority, one byte per IRQ (0x400) */
+  reg8 itargetsr[1024];    /**< CPU targets, one byte per IRQ (0x800) */
+  reg32 icfgr[64];         /**< Configuration, 2 bits per IRQ (0xC00) */
+  reg32 reserved1[128];    /**< (0xD00 - 0xEFC) */
+  reg32 sgir;              /**< Software generated interrupt (0xF00) */
+};
+
+/**
+ * @brief GIC-400 CPU interface registers (banked per core)
+ */
+struct GiccRegs {
+  reg32 ctlr;              /**< Control (0x00) */
+  reg32 pmr;               /**< Priority mask (0x04) */
+  reg32 bpr;               /**< Binary point (0x08) */
+  reg32 iar;               /**< Interrupt acknowledge (0x0C) */
+  reg32 eoir;              /**< End of interrupt (0x10) */
+};
+
+#define REGS_GICD ((struct GicdRegs *)(GIC_BASE + 0x1000))
+#define REGS_GICC ((struct GiccRegs *)(GIC_BASE + 0x2000))
+
+#define GIC_SPURIOUS 1020 /**< IAR ids >= 1020 are spurious */
+#define GIC_PRIO_DEFAULT 0xA0 /**< Priority given to every IRQ */
+#define GIC_PRIO_MASK 0xF0 /**< Let every IRQ below this through */
+
+#define IRQ_NR 256 /**< Interrupt ids handled */
+
+/**
+ * IRQ numbers (GIC interrupt ids; see bcm2711.dtsi)
+ */
+#define IRQ_SGI(n) (n)              /**< Software generated (0 - 15) */
+#define IRQ_TIMER_CNTHP 26          /**< PPI 10: EL2 physical timer */
+#define IRQ_TIMER_CNTV 27           /**< PPI 11: virtual timer */
+#define IRQ_TIMER_CNTPNS 30         /**< PPI 14: EL1 physical timer */
+#define IRQ_PMU(core) (48 + (core)) /**< SPI 16 - 19 */
+#define IRQ_VC(n) (96 + (n))        /**< VideoCore peripheral n (SPI 64+) */
+#define IRQ_IPI IRQ_SGI(0)          /**< Cross-core doorbell (smp.h) */
+
+#else
+
+#define ARM_LOCAL_BASE 0x40000000
+
+/**
+ * @brief BCM2835 interrupt controller (VideoCore peripherals)
+ */
+struct IrqRegs {
+  reg32 pending_basic;     /**< Basic pending (0x200) */
+  reg32 pending[2];        /**< Pending 1-2 (0x204) */
+  reg32 fiq_control;       /**< FIQ control (0x20C) */
+  reg32 enable[2];         /**< Enable IRQs 1-2 (0x210) */
+  reg32 enable_basic;      /**< Enable basic IRQs (0x218) */
+  reg32 disable[2];        /**< Disable IRQs 1-2 (0x21C) */
+  reg32 disable_basic;     /**< Disable basic IRQs (0x224) */
+};
+
+#define REGS_IRQ ((struct IrqRegs *)(PBASE + 0x0000B200))
+
+#define IRQ_NR 128 /**< 0-63: ARM-local sources, 64-127: VideoCore */
+
+/**
+ * IRQ numbers: ARM-local sources use their bit in the core IRQ source
+ * register, VideoCore peripherals are offset by 64
+ */
+#define IRQ_TIMER_CNTPNS 1          /**< EL1 physical timer */
+#define IRQ_TIMER_CNTHP 2           /**< EL2 physical timer */
+#define IRQ_TIMER_CNTV 3            /**< Virtual timer */
+#define IRQ_LOCAL_MBOX(n) (4 + (n)) /**< Core mailbox n (0 - 3) */
+#define IRQ_LOCAL_GPU 8             /**< VideoCore interrupt pending */
+#define IRQ_PMU(core) 9             /**< PMU (routed per core) */
+#define IRQ_VC(n) (64 + (n))        /**< VideoCore peripheral n */
+#define IRQ_IPI IRQ_LOCAL_MBOX(0)   /**< Cross-core doorbell (smp.h) */
+
+#endif
+
+#define REGS_ARM_LOCAL ((struct ArmLocalRegs *)ARM_LOCAL_BASE)
+
+/**
+ * VideoCore peripheral interrupts (see BCM2835/BCM2711 peripherals)
+ */
+#define IRQ_AUX IRQ_VC(29)   /**< Mini UART and SPI1/2 (auxiliaries) */
+#define IRQ_GPIO0 IRQ_VC(49) /**< GPIO bank 0 */
+#define IRQ_GPIO IRQ_VC(52)  /**< Any GPIO pin (all banks) */
+#define IRQ_UART IRQ_VC(57)  /**< PL011 UARTs (all of them) */
@@ -0,0 +1,60 @@
+/**
+ * @file mailbox.h
+ * @author Jose Pires
+ * @date 2024-10-07
+ *
+ * @brief VideoCore mailbox register definitions
+ *
+ * It follows the documentation:
+ * - BCM2835 ARM peripherals (ARM to VC mailbox)
+ * - raspberrypi/firmware wiki: Mailbox property interface
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "peripherals/base.h"
+
+/**
+ * @brief Mailbox registers
+ *
+ * Mailbox 0 is VC -> ARM (we read responses from it), mailbox 1 is
+ * ARM -> VC (we write requests to it). Each one has its own status
+ * register.
+ */
+struct MboxRegs {
+  reg32 read;          /**< Mailbox 0 read (0x00) */
+  reg32 reserved0[3];  /**< Reserved (0x04 - 0x0C) */
+  reg32 peek;          /**< Mailbox 0 peek (0x10) */
+  reg32 sender;        /**< Mailbox 0 sender (0x14) */
+  reg32 status;        /**< Mailbox 0 status (0x18) */
+  reg32 config;        /**< Mailbox 0 config (0x1C) */
+  reg32 write;         /**< Mailbox 1 write (0x20) */
+  reg32 reserved1[5];  /**< Reserved (0x24 - 0x34) */
+  reg32 write_status;  /**< Mailbox 1 status (0x38) */
+};
+
+#define REGS_MBOX ((struct MboxRegs *)(PBASE + 0x0000B880))
+
+#define MBOX_STATUS_FULL  (1U << 31) /**< Mailbox full (bit 31) */
+#define MBOX_STATUS_EMPTY (1U << 30) /**< Mailbox empty (bit 30) */
+
+#define MBOX_CH_PROP 8 /**< Property channel (ARM -> VC) */
+
+#define MBOX_REQUEST 0x00000000U   /**< Buffer/tag request code */
+#define MBOX_RESPONSE 0x80000000U  /**< Buffer response: success */
+#define MBOX_TAG_LAST                0x00000000U  /**< End tag */
+
+/**
+ * Property tags (see the firmware mailbox property interface)
+ */
+#define MBOX_TAG_GET_BOARD_REVISION  0x00010002
+#define MBOX_TAG_GET_ARM_MEMORY      0x00010005
+#define MBOX_TAG_GET_CLOCK_RATE      0x00030002
+#define MBOX_TAG_GET_MAX_CLOCK_RATE  0x00030004
+#define MBOX_TAG_GET_MIN_CLOCK_RATE  0x00030007
+#define MBOX_TAG_SET_CLOCK_RATE      0x00038002
+#define MBOX_TAG_GET_TEMPERATURE     0x00030006
+#define MBOX_TAG_GET_MAX_TEMPERATURE 0x0003000A
@@ -30,10 +30,13 @@
 #define PL011_UARTCR_UARTEN 0 /**< UART Enable (bit 0) */
 #define PL011_UARTCR_TXE 8 /**< TX Enable (bit 8) */
 #define PL011_UARTCR_RXE 9 /**< RX Enable (bit 9) */
+#define PL011_UARTCR_RTSEN 14 /**< RTS hardware flow control (bit 14) */
+#define PL011_UARTCR_CTSEN 15 /**< CTS hardware flow control (bit 15) */
 
 /**
  * See BCM2711 UART: Flag Register (UARTFR)
  */
+#define PL011_UARTFR_CTS 0 /**< Clear To Send asserted (bit 0) */
 #define PL011_UARTFR_BUSY 3 /**< UART Busy (bit 3) */
 #define PL011_UARTFR_RXFE 4 /**< UART Receive FIFO Empty (bit 4) */
 #define PL011_UARTFR_TXFF 5 /**< UART Transmit FIFO full (bit 5) */
@@ -45,6 +48,21 @@
 #define PL011_UARTLCRH_FEN 4 /**< UART Enable FIFOs (bit 4) */
 #define PL011_UARTLCRH_WLEN 5 /**< UART Word length (bit 6:5) */
 
+/**
+ * See BCM2711 UART: Interrupt FIFO Level Select Register (UART_IFLS)
+ * Levels: 0 = 1/8, 1 = 1/4, 2 = 1/2, 3 = 3/4, 4 = 7/8 full
+ */
+#define PL011_UARTIFLS_TXIFLSEL 0 /**< TX interrupt level (bits 2:0) */
+#define PL011_UARTIFLS_RXIFLSEL 3 /**< RX interrupt level (bits 5:3) */
+
+/**
+ * See BCM2711 UART: IMSC/RIS/MIS/ICR, same bit for each source
+ */
+#define PL011_INT_RX 4 /**< Receive (RX FIFO reached its level) */
+#define PL011_INT_TX 5 /**< Transmit (TX FIFO dropped to its level) */
+#define PL011_INT_RT 6 /**< Receive timeout (data left below the level) */
+#define PL011_INT_OE 10 /**< Overrun error */
+
 enum PL011_WLEN {
   PL011_WLEN_5 = 0b00,
   PL011_WLEN_6 = 0b01,
@@ -53,7 +71,7 @@ enum PL011_WLEN {
 };
 
 
-#define PL011_FSYSCLK (u64)48e6 /**< Sysclk frequency for UART */
+#define PL011_FSYSCLK 48000000U /**< Default UARTCLK (firmware init_uart_clock) */
 
 // struct __attribute__((packed)) pl011  // ensure no unexpected padding
 /**
@@ -73,12 +91,12 @@ typedef struct {
     reg32 fbrd;      /**< Fractional Baud rate divisor (0x28) */
     reg32 lcrh;      /**< Line Control register (0x2C) */
     reg32 cr;        /**< Control register (0x30) */
-//  reg32 ifls;        /**< Interrupt FIFO Level Select Register */
-//  reg32 imsc;        /**< Interrupt Mask Set Clear Register */
-//  reg32 ris;         /**< Raw Interrupt Status Register */
-//  reg32 mis;         /**< Masked Interrupt Status Register */
-//  reg32 icr;         /**< Interrupt Clear Register */
-//  reg32 dmacr;       /**< DMA Control Register */
+    reg32 ifls;      /**< Interrupt FIFO Level Select (0x34) */
+    reg32 imsc;      /**< Interrupt Mask Set/Clear (0x38) */
+    reg32 ris;       /**< Raw Interrupt Status (0x3C) */
+    reg32 mis;       /**< Masked Interrupt Status (0x40) */
+    reg32 icr;       /**< Interrupt Clear (0x44) */
+    reg32 dmacr;     /**< DMA Control (0x48) */
 //  reg32 itcr;        /**< Test Control Register */
 //  reg32 itip;        /**< Integration Test Input Register */
 //  reg32 itop;        /**< Integration Test Output Register */
@@ -14,14 +14,32 @@
 
 #include "peripherals/pl011.h"
 #include "gpio.h"
+#include "printf.h"
+#include "ring.h"
+#include "sections.h"
 
 //typedef struct __attribute__((packed)) {  // ensure no unexpected padding
 typedef struct {
   const u8 tx;        /**< GPIO pin for TX */
   const u8 rx;        /**< GPIO pin for RX */
   const GpioFunc func; /**< GPIO Function for TX and RX */
+  const u8 cts;       /**< GPIO pin for CTS, 0 if not wired (no PL011 has
+						 it on GPIO 0) */
+  const u8 rts;       /**< GPIO pin for RTS, 0 if not wired */
+  const GpioFunc flow_func; /**< GPIO Function for CTS and RTS */
 } uart_gpio;
 
+/**
+ * @brief Pins of the PL011s with hardware flow control (BCM2711)
+ *
+ * UART0: TX/RX 14/15 ALT0, CTS/RTS 16/17 ALT3
+ * UART5: TX/RX 12/13 ALT4, CTS/RTS 14/15 ALT4 (RPi 4 only)
+ */
+#define UART0_GPIO_FLOW													\
+  {.tx = 14, .rx = 15, .func = GFAlt0, .cts = 16, .rts = 17, .flow_func = GFAlt3}
+#define UART5_GPIO_FLOW													\
+  {.tx = 12, .rx = 13, .func = GFAlt4, .cts = 14, .rts = 15, .flow_func = GFAlt4}
+
 /**
  * @brief PL011 UART typedef
  */
@@ -42,17 +60,68 @@ typedef struct {
 //pl011_uart *get_uart_by_index(int index);
 
 
+/**
+ * @brief Set the UART reference clock (UARTCLK) used for the baud math
+ * @param hz: UARTCLK frequency in Hz (e.g. from the firmware mailbox)
+ *
+ * Defaults to PL011_FSYSCLK. Call it before pl011_init().
+ */
+void pl011_set_uartclk(u32 hz);
+
+/**
+ * @brief Get the UART reference clock (UARTCLK)
+ * @return UARTCLK frequency in Hz
+ */
+u32 pl011_get_uartclk();
+
 /**
  * @brief Set the baudrate for the UART
  * @param uart: pointer to a UART struct
- * @param baudrate: baudrate in bps
+ * @param baudrate: baudrate in bps (up to UARTCLK / 16)
+ * @return 0, or -1 if the baudrate is out of range or the UART did not
+ * drain (nothing changed)
  */
-void pl011_set_br(pl011_uart *uart, u32 baudrate);
+int pl011_set_br(pl011_uart *uart, u32 baudrate);
+
+#define PL011_BAUD_TOLERANCE 4 /**< pl011_baud_match() error margin (%) */
+#define PL011_IDLE_TIMEOUT_US 1000000 /**< pl011_wait_idle() bound */
+
+/**
+ * @brief Wait until the UART has sent everything (TX FIFO and shift
+ * register empty)
+ * @param uart: pointer to a UART struct
+ * @return 0, or -1 if it is still sending after PL011_IDLE_TIMEOUT_US
+ * (CTS held deasserted with flow control on)
+ */
+int pl011_wait_idle(pl011_uart *uart);
+
+/**
+ * @brief Change the baudrate of an initialized UART
+ * @param uart: pointer to a UART struct
+ * @param baudrate: baudrate in bps (up to UARTCLK / 16)
+ * @return 0, or -1 if the baudrate is out of range or pending output
+ * did not drain (nothing changed)
+ *
+ * Pending output is sent at the old rate first; received chars still in
+ * the FIFO are dropped. The line format and enables are kept.
+ */
+int pl011_set_baud(pl011_uart *uart, u32 baudrate);
+
+/**
+ * @brief Snap a measured baudrate to the closest standard one
+ * @param measured: measured rate (bps)
+ * @return the standard rate, or 0 if none is within PL011_BAUD_TOLERANCE
+ */
+u32 pl011_baud_match(u32 measured);
 
 /**
  * @brief Set the baudrate for the UART
  * @param uart: pointer to a UART struct
  * @param baudrate: baudrate in bps
+ *
+ * When the gpio config has CTS/RTS pins, they are muxed and hardware
+ * flow control is enabled: TX pauses while the peer deasserts CTS, and
+ * RTS is deasserted while the RX FIFO is full.
  */
 void pl011_init(pl011_uart * uart, u32 baudrate);
 
@@ -61,14 +130,21 @@ void pl011_init(pl011_uart * uart, u32 baudrate);
  * @param uart: pointer to a UART struct
  * @param c: character to send
  */
-void pl011_send(pl011_uart * uart, char c);
+__hot void pl011_send(pl011_uart * uart, char c);
 
 /**
  * @brief Set the baudrate for the UART
  * @param uart: pointer to a UART struct
  * @return a char read from the UART
  */
-char pl011_recv(pl011_uart * uart);
+__hot char pl011_recv(pl011_uart * uart);
+
+/**
+ * @brief Check if a char can be read without blocking
+ * @param uart: pointer to a UART struct
+ * @return 1 if the RX FIFO holds data, 0 otherwise
+ */
+int pl011_can_recv(pl011_uart * uart);
 
 /**
  * @brief Set the baudrate for the UART
@@ -76,3 +152,117 @@ char pl011_recv(pl011_uart * uart);
  * @param string: string to send
  */
 void pl011_send_string(pl011_uart *uart, char *str);
+
+/**
+ * @brief Move bytes from a ring to the TX FIFO until either is
+ * exhausted (never blocks)
+ * @param uart: pointer to a UART struct
+ * @param tx: ring the UART consumes
+ * @return nr of bytes moved
+ */
+u32 pl011_tx_fill(pl011_uart *uart, struct ring *tx);
+
+/**
+ * @brief Move bytes from the RX FIFO to a ring until the FIFO is empty
+ * or the ring is full (never blocks)
+ * @param uart: pointer to a UART struct
+ * @param rx: ring the UART produces
+ * @return nr of bytes moved
+ *
+ * Bytes left in the FIFO when the ring is full are what makes RTS
+ * flow control push back on the sender.
+ */
+u32 pl011_rx_drain(pl011_uart *uart, struct ring *rx);
+
+/**
+ * @brief Unmask or mask the receive interrupts (RX level and RX
+ * timeout), leaving the others as they are
+ * @param uart: pointer to a UART struct
+ * @param on: 1 to unmask, 0 to mask
+ *
+ * For a polled UART read from IRQ_UART: the handler masks RX and hands
+ * over to code that drains the FIFO and unmasks it again. Data left in
+ * the FIFO raises the interrupt again as soon as it is unmasked.
+ */
+void pl011_rx_irq(pl011_uart *uart, int on);
+
+/**
+ * @brief Compile-time PL011 instance
+ *
+ * The functions above take a pl011_uart, so each call loads the
+ * register base through it and is made out of line. For a UART fixed
+ * at build time (the console), PL011_DEFINE(name, base, tx, rx, func)
+ * generates static inline functions with the base address folded in:
+ * the send path becomes a status poll and a store.
+ *
+ *   PL011_DEFINE(console, UART5, 12, 13, GFAlt4) // no ';' at file scope
+ *   pl011_init(console_dev(), 115200); // generic API, same UART
+ *   console_send('x');                 // inlined
+ *   init_printf(NULL, console_putc);
+ *   init_vprintf(console_vprintf);     // no per-char call from printf
+ *
+ * Generated (name_ prefix): name_gpio and name_uart (the instance for
+ * the generic API), name_dev(), name_send(), name_can_recv(),
+ * name_recv(), name_putc() and name_vprintf(). PL011_DEFINE_CFG() takes
+ * a whole uart_gpio initializer instead (e.g. UART5_GPIO_FLOW).
+ */
+#define PL011_REGS(base) ((pl011_regs *)(base))
+
+#define PL011_VPRINTF_BUF 128 /**< name_vprintf() stack buffer */
+
+#define PL011_DEFINE(name, base, tx_pin, rx_pin, gpio_func)				\
+  PL011_DEFINE_CFG(name, base,											\
+				   {.tx = (tx_pin), .rx = (rx_pin), .func = (gpio_func)})
+
+#define PL011_DEFINE_CFG(name, base, ...)								\
+  static const uart_gpio name##_gpio __attribute__((unused)) = __VA_ARGS__; \
+  static pl011_uart name##_uart __attribute__((unused)) = {				\
+	.regs = PL011_REGS(base), .gpio = &name##_gpio};					\
+																		\
+  static inline pl011_uart *name##_dev() {								\
+	return &name##_uart;												\
+  }																		\
+																		\
+  static inline void name##_send(char c) {								\
+	while (PL011_REGS(base)->fr & (1 << PL011_UARTFR_TXFF)) {			\
+	  ;																	\
+	}																	\
+	PL011_REGS(base)->dr = c;											\
+  }																		\
+																		\
+  static inline int name##_can_recv() {									\
+	return !(PL011_REGS(base)->fr & (1 << PL011_UARTFR_RXFE));			\
+  }																		\
+																		\
+  static inline char name##_recv() {									\
+	while (!name##_can_recv()) {										\
+	  ;																	\
+	}																	\
+	return (char)(PL011_REGS(base)->dr & 0xFF);							\
+  }																		\
+																		\
+  static inline void name##_putc(void *p, char c) {						\
+	if (c == '\n') {													\
+	  name##_send('\r');												\
+	}																	\
+	name##_send(c);														\
+  }																		\
+																		\
+  /* Format the whole call on the stack, send it with the inlined loop; \
+	 longer output is formatted again char by char */					\
+  static inline void name##_vprintf(char *fmt, va_list va) {			\
+	char buf[PL011_VPRINTF_BUF];										\
+	va_list va_buf;														\
+	int len, i;															\
+																		\
+	va_copy(va_buf, va);												\
+	len = tfp_vsnprintf(buf, sizeof(buf), fmt, va_buf);					\
+	va_end(va_buf);														\
+	if (len >= (int)sizeof(buf)) {										\
+	  tfp_format(NULL, name##_putc, fmt, va);							\
+	  return;															\
+	}																	\
+	for (i = 0; i < len; i++) {											\
+	  name##_putc(NULL, buf[i]);										\
+	}																	\
+  }
@@ -0,0 +1,111 @@
+/**
+ * @file pmu.h
+ * @author Jose Pires
+ * @date 2024-10-11
+ *
+ * @brief Cortex-A72 Performance Monitors Unit (PMU) interface
+ *
+ * It follows the documentation:
+ * - ARM Architecture Reference Manual ARMv8 (D7: Performance Monitors)
+ * - Cortex-A72 TRM (Performance Monitor Unit)
+ *
+ * The 64-bit cycle counter (PMCCNTR_EL0) plus six event counters. The
+ * readers are inline since they are used on hot paths; with a constant
+ * index they fold to a single mrs.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+/**
+ * PMCR_EL0 fields
+ */
+#define PMCR_E (1 << 0)  /**< Enable all counters */
+#define PMCR_P (1 << 1)  /**< Reset event counters */
+#define PMCR_C (1 << 2)  /**< Reset cycle counter */
+#define PMCR_LC (1 << 6) /**< 64-bit cycle counter overflow */
+#define PMCR_N_SHIFT 11  /**< Nr of event counters (bits 15:11) */
+#define PMCR_N_MASK 0x1F
+
+#define PMU_CYCLE_IDX 31 /**< Cycle counter bit in PMCNTEN/PMOVS/PMINTEN */
+#define PMU_MAX_COUNTERS 6 /**< Event counters on the Cortex-A72 */
+
+#define PMU_FILTER_NSH (1 << 27) /**< PMEVTYPER/PMCCFILTR: count at EL2 */
+
+/**
+ * Common architectural events (ARMv8 PMUv3)
+ */
+#define PMU_EVT_L1I_CACHE_REFILL 0x01
+#define PMU_EVT_L1D_CACHE_REFILL 0x03
+#define PMU_EVT_L1D_CACHE        0x04
+#define PMU_EVT_INST_RETIRED     0x08
+#define PMU_EVT_EXC_TAKEN        0x09
+#define PMU_EVT_BR_MIS_PRED      0x10
+#define PMU_EVT_CPU_CYCLES       0x11
+#define PMU_EVT_BR_PRED          0x12
+#define PMU_EVT_L2D_CACHE        0x16
+#define PMU_EVT_L2D_CACHE_REFILL 0x17
+
+/**
+ * @brief Enable the PMU
+ *
+ * Reset and start the cycle counter and all event counters. Counting
+ * includes EL2, since the kernel may be running there.
+ */
+__cold void pmu_init();
+
+/**
+ * @brief Get the nr of implemented event counters
+ * @return nr of event counters (PMCR_EL0.N)
+ */
+u32 pmu_num_counters();
+
+/**
+ * @brief Select the event an event counter counts
+ * @param idx: event counter index (0 - pmu_num_counters()-1)
+ * @param event: event number (PMU_EVT_*)
+ *
+ * The counter is reset
+ */
+void pmu_set_event(u32 idx, u32 event);
+
+/**
+ * @brief Get a short name for an event
+ * @param event: event number (PMU_EVT_*)
+ * @return static string ("?" for unknown events)
+ */
+const char *pmu_event_name(u32 event);
+
+/**
+ * @brief Read the cycle counter
+ * @return nr of CPU cycles
+ */
+static inline u64 pmu_read_cycles() {
+  u64 cycles;
+  asm volatile("mrs %0, pmccntr_el0" : "=r"(cycles));
+  return cycles;
+}
+
+/**
+ * @brief Read an event counter
+ * @param idx: event counter index (0 - 5)
+ * @return counter value (32-bit counters)
+ */
+static inline u64 pmu_read_counter(u32 idx) {
+  u64 val = 0;
+
+  switch (idx) {
+  case 0: asm volatile("mrs %0, pmevcntr0_el0" : "=r"(val)); break;
+  case 1: asm volatile("mrs %0, pmevcntr1_el0" : "=r"(val)); break;
+  case 2: asm volatile("mrs %0, pmevcntr2_el0" : "=r"(val)); break;
+  case 3: asm volatile("mrs %0, pmevcntr3_el0" : "=r"(val)); break;
+  case 4: asm volatile("mrs %0, pmevcntr4_el0" : "=r"(val)); break;
+  case 5: asm volatile("mrs %0, pmevcntr5_el0" : "=r"(val)); break;
+  default: break;
+  }
+  return val;
+}
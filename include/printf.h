@@ -78,12 +78,41 @@ regs Kusti, 23.10.2004
  */
 void init_printf(void* putp,void (*putf) (void*,char));
 
+/**
+ * @brief Whole-call printf output
+ *
+ * Called with each printf's format and args instead of the per-char
+ * function, so the output can format a call straight into its own
+ * buffer (e.g. serial_vprintf() into the UART TX ring)
+ */
+typedef void (*vprintf_t)(char *fmt, va_list va);
+
+/**
+ * @brief Route printf to a whole-call output (init_printf() goes back to
+ * the per-char function)
+ * @param vpf: whole-call output, or NULL for the per-char function
+ */
+void init_vprintf(vprintf_t vpf);
+
 void tfp_printf(char *fmt, ...);
 void tfp_sprintf(char* s,char *fmt, ...);
 
+/**
+ * @brief Bounded sprintf
+ * @param s: destination (may be NULL if n is 0)
+ * @param n: size of s; the output is cut at n - 1 chars and always
+ *        NUL-terminated (if n > 0)
+ * @return length of the full output, without the NUL: a result >= n
+ *         means it was cut (snprintf(NULL, 0, ...) sizes a buffer)
+ */
+int tfp_snprintf(char* s,unsigned int n,char *fmt, ...);
+int tfp_vsnprintf(char* s,unsigned int n,char *fmt, va_list va);
+
 void tfp_format(void* putp,void (*putf) (void*,char),char *fmt, va_list va);
 
 #define printf tfp_printf
 #define sprintf tfp_sprintf
+#define snprintf tfp_snprintf
+#define vsnprintf tfp_vsnprintf
 
 #endif
@@ -0,0 +1,182 @@
+/**
+ * @file prof.h
+ * @author Jose Pires
+ * @date 2024-10-11
+ *
+ * @brief Hot-path profiling over the PMU
+ *
+ * A profiling site aggregates cycles (min/avg/max) and PROF_NR_EVENTS
+ * event counters (totals) over all the times a region ran. Sites live
+ * in the .prof_sites linker section, so prof_dump() finds them all
+ * without a registration call.
+ *
+ * Usage:
+ *   void pl011_send(...) {
+ *     PROF_SCOPE("pl011_send"); // measured until the end of the block
+ *     ...
+ *   }
+ *
+ * or explicitly:
+ *   PROF_SITE(site_x, "x");
+ *   struct prof_sample s;
+ *   prof_begin(&s); ...; prof_end(&site_x, &s);
+ *
+ * The macros compile to nothing unless the kernel is built with
+ * PROFILE=y (-DPROFILE), so instrumentation can stay in the code.
+ * Stats are not locked: profile from one core at a time.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pmu.h"
+#include "sections.h"
+
+#define PROF_NR_EVENTS 4 /**< Event counters 0-3 are owned by the profiler */
+
+/**
+ * @brief Aggregated stats for a profiling site
+ */
+struct prof_site {
+  const char *name;             /**< Site label */
+  u64 calls;                    /**< Nr of measurements */
+  u64 total;                    /**< Total cycles */
+  u64 min;                      /**< Fastest run (cycles) */
+  u64 max;                      /**< Slowest run (cycles) */
+  u64 events[PROF_NR_EVENTS];   /**< Event totals */
+};
+
+/**
+ * @brief Counter snapshot taken at the beginning of a region
+ */
+struct prof_sample {
+  u64 cycles;                   /**< Cycle counter */
+  u32 events[PROF_NR_EVENTS];   /**< Event counters */
+};
+
+/**
+ * @brief Scoped measurement (see PROF_SCOPE)
+ */
+struct prof_scope {
+  struct prof_site *site;
+  struct prof_sample sample;
+};
+
+/**
+ * @brief Take the starting snapshot
+ * @param s: snapshot to fill [out]
+ *
+ * Events first and cycles last, so the cycle count covers as little of
+ * the profiler itself as possible
+ */
+static inline void prof_begin(struct prof_sample *s) {
+  u32 i;
+
+  for (i = 0; i < PROF_NR_EVENTS; i++) {
+	s->events[i] = (u32)pmu_read_counter(i);
+  }
+  asm volatile("isb" ::: "memory");
+  s->cycles = pmu_read_cycles();
+}
+
+/**
+ * @brief Account the region started with prof_begin() to a site
+ * @param site: site to update
+ * @param s: starting snapshot
+ *
+ * Event counters are 32-bit: the deltas are computed modulo 2^32
+ */
+static inline void prof_end(struct prof_site *site,
+							const struct prof_sample *s) {
+  u64 cycles = pmu_read_cycles();
+  u32 i;
+
+  asm volatile("isb" ::: "memory");
+  cycles -= s->cycles;
+  for (i = 0; i < PROF_NR_EVENTS; i++) {
+	site->events[i] += (u32)((u32)pmu_read_counter(i) - s->events[i]);
+  }
+
+  site->calls++;
+  site->total += cycles;
+  if (cycles < site->min) {
+	site->min = cycles;
+  }
+  if (cycles > site->max) {
+	site->max = cycles;
+  }
+}
+
+static inline struct prof_scope prof_scope_begin(struct prof_site *site) {
+  struct prof_scope scope = {.site = site};
+  prof_begin(&scope.sample);
+  return scope;
+}
+
+static inline void prof_scope_end(struct prof_scope *scope) {
+  prof_end(scope->site, &scope->sample);
+}
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+#ifdef PROFILE
+
+/**
+ * @brief Define a profiling site
+ * @param var: variable name
+ * @param label: name shown by prof_dump()
+ */
+#define PROF_SITE(var, label)										\
+  struct prof_site var												\
+  __attribute__((section(".prof_sites"), used, aligned(8))) =		\
+	{.name = label, .min = ~0UL}
+
+/**
+ * @brief Measure from here to the end of the enclosing block
+ * @param label: name shown by prof_dump()
+ */
+#define PROF_SCOPE(label)												\
+  static PROF_SITE(PROF_CONCAT(prof_site_, __LINE__), label);		\
+  struct prof_scope PROF_CONCAT(prof_scope_, __LINE__)				\
+  __attribute__((cleanup(prof_scope_end))) =						\
+	prof_scope_begin(&PROF_CONCAT(prof_site_, __LINE__))
+
+#else
+
+#define PROF_SITE(var, label) struct prof_site var __attribute__((unused))
+#define PROF_SCOPE(label) do { } while (0)
+
+#endif
+
+/**
+ * @brief Enable the PMU and program the default events
+ *
+ * Counters 0-3: instructions retired, L1D refills, branch
+ * mispredictions, L2D refills
+ */
+__cold void prof_init();
+
+/**
+ * @brief Change the event counted in one profiler slot
+ * @param slot: 0 - PROF_NR_EVENTS-1
+ * @param event: event number (PMU_EVT_*)
+ *
+ * All site stats are reset, since they would mix two events otherwise
+ */
+void prof_set_event(u32 slot, u32 event);
+
+/**
+ * @brief Clear the stats of every site
+ */
+void prof_reset();
+
+/**
+ * @brief Print the stats of every site that ran
+ *
+ * One line per site: calls, min/avg/max cycles and the average of each
+ * event per call
+ */
+__cold void prof_dump();
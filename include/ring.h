@@ -0,0 +1,139 @@
+/**
+ * @file ring.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Single-producer single-consumer byte ring
+ *
+ * The producer only writes head, the consumer only writes tail, so one
+ * side may run in an IRQ handler (or on another core) without a lock:
+ * data is published with a release store of head and slots are given
+ * back with a release store of tail. head and tail run freely and wrap;
+ * the buffer size must be a power of 2.
+ *
+ *   static u8 buf[256];
+ *   static struct ring r = RING_INIT(buf);
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+struct ring {
+  u8 *buf;
+  u32 size; /**< Power of 2 */
+  u32 head; /**< Next byte to write (producer) */
+  u32 tail; /**< Next byte to read (consumer) */
+};
+
+#define RING_INIT(array) { .buf = (array), .size = sizeof(array) }
+
+static inline void ring_init(struct ring *r, u8 *buf, u32 size) {
+  r->buf = buf;
+  r->size = size;
+  r->head = 0;
+  r->tail = 0;
+}
+
+/**
+ * @brief Bytes waiting to be read
+ */
+static inline u32 ring_count(const struct ring *r) {
+  return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) -
+	__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Bytes that can be written
+ */
+static inline u32 ring_space(const struct ring *r) {
+  return r->size - ring_count(r);
+}
+
+static inline int ring_empty(const struct ring *r) {
+  return ring_count(r) == 0;
+}
+
+static inline int ring_full(const struct ring *r) {
+  return ring_count(r) == r->size;
+}
+
+/**
+ * @brief Append a byte (producer)
+ * @return 0, or -1 if the ring is full
+ */
+static inline int ring_put(struct ring *r, u8 c) {
+  u32 head = r->head;
+
+  if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == r->size) {
+	return -1;
+  }
+  r->buf[head & (r->size - 1)] = c;
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/**
+ * @brief Take a byte (consumer)
+ * @return the byte, or -1 if the ring is empty
+ */
+static inline int ring_get(struct ring *r) {
+  u32 tail = r->tail;
+  u8 c;
+
+  if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail) {
+	return -1;
+  }
+  c = r->buf[tail & (r->size - 1)];
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+  return c;
+}
+
+/**
+ * @brief Append up to len bytes (producer)
+ * @return nr of bytes written
+ */
+static inline u32 ring_write(struct ring *r, const void *data, u32 len) {
+  const u8 *src = data;
+  u32 head = r->head;
+  u32 space = r->size - (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+  u32 i;
+
+  if (len > space) {
+	len = space;
+  }
+  for (i = 0; i < len; i++) {
+	r->buf[(head + i) & (r->size - 1)] = src[i];
+  }
+  __atomic_store_n(&r->head, head + len, __ATOMIC_RELEASE);
+  return len;
+}
+
+/**
+ * @brief Reserve the free space up to the end of the buffer (producer),
+ * to be filled in place and published with ring_commit()
+ * @param len: returns the nr of contiguous bytes available (0 if full)
+ * @return start of the reserved space
+ *
+ * Free space that wraps to the start of the buffer is not included: a
+ * writer that needs more than *len can commit what it has and reserve
+ * again.
+ */
+static inline u8 *ring_reserve(struct ring *r, u32 *len) {
+  u32 head = r->head;
+  u32 off = head & (r->size - 1);
+  u32 space = r->size - (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+
+  *len = r->size - off < space ? r->size - off : space;
+  return &r->buf[off];
+}
+
+/**
+ * @brief Publish len bytes written into a ring_reserve() reservation
+ * (producer)
+ */
+static inline void ring_commit(struct ring *r, u32 len) {
+  __atomic_store_n(&r->head, r->head + len, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,62 @@
+/**
+ * @file sections.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Kernel image layout (see linker.ld) and placement attributes
+ *
+ * The image is split into page-aligned regions, so the MMU can map each
+ * one with its own attributes:
+ * - [_text, _etext): code, RX. Boot code first, then the cold
+ *   (.text.unlikely) and hot (.text.hot) functions grouped apart from
+ *   the rest
+ * - [_rodata, _erodata): constants and the const registries, RO/XN
+ * - [_data, _end): per-CPU template, data, registries that count, BSS,
+ *   the per-CPU copies (percpu.h) and the DMA pool (dma.h); RW/XN
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#define L1_CACHE_SHIFT 6
+#define L1_CACHE_BYTES (1 << L1_CACHE_SHIFT) /**< Cortex-A53/A72 line */
+
+#ifndef __ASSEMBLER__
+
+/**< Region bounds, exported by linker.ld */
+extern char _text[], _etext[];
+extern char __cold_text_start[], __cold_text_end[];
+extern char __hot_text_start[], __hot_text_end[];
+extern char _rodata[], _erodata[];
+extern char _data[], _edata[];
+extern char __per_cpu_start[], __per_cpu_end[], __per_cpu_areas[];
+extern char bss_begin[], bss_end[];
+extern char __dma_start[], __dma_end[];
+extern char _end[];
+
+/**
+ * @brief Function placement
+ *
+ * __hot: run often (IRQ, console, printf); grouped in .text.hot and
+ * optimized harder. __cold: run once or on errors (init, reports);
+ * grouped in .text.unlikely, optimized for size, and calls to them are
+ * predicted not taken.
+ */
+#define __hot __attribute__((hot))
+#define __cold __attribute__((cold))
+
+/**
+ * @brief Data written by one core and read by others
+ *
+ * ____cacheline_aligned: start (and pad) the object or type on its own
+ * cache line, so it never shares one with unrelated data (no false
+ * sharing); zero-initialized objects stay in BSS.
+ * __cacheline_aligned: same, for initialized data, grouped in
+ * .data..cacheline_aligned at the start of the RW region.
+ */
+#define ____cacheline_aligned __attribute__((aligned(L1_CACHE_BYTES)))
+#define __cacheline_aligned													\
+  __attribute__((aligned(L1_CACHE_BYTES), section(".data..cacheline_aligned")))
+
+#endif
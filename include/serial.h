@@ -0,0 +1,107 @@
+/**
+ * @file serial.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Interrupt-driven buffered PL011
+ *
+ * Output is queued in a TX ring and moved to the FIFO by the UART
+ * interrupt; input is moved from the FIFO to an RX ring. With
+ * hardware flow control (CTS/RTS wired in the uart_gpio) nothing is
+ * lost at any rate:
+ * - TX: the UART pauses while the host holds CTS off; the ring fills
+ *   and serial_putc() waits
+ * - RX: when the RX ring is full the receive interrupt is masked, the
+ *   FIFO fills up and the UART deasserts RTS until serial_getc() makes
+ *   room again
+ *
+ * The PL011s share one interrupt line (IRQ_UART), so there is a single
+ * buffered UART: the console, when built with CONSOLE_FLOW=y.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "event.h"
+#include "pl011.h"
+#include "printf.h"
+
+#define SERIAL_TX_SIZE 4096 /**< TX ring (power of 2) */
+#define SERIAL_RX_SIZE 256  /**< RX ring (power of 2) */
+
+/**
+ * @brief Buffer a UART (already set up with pl011_init()) and switch it
+ * to interrupts
+ * @param uart: UART to buffer
+ */
+void serial_init(pl011_uart *uart);
+
+/**
+ * @brief Whether serial_init() took over a UART
+ */
+int serial_active();
+
+/**
+ * @brief Queue a char, waiting for room if the TX ring is full
+ * @param p: unused (printf callback)
+ * @param c: char ('\n' is sent as CR LF)
+ */
+void serial_putc(void *p, char c);
+
+/**
+ * @brief printf output (init_vprintf()): format a whole call in place
+ * into the TX ring and queue it in one step
+ *
+ * '\n' is expanded to CR LF in place. If the output does not fit in the
+ * contiguous free space (ring nearly full or about to wrap), the call
+ * falls back to serial_putc() one char at a time.
+ */
+void serial_vprintf(char *fmt, va_list va);
+
+/**
+ * @brief Queue up to len bytes without waiting
+ * @return nr of bytes queued
+ */
+u32 serial_write(const void *buf, u32 len);
+
+/**
+ * @brief Take a received char
+ * @return the char, or -1 if none is waiting
+ */
+int serial_getc();
+
+/**
+ * @brief Queue a work item (on the core taking the UART interrupt)
+ * whenever chars are added to the RX ring
+ * @param w: work that reads them with serial_getc(), NULL for none
+ */
+void serial_set_rx_work(struct work *w);
+
+/**
+ * @brief Wait until everything queued has been sent
+ * @return 0, or -1 if the transmitter stalled for PL011_IDLE_TIMEOUT_US
+ * (CTS held deasserted); the rest stays queued
+ */
+int serial_flush();
+
+/**
+ * @brief Flush and hand the UART back to polled use (pl011_recv(),
+ * pl011_set_baud()...) until serial_resume()
+ * @return serial_flush()'s: the UART is paused either way
+ */
+int serial_pause();
+
+/**
+ * @brief Go back to interrupts after serial_pause()
+ */
+void serial_resume();
+
+/**
+ * @brief Stats: times the RX ring filled up (the sender was held back by
+ * RTS, or overran the FIFO without flow control), and times a writer
+ * waited on a full TX ring
+ */
+u32 serial_rx_throttled();
+u32 serial_tx_stalls();
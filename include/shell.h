@@ -0,0 +1,115 @@
+/**
+ * @file shell.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Console shell
+ *
+ * A line editor with history, fed one received char at a time from the
+ * kernel main loop (shell_input() never blocks), and a command registry.
+ * Commands are registered with SHELL_CMD() into the .shell_cmds linker
+ * section, like the .bench registry, so a module adds its commands
+ * without touching kernel.c:
+ *
+ *   SHELL_CMD(freq, "", "show the ARM clock and the governor state") {
+ *     cpufreq_report();
+ *     return 0;
+ *   }
+ *
+ * Editing keys: Left/Right (Ctrl-B/F), Home/End (Ctrl-A/E), Backspace,
+ * Ctrl-U (clear the line), Ctrl-C (drop the line), Up/Down (Ctrl-P/N
+ * are taken by the console hotkeys) browse the history. Everything
+ * lives in fixed buffers: nothing is allocated.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "pl011.h"
+
+#define SHELL_LINE_MAX 80 /**< Line length, including the terminator */
+#define SHELL_HISTORY 8   /**< Lines kept in the history */
+#define SHELL_MAX_ARGS 8  /**< argv entries, including the command */
+#define SHELL_PROMPT "> "
+
+/**
+ * @brief Command descriptor
+ */
+struct shell_cmd {
+  const char *name;  /**< What the user types */
+  const char *args;  /**< Argument synopsis, printed by help and on usage errors */
+  const char *help;  /**< One-line description */
+  int (*fn)(int argc, char **argv); /**< Returns 0, or -1 for a usage error */
+};
+
+#if defined(HOST_TEST)
+/**< Host: no linker script, the linker provides __start_/__stop_ */
+#define SHELL_CMD_SECTION "shell_cmds"
+#else
+#define SHELL_CMD_SECTION ".shell_cmds"
+#endif
+
+/**
+ * @brief Define and register a command
+ * @param id: command name (C identifier)
+ * @param args_str: argument synopsis ("" if none)
+ * @param help_str: one-line description
+ *
+ * Followed by the body of `int fn(int argc, char **argv)`
+ */
+#define SHELL_CMD(id, args_str, help_str)								\
+  static int shell_cmd_##id(int argc, char **argv);					\
+  static const struct shell_cmd shell_cmd_desc_##id					\
+  __attribute__((section(SHELL_CMD_SECTION), used, aligned(8))) = {	\
+	.name = #id, .args = args_str, .help = help_str, .fn = shell_cmd_##id \
+  };																	\
+  static int shell_cmd_##id(int argc, char **argv)
+
+/**
+ * @brief Reset the line editor and print the prompt
+ * @param uart: console UART, for the commands that need it (may be NULL)
+ */
+void shell_init(pl011_uart *uart);
+
+/**
+ * @brief Console UART given to shell_init()
+ */
+pl011_uart *shell_console();
+
+/**
+ * @brief Feed a received char to the line editor
+ * @param c: received char
+ *
+ * Runs the command when the line is complete (CR or LF)
+ */
+void shell_input(char c);
+
+/**
+ * @brief Split a line into arguments and run the command
+ * @param line: command line, modified in place
+ * @return the command's result; -1 for an unknown command or a usage
+ *         error (reported on the console), 0 for an empty line
+ */
+int shell_exec(char *line);
+
+/**
+ * @brief Parse an unsigned number: decimal, or hex with a 0x prefix
+ * @param s: string
+ * @param val: parsed value
+ * @return 0, or -1 if s is not a number
+ */
+int shell_parse_u64(const char *s, u64 *val);
+
+/**
+ * @brief Compare two strings
+ * @return 1 if equal, 0 otherwise
+ */
+int shell_streq(const char *a, const char *b);
+
+/**
+ * @brief Find a command by name
+ * @return descriptor, or NULL
+ */
+const struct shell_cmd *shell_find(const char *name);
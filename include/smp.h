@@ -0,0 +1,119 @@
+/**
+ * @file smp.h
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief Multi-core definitions
+ *
+ * Two ways to hand work to another core:
+ * - smp_run(): one long-running job per secondary core, run as work on
+ *   its event loop (e.g. a benchmark load); smp_wait() joins it
+ * - smp_call_function() / smp_post(): short functions, queued and run
+ *   in the target's IPI handler (IRQs masked), on any online core
+ *   including core 0
+ *
+ * Calls go through one lock-free single-producer single-consumer queue
+ * per (sender, target) pair, so posting takes no lock and never
+ * contends with another sender. The doorbell (IRQ_IPI) is only rung
+ * when the target has no interrupt outstanding: a burst of posts
+ * followed by smp_kick() (or posts made while the target is still
+ * draining) costs one interrupt.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+
+#define NR_CPUS 4 /**< Cortex-A53/A72 cluster size on the RPi 3/4 */
+
+/**
+ * @brief Get the id of the core we are running on
+ * @return core id (MPIDR_EL1.Aff0, 0 - NR_CPUS-1)
+ */
+static inline u32 smp_processor_id() {
+  u64 mpidr;
+  asm volatile("mrs %0, mpidr_el1" : "=r"(mpidr));
+  return mpidr & 0xFF;
+}
+
+#define SMP_SPIN_TABLE 0xD8 /**< Firmware spin table: 8 bytes per core */
+#define SMP_QUEUE_SIZE 64   /**< Calls queued per (sender, target) pair */
+
+/**
+ * @brief Work function run on another core
+ * @param arg: argument given to smp_run()
+ */
+typedef void (*smp_fn)(void *arg);
+
+/**
+ * @brief Release the secondary cores from the firmware spin table
+ *
+ * Each core sets itself up (stack, vectors) and runs event_loop(),
+ * asleep until work is queued on it. Cores that do not come up within a
+ * few ms stay offline.
+ */
+__cold void smp_init();
+
+/**
+ * @brief Check if a core is running the kernel
+ * @param core: core id
+ * @return 1 if online, 0 otherwise
+ */
+int smp_cpu_online(u32 core);
+
+/**
+ * @brief Run a function on a secondary core
+ * @param core: core id (1 - NR_CPUS-1)
+ * @param fn: function to run
+ * @param arg: passed to fn
+ * @return 0 if posted, -1 if the core is offline or still busy
+ */
+int smp_run(u32 core, smp_fn fn, void *arg);
+
+/**
+ * @brief Wait for the function posted to a core to return
+ * @param core: core id
+ */
+void smp_wait(u32 core);
+
+/**
+ * @brief Queue a call on a core without ringing its doorbell
+ * @param core: target core id (not the calling core)
+ * @param fn: function, run in the target's IPI handler
+ * @param arg: passed to fn
+ * @return 0 if queued, -1 if the core is offline or the queue is full
+ *
+ * Calls from one sender to one target run in the order posted. May be
+ * called with IRQs masked and from IRQ handlers.
+ */
+int smp_post(u32 core, smp_fn fn, void *arg);
+
+/**
+ * @brief Ring a core's doorbell for the calls queued so far (no-op if it
+ * is already rung and not yet handled)
+ * @param core: target core id
+ */
+void smp_kick(u32 core);
+
+/**
+ * @brief Queue a call on a core and ring its doorbell
+ * @return 0 if queued, -1 if the core is offline or the queue is full
+ */
+int smp_call_function(u32 core, smp_fn fn, void *arg);
+
+/**
+ * @brief Calls run by a core's IPI handler so far, and doorbells it took
+ * (calls / IPIs is the batching achieved)
+ * @param core: core id
+ */
+u64 smp_calls_handled(u32 core);
+u64 smp_ipis_handled(u32 core);
+
+/**
+ * @brief Entry point of the secondary cores (called from boot.S)
+ * @param core: core id
+ */
+void secondary_main(u32 core);
@@ -0,0 +1,107 @@
+/**
+ * @file spinlock.h
+ * @author Jose Pires
+ * @date 2024-10-16
+ *
+ * @brief Spinlocks
+ *
+ * Test-and-set lock on the exclusive monitor (LDAXR/STXR), waiting in
+ * WFE while the lock is held: the release store clears the waiters'
+ * exclusive monitors, which generates the wake-up event.
+ *
+ * Exclusives need Normal (cacheable) memory on the Cortex-A53/A72:
+ * every core turns its MMU on in boot.S (mmu.h), before any C code
+ * that could take a lock.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "irq.h"
+
+typedef struct {
+  volatile u32 lock; /**< 0: free, 1: held */
+} spinlock_t;
+
+#define SPINLOCK_INIT {.lock = 0}
+
+/**
+ * @brief Initialize a lock (free)
+ * @param l: lock
+ */
+static inline void spin_lock_init(spinlock_t *l) {
+  l->lock = 0;
+}
+
+/**
+ * @brief Take a lock, waiting as long as needed
+ * @param l: lock
+ *
+ * SEVL makes the first WFE fall through, so the fast path does not sleep
+ */
+static inline void spin_lock(spinlock_t *l) {
+  u32 tmp;
+
+  asm volatile(
+	"	sevl\n"
+	"1:	wfe\n"
+	"2:	ldaxr	%w0, [%1]\n"
+	"	cbnz	%w0, 1b\n"
+	"	stxr	%w0, %w2, [%1]\n"
+	"	cbnz	%w0, 2b\n"
+	: "=&r"(tmp)
+	: "r"(&l->lock), "r"(1)
+	: "memory");
+}
+
+/**
+ * @brief Try to take a lock without waiting
+ * @param l: lock
+ * @return 1 if the lock was taken, 0 if it is held
+ */
+static inline int spin_trylock(spinlock_t *l) {
+  u32 tmp;
+
+  asm volatile(
+	"1:	ldaxr	%w0, [%1]\n"
+	"	cbnz	%w0, 2f\n"
+	"	stxr	%w0, %w2, [%1]\n"
+	"	cbnz	%w0, 1b\n"
+	"2:\n"
+	: "=&r"(tmp)
+	: "r"(&l->lock), "r"(1)
+	: "memory");
+
+  return tmp == 0;
+}
+
+/**
+ * @brief Release a lock
+ * @param l: lock
+ */
+static inline void spin_unlock(spinlock_t *l) {
+  asm volatile("stlr wzr, [%0]" :: "r"(&l->lock) : "memory");
+}
+
+/**
+ * @brief Take a lock with the local IRQs masked
+ * @param l: lock
+ * @return IRQ state to give back to spin_unlock_irqrestore()
+ */
+static inline u64 spin_lock_irqsave(spinlock_t *l) {
+  u64 flags = irq_local_save();
+  spin_lock(l);
+  return flags;
+}
+
+/**
+ * @brief Release a lock taken with spin_lock_irqsave()
+ * @param l: lock
+ * @param flags: IRQ state returned by spin_lock_irqsave()
+ */
+static inline void spin_unlock_irqrestore(spinlock_t *l, u64 flags) {
+  spin_unlock(l);
+  irq_local_restore(flags);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file sprof.h
+ * @author Jose Pires
+ * @date 2024-10-15
+ *
+ * @brief Statistical sampling profiler
+ *
+ * A PMU event counter counts CPU cycles and overflows every N cycles;
+ * the overflow interrupt records the interrupted PC (ELR_EL1) in a
+ * per-core ring. sprof_stream() drains the rings to the console as
+ *
+ *   sprof: <core> <pc hex>
+ *
+ * lines, which scripts/sprof.py turns into a flat profile using the
+ * symbols of build/kernel8.elf (see `make sprof`).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+
+#define SPROF_COUNTER 5 /**< PMU event counter used (0-3 belong to prof.h) */
+#define SPROF_RING_SIZE 1024 /**< Samples per core (power of 2) */
+#define SPROF_DEFAULT_PERIOD 1000000 /**< Cycles between samples */
+
+/**
+ * @brief Start sampling on the calling core
+ * @param period: nr of cycles between samples
+ * @return 0 on success, -1 if the PMU lacks the counter
+ */
+int sprof_start(u32 period);
+
+/**
+ * @brief Stop sampling on the calling core
+ */
+void sprof_stop();
+
+/**
+ * @brief Check if sampling runs on the calling core
+ * @return 1 if active, 0 otherwise
+ */
+int sprof_active();
+
+/**
+ * @brief Send the buffered samples of every core to the console
+ * @return nr of samples sent
+ */
+u32 sprof_stream();
@@ -0,0 +1,75 @@
+/**
+ * @file sysregs.h
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief System register values used at boot
+ *
+ * Values programmed by boot.S to drop from EL2 to EL1 (see ARM ARM,
+ * D13: AArch64 System Register Descriptions)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+/**
+ * SCTLR_EL1, System Control Register (EL1)
+ */
+#define SCTLR_RESERVED ((3 << 28) | (3 << 22) | (1 << 20) | (1 << 11))
+#define SCTLR_EE_LITTLE_ENDIAN (0 << 25) /**< EL1 data little endian */
+#define SCTLR_EOE_LITTLE_ENDIAN (0 << 24) /**< EL0 data little endian */
+#define SCTLR_I_CACHE_DISABLED (0 << 12) /**< Instruction cache off */
+#define SCTLR_D_CACHE_DISABLED (0 << 2) /**< Data cache off */
+#define SCTLR_MMU_DISABLED (0 << 0) /**< MMU off */
+
+#define SCTLR_VALUE_MMU_DISABLED (SCTLR_RESERVED | SCTLR_EE_LITTLE_ENDIAN | \
+  SCTLR_EOE_LITTLE_ENDIAN | SCTLR_I_CACHE_DISABLED | \
+  SCTLR_D_CACHE_DISABLED | SCTLR_MMU_DISABLED)
+
+/**
+ * HCR_EL2, Hypervisor Configuration Register
+ */
+#define HCR_RW (1 << 31) /**< EL1 is AArch64 */
+#define HCR_VALUE HCR_RW
+
+/**
+ * CNTHCTL_EL2, Counter-timer Hypervisor Control register
+ */
+#define CNTHCTL_EL1PCTEN (1 << 0) /**< EL1 may read the physical counter */
+#define CNTHCTL_EL1PCEN (1 << 1) /**< EL1 may use the physical timer */
+#define CNTHCTL_VALUE (CNTHCTL_EL1PCTEN | CNTHCTL_EL1PCEN)
+
+/**
+ * SPSR_EL2, Saved Program Status Register (EL2)
+ */
+#define SPSR_MASK_ALL (7 << 6) /**< Mask IRQ, FIQ and SError */
+#define SPSR_EL1h (5 << 0) /**< Return to EL1, using SP_EL1 */
+#define SPSR_VALUE (SPSR_MASK_ALL | SPSR_EL1h)
+
+/**
+ * ESR_EL1, Exception Syndrome Register (EL1)
+ */
+#define ESR_ELx_EC_SHIFT 26 /**< Exception class (bits 31:26) */
+#define ESR_ELx_EC_MASK 0x3F
+#define ESR_ELx_EC_FP_ASIMD 0x07 /**< FP/SIMD access trapped by CPACR/CPTR */
+
+/**
+ * CPTR_EL2, Architectural Feature Trap Register (EL2)
+ */
+#define CPTR_EL2_RES1 ((3 << 12) | 0x3FF)
+#define CPTR_EL2_TFP (0 << 10) /**< FP/SIMD not trapped to EL2 */
+#define CPTR_EL2_VALUE (CPTR_EL2_RES1 | CPTR_EL2_TFP)
+
+/**
+ * CPACR_EL1, Architectural Feature Access Control Register
+ */
+#define CPACR_EL1_FPEN_TRAP (0 << 20) /**< FP/SIMD at EL0/EL1 traps to EL1 */
+#define CPACR_EL1_FPEN_ON (3 << 20) /**< FP/SIMD allowed at EL0/EL1 */
+
+/**
+ * CNTKCTL_EL1, Counter-timer Kernel Control Register
+ */
+#define CNTKCTL_EVNTEN (1 << 2) /**< Event stream on */
+#define CNTKCTL_EVNTI_SHIFT 4   /**< Counter bit whose 0->1 edge is an event */
+#define CNTKCTL_EVNTI_MASK (0xF << CNTKCTL_EVNTI_SHIFT)
@@ -0,0 +1,131 @@
+/**
+ * @file timer.h
+ * @author Jose Pires
+ * @date 2024-10-09
+ *
+ * @brief ARM generic timer interface
+ *
+ * The system counter (CNTPCT_EL0) runs at a fixed frequency
+ * (CNTFRQ_EL0, 54 MHz on the RPi 4), independent of the ARM clock, so
+ * it is the time base to use once the core frequency changes at
+ * runtime. The accessors are inline: reading the counter is a single
+ * instruction and it is used to time hot paths.
+ *
+ * Timer events run a work item (event.h) at a deadline, once or
+ * periodically. Each core keeps its own deadline-sorted list and
+ * programs its EL1 physical timer (CNTP) one-shot for the earliest one;
+ * the interrupt queues the expired work and re-arms:
+ *
+ *   static struct timer_event tick = TIMER_EVENT_INIT(tick_work, NULL);
+ *   timer_event_start(&tick, 1000, 1000);
+ *
+ * There is no periodic tick: an idle core with no event armed is not
+ * woken by the timer at all (idle.h).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "event.h"
+
+#define USEC_PER_SEC 1000000U
+#define TIMER_EVSTREAM_US 100 /**< Longest event stream period (udelay()) */
+
+/**
+ * @brief Read the system counter
+ * @return current count (ticks since the SoC was powered)
+ *
+ * The ISB keeps the read from being hoisted above earlier instructions
+ */
+static inline u64 timer_get_ticks() {
+  u64 ticks;
+  asm volatile("isb\n\tmrs %0, cntpct_el0" : "=r"(ticks) :: "memory");
+  return ticks;
+}
+
+/**
+ * @brief Read the system counter frequency
+ * @return frequency in Hz
+ */
+static inline u64 timer_get_freq() {
+  u64 freq;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+  return freq;
+}
+
+/**
+ * @brief Convert system counter ticks to microseconds
+ * @param ticks: nr of ticks
+ * @return microseconds
+ */
+static inline u64 timer_ticks_to_us(u64 ticks) {
+  return ticks * USEC_PER_SEC / timer_get_freq();
+}
+
+/**
+ * @brief Convert microseconds to system counter ticks
+ * @param us: microseconds
+ * @return ticks
+ */
+static inline u64 timer_us_to_ticks(u64 us) {
+  return us * timer_get_freq() / USEC_PER_SEC;
+}
+
+/**
+ * @brief Set up the calling core's generic timer: start the event
+ * stream (a WFE wake-up at most every TIMER_EVSTREAM_US)
+ *
+ * Called by every core before it uses udelay()
+ */
+__cold void timer_init_cpu();
+
+/**
+ * @brief Wait for a number of microseconds
+ * @param us: microseconds to wait
+ *
+ * Unlike delay(), the duration does not depend on the ARM clock. The
+ * core sleeps in WFE while more than one event stream period is left,
+ * and spins on the counter for the rest, so the wait ends on time.
+ */
+void udelay(u64 us);
+
+/**
+ * @brief Get the calling core's next timer event deadline
+ * @return deadline (system counter ticks), or 0 if no event is armed
+ *
+ * Call it with IRQs masked (the timer interrupt changes the list)
+ */
+u64 timer_next_deadline();
+
+/**
+ * @brief Work run at a deadline; statically allocated by its owner
+ */
+struct timer_event {
+  struct work work;         /**< Queued when the deadline passes */
+  u64 expires;              /**< Deadline (system counter ticks) */
+  u64 period;               /**< Re-arm interval (ticks), 0: one-shot */
+  struct timer_event *next; /**< Core list link, earliest first */
+  u32 armed;
+};
+
+#define TIMER_EVENT_INIT(f, a) { .work = WORK_INIT(f, a) }
+
+/**
+ * @brief Arm a timer event on the calling core
+ * @param t: timer event (re-armed if already running)
+ * @param delay_us: time to the first expiry
+ * @param period_us: then every period_us, or 0 for once
+ *
+ * The work runs on the calling core's event_loop(). A periodic event
+ * keeps its cadence: it is re-armed from its deadline, not from when
+ * the work ran, and a work still pending at the next expiry runs once.
+ */
+void timer_event_start(struct timer_event *t, u64 delay_us, u64 period_us);
+
+/**
+ * @brief Disarm a timer event (a work already queued still runs)
+ * @param t: timer event, armed by the calling core
+ */
+void timer_event_stop(struct timer_event *t);
@@ -0,0 +1,171 @@
+/**
+ * @file trace.h
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Event trace buffer
+ *
+ * TRACE(event, args...) records a fixed-size binary record (system
+ * counter timestamp, event id, core, up to 4 32-bit args) in the calling
+ * core's ring, without locks and without disabling IRQs, so it can be
+ * used from IRQ handlers and on every core at once. trace_stream()
+ * merges the rings by timestamp and prints the records on the console
+ * as
+ *
+ *   trace: <ticks> <core> <event> <arg> ...
+ *
+ * The system counter is common to all cores, so the merged stream is a
+ * single timeline. Tracing is compiled in with `make TRACE=y`
+ * (KERNEL_TRACE); otherwise TRACE() expands to nothing.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include "common.h"
+#include "sections.h"
+#include "smp.h"
+
+#define TRACE_RING_SIZE 256 /**< Records per core (power of 2) */
+#define TRACE_MAX_ARGS 4
+#define TRACE_STREAM_BATCH 16 /**< Records printed per trace_stream() call */
+
+/**
+ * @brief Event ids (names in trace.c)
+ */
+enum trace_event {
+  TRACE_EV_IRQ_ENTRY, /**< irq */
+  TRACE_EV_IRQ_EXIT,  /**< irq */
+  TRACE_EV_SMP_POST,  /**< target core */
+  TRACE_EV_SMP_START, /**< - */
+  TRACE_EV_SMP_DONE,  /**< - */
+  TRACE_EV_FREQ,      /**< old rate, new rate (Hz) */
+  TRACE_EV_USER,      /**< free for ad-hoc tracing */
+  TRACE_EV_NR
+};
+
+/**
+ * @brief Trace record (32 bytes, two per cache line)
+ */
+struct trace_rec {
+  u64 ts;    /**< System counter (CNTPCT_EL0) */
+  u16 event; /**< enum trace_event */
+  u8 core;
+  u8 nargs;
+  u32 seq;   /**< Slot nr + 1 once the record is complete */
+  u32 args[TRACE_MAX_ARGS];
+};
+
+/**
+ * @brief Per-core record ring
+ *
+ * Writers are the owning core, in thread context or in any IRQ handler
+ * that interrupts it: a slot is reserved by a compare-and-swap of head
+ * and published by a release store of its seq. The drainer owns tail.
+ */
+struct trace_ring {
+  u32 head;    /**< Next slot to reserve (writers) */
+  u32 dropped; /**< Records lost to a full ring */
+  u32 tail ____cacheline_aligned; /**< Next slot to read (drainer) */
+  struct trace_rec rec[TRACE_RING_SIZE] ____cacheline_aligned;
+} ____cacheline_aligned;
+
+/**
+ * @brief Record sink of trace_drain()
+ */
+typedef void (*trace_sink)(const struct trace_rec *rec, void *arg);
+
+/**
+ * @brief Timestamp source
+ *
+ * Read inside the slot reservation, so records of a ring are in
+ * timestamp order even when an IRQ handler traces in between
+ */
+#if defined(HOST_TEST)
+u64 trace_clock();
+#else
+#include "timer.h"
+static inline u64 trace_clock() {
+  return timer_get_ticks();
+}
+#endif
+
+/**
+ * @brief Append a record to a ring
+ * @param ring: the calling core's ring
+ * @param core: the calling core
+ * @param event: event id
+ * @param nargs: nr of args used (<= TRACE_MAX_ARGS)
+ * @param a0..a3: args
+ * @return 0, or -1 if the ring was full (the record is dropped)
+ */
+int trace_ring_write(struct trace_ring *ring, u32 core, u32 event, u32 nargs,
+					 u32 a0, u32 a1, u32 a2, u32 a3);
+
+/**
+ * @brief Merge the rings by timestamp into a sink
+ * @param rings: array of rings
+ * @param n: nr of rings
+ * @param max: max nr of records to drain (bounds the time spent)
+ * @param sink: called once per record, oldest first
+ * @param arg: sink argument
+ * @return nr of records drained
+ *
+ * Stops at the first slot of a ring still being written, and drains
+ * nothing past it, so records never come out of order within a ring.
+ * Across rings the order holds for what was published when the drain
+ * ran: a record published later may be older than one already drained.
+ */
+u32 trace_drain(struct trace_ring *rings, u32 n, u32 max, trace_sink sink,
+				void *arg);
+
+/**
+ * @brief Take (and clear) the count of records dropped by a ring
+ */
+u32 trace_ring_dropped(struct trace_ring *ring);
+
+/**
+ * @brief Name of an event id
+ */
+const char *trace_event_name(u32 event);
+
+/**
+ * @brief The kernel's rings, one per core
+ */
+extern struct trace_ring trace_rings[NR_CPUS];
+
+/**
+ * @brief Print up to max merged records (and drop counts) on the console
+ * @return nr of records printed
+ */
+u32 trace_stream(u32 max);
+
+/**
+ * @brief Hand up to max merged records to a sink instead (e.g. as binary
+ * frames on the link.h trace channel); drop counts still go to the
+ * console
+ * @return nr of records drained
+ */
+u32 trace_stream_to(u32 max, trace_sink sink, void *arg);
+
+#define __TRACE_NARGS(...) __TRACE_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define __TRACE_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define __TRACE_ARGS(_0, a0, a1, a2, a3, ...) (a0), (a1), (a2), (a3)
+
+#if defined(KERNEL_TRACE) && !defined(HOST_TEST)
+/**
+ * @brief Record an event on the calling core
+ * @param event: TRACE_EV_* (without the prefix)
+ * @param ...: up to 4 args, truncated to 32 bits
+ */
+#define TRACE(event, ...)												\
+  do {																	\
+	u32 __core = smp_processor_id();									\
+	trace_ring_write(&trace_rings[__core], __core, TRACE_EV_##event,	\
+					 __TRACE_NARGS(__VA_ARGS__),						\
+					 __TRACE_ARGS(0, ##__VA_ARGS__, 0, 0, 0, 0));			\
+  } while (0)
+#else
+#define TRACE(event, ...) do { } while (0)
+#endif
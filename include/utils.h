@@ -19,6 +19,8 @@
  * @param ticks: nr of ticks to delay
  *
  * Creates a delay for a specified nr of ticks
+ * - The duration scales with the ARM clock (see cpufreq.h); use
+ *   udelay() (timer.h) when a wall-clock duration is needed
  */
 void delay(u64 ticks);
 
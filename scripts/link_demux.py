@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""Host side of the framed console link (include/link.h).
+
+Switches the kernel console to framed mode (`link on`) and splits the
+frames back into their channels:
+- console: to stdout; keystrokes go back as console frames (Ctrl-] quits)
+- trace:   struct trace_rec records, one text line each, to --trace
+           (default stderr)
+- bulk:    appended to --bulk (`link send <addr> <len>` on the board)
+
+Frames are checked (COBS, CRC-32) and delivered in sequence order. A gap
+in the sequence is asked for again with a NAK on the control channel; if
+the board answers LOST (the frame left its history), or nothing comes
+within --gap-timeout, the gap is skipped and reported.
+
+Usage:
+    scripts/link_demux.py [--port /dev/ttyUSB0] [--baud 115200]
+        [--rtscts] [--trace trace.txt] [--bulk dump.bin]
+"""
+
+import argparse
+import os
+import selectors
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+import uart_boot
+
+LINK_MTU = 248
+LINK_HISTORY = 16
+CH_CTL, CH_CONSOLE, CH_TRACE, CH_BULK = range(4)
+CTL_NAK, CTL_LOST = 1, 2
+QUIT = b"\x1d"  # Ctrl-]
+
+TRACE_REC = struct.Struct("<QHBBI4I")  # struct trace_rec, 32 bytes
+TRACE_EVENTS = ["irq_entry", "irq_exit", "smp_post", "smp_start",
+                "smp_done", "freq", "user"]  # enum trace_event
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+            continue
+        block.append(b)
+        if len(block) == 254:
+            out += b"\xff" + block
+            block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+def cobs_decode(data):
+    """Decoded bytes, or None if data is not valid COBS."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Link:
+    """Framing, sequencing and the NAK/LOST protocol."""
+
+    def __init__(self, fd, gap_timeout):
+        self.fd = fd
+        self.gap_timeout = gap_timeout
+        self.tx_seq = 0
+        self.rx = bytearray()
+        self.expect = None  # next seq to deliver
+        self.pending = {}  # seq -> (chan, payload), ahead of expect
+        self.gap_since = None
+        self.bad = self.skipped = self.naks = 0
+
+    def send(self, chan, payload):
+        for i in range(0, max(len(payload), 1), LINK_MTU):
+            frame = bytes([chan, self.tx_seq]) + payload[i:i + LINK_MTU]
+            frame += struct.pack("<I", zlib.crc32(frame))
+            self.tx_seq = (self.tx_seq + 1) & 0xFF
+            os.write(self.fd, b"\0" + cobs_encode(frame) + b"\0")
+
+    def feed(self, data):
+        """Bytes from the port; yields the (chan, payload) in order."""
+        for b in data:
+            if b != 0:
+                self.rx.append(b)
+                continue
+            enc, self.rx = bytes(self.rx), bytearray()
+            if not enc:
+                continue
+            frame = cobs_decode(enc)
+            if (frame is None or len(frame) < 6 or
+                    zlib.crc32(frame[:-4]) != struct.unpack("<I", frame[-4:])[0]):
+                self.bad += 1
+                continue
+            yield from self.frame(frame[0], frame[1], frame[2:-4])
+        yield from self.check_gap()
+
+    def frame(self, chan, seq, payload):
+        if chan == CH_CTL and len(payload) >= 2 and payload[0] == CTL_LOST:
+            self.lost(payload[1])
+        if self.expect is None:
+            self.expect = seq
+        ahead = (seq - self.expect) & 0xFF
+        if ahead >= 128 or seq in self.pending:
+            return  # duplicate, or already given up on
+        if ahead and not self.pending:
+            self.gap_since = time.monotonic()
+            for s in range(self.expect, self.expect + ahead):
+                self.nak(s & 0xFF)
+        elif ahead:
+            # NAK the new holes between the last pending frame and seq
+            last = max((s - self.expect) & 0xFF for s in self.pending)
+            for d in range(last + 1, ahead):
+                self.nak((self.expect + d) & 0xFF)
+        self.pending[seq] = (chan, payload)
+        yield from self.deliver()
+
+    def nak(self, seq):
+        self.naks += 1
+        self.send(CH_CTL, bytes([CTL_NAK, seq]))
+
+    def lost(self, seq):
+        if self.expect is not None and (seq - self.expect) & 0xFF < 128:
+            self.pending.setdefault(seq, None)
+
+    def deliver(self):
+        moved = False
+        while self.expect in self.pending:
+            item = self.pending.pop(self.expect)
+            if item is None:
+                self.skip()
+            elif item[0] != CH_CTL:
+                yield item
+            self.expect = (self.expect + 1) & 0xFF
+            moved = True
+        if not self.pending:
+            self.gap_since = None
+        elif moved:
+            self.gap_since = time.monotonic()  # next gap starts now
+
+    def check_gap(self):
+        if (self.gap_since is not None and
+                time.monotonic() - self.gap_since > self.gap_timeout):
+            self.pending.setdefault(self.expect, None)
+            yield from self.deliver()
+
+    def skip(self):
+        self.skipped += 1
+        print("\r\nlink_demux: frame %d lost\r" % self.expect, file=sys.stderr)
+
+
+def trace_line(rec):
+    ts, event, core, nargs, seq, *args = TRACE_REC.unpack(rec)
+    name = TRACE_EVENTS[event] if event < len(TRACE_EVENTS) else str(event)
+    return "%d core%d %s %s\n" % (ts, core, name,
+                                  " ".join("%#x" % a for a in args[:nargs]))
+
+
+def output(frames, trace, bulk):
+    """Route the delivered frames to their channel's output."""
+    for chan, payload in frames:
+        if chan == CH_CONSOLE:
+            os.write(sys.stdout.fileno(), payload.replace(b"\n", b"\r\n"))
+        elif chan == CH_TRACE:
+            for i in range(0, len(payload) - TRACE_REC.size + 1,
+                           TRACE_REC.size):
+                trace.write(trace_line(payload[i:i + TRACE_REC.size]))
+            trace.flush()
+        elif chan == CH_BULK and bulk:
+            bulk.write(payload)
+            bulk.flush()
+
+
+def run(fd, link, trace, bulk):
+    """Relay port <-> stdin/stdout until Ctrl-]."""
+    stdin = sys.stdin.fileno()
+    old = termios.tcgetattr(stdin) if os.isatty(stdin) else None
+    if old:
+        tty.setraw(stdin)
+    sel = selectors.DefaultSelector()
+    sel.register(fd, selectors.EVENT_READ)
+    sel.register(stdin, selectors.EVENT_READ)
+    try:
+        while True:
+            events = sel.select(link.gap_timeout / 2)
+            if not events:
+                output(link.feed(b""), trace, bulk)  # gap timeout only
+            for key, _ in events:
+                data = os.read(key.fd, 4096)
+                if key.fd == fd:
+                    output(link.feed(data), trace, bulk)
+                elif not data or QUIT in data:
+                    return
+                else:
+                    link.send(CH_CONSOLE, data)
+    finally:
+        if old:
+            termios.tcsetattr(stdin, termios.TCSADRAIN, old)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--port", default="/dev/ttyUSB0")
+    ap.add_argument("--baud", type=int, default=115200, help="CONSOLE_BAUD")
+    ap.add_argument("--rtscts", action="store_true",
+                    help="RTS/CTS flow control (CONSOLE_FLOW=y)")
+    ap.add_argument("--no-start", action="store_true",
+                    help="do not send `link on` (already in framed mode)")
+    ap.add_argument("--trace", help="trace records to this file")
+    ap.add_argument("--bulk", help="append bulk data to this file")
+    ap.add_argument("--gap-timeout", type=float, default=0.5,
+                    help="seconds to wait for a NAKed frame")
+    args = ap.parse_args()
+
+    uart_boot.rtscts = args.rtscts
+    fd = uart_boot.open_port(args.port, args.baud)
+    trace = open(args.trace, "w") if args.trace else sys.stderr
+    bulk = open(args.bulk, "ab") if args.bulk else None
+    link = Link(fd, args.gap_timeout)
+    try:
+        if not args.no_start:
+            os.write(fd, b"link on\r")
+        print("link_demux: Ctrl-] to quit", file=sys.stderr)
+        run(fd, link, trace, bulk)
+    finally:
+        print("link_demux: %d bad, %d NAKs, %d lost" %
+              (link.bad, link.naks, link.skipped), file=sys.stderr)
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Boot the kernel under QEMU and check its console output.
+
+Runs qemu-system-aarch64 with the PL011 (UART0) on a pipe, waits for
+each expected pattern in order and then reports:
+  - the boot-to-kernel_main time printed by the kernel ('BOOT ...') and
+    its per-phase breakdown ('BOOT phase=...')
+  - the host time until the first console byte and until the last match
+  - the benchmark results ('BENCH name=...'), when the image runs them
+
+The kernel must be built with CONSOLE_UART=0 (QEMU emulates UART0 only);
+'make qemu-test' takes care of that.
+
+Exit status: 0 when every pattern matched before the timeout.
+
+Usage:
+    scripts/qemu_test.py build/qemu/kernel8.img [--machine raspi4b]
+        [--expect REGEX ...] [--timeout 30] [--log console.txt]
+"""
+
+import argparse
+import os
+import re
+import selectors
+import subprocess
+import sys
+import time
+
+DEFAULT_EXPECT = [r"Baremetal", r"BOOT kernel_main_ticks=", r"EL = 1"]
+BOOT_RE = re.compile(r"BOOT kernel_main_ticks=(\d+) kernel_main_us=(\d+) "
+                     r"timer_hz=(\d+)")
+BOOT_PHASE_RE = re.compile(r"BOOT phase=(\S+) us=(\d+) end_us=(\d+)")
+BENCH_RE = re.compile(r"BENCH name=(\S+) (.*)")
+
+
+def parse_bench(line):
+    """'BENCH name=x unit=y k=v ...' -> (name, {k: v})."""
+    m = BENCH_RE.search(line)
+    if not m:
+        return None
+    fields = dict(kv.split("=", 1) for kv in m.group(2).split() if "=" in kv)
+    return m.group(1), fields
+
+
+def run(args):
+    cmd = [args.qemu, "-M", args.machine, "-kernel", args.kernel,
+           "-display", "none", "-monitor", "none", "-serial", "stdio"]
+    cmd += args.qemu_arg
+    print("qemu_test: " + " ".join(cmd), file=sys.stderr)
+
+    t0 = time.monotonic()
+    proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT)
+    sel = selectors.DefaultSelector()
+    sel.register(proc.stdout, selectors.EVENT_READ)
+
+    expect = [re.compile(e) for e in args.expect]
+    log = open(args.log, "w") if args.log else None
+    first_byte = last_match = None
+    boot = None
+    phases = []
+    benches = []
+    pending = b""
+    deadline = t0 + args.timeout
+
+    try:
+        while expect and time.monotonic() < deadline:
+            if not sel.select(timeout=max(0.0, deadline - time.monotonic())):
+                break
+            data = os.read(proc.stdout.fileno(), 4096)
+            if not data:
+                break
+            if first_byte is None:
+                first_byte = time.monotonic() - t0
+            pending += data
+            *lines, pending = pending.split(b"\n")
+            for raw in lines:
+                line = raw.decode(errors="replace").rstrip("\r")
+                if log:
+                    log.write(line + "\n")
+                if args.verbose:
+                    print(line)
+                m = BOOT_RE.search(line)
+                if m:
+                    boot = tuple(int(g) for g in m.groups())
+                m = BOOT_PHASE_RE.search(line)
+                if m:
+                    phases.append((m.group(1), int(m.group(2)), int(m.group(3))))
+                b = parse_bench(line)
+                if b:
+                    benches.append(b)
+                if expect and expect[0].search(line):
+                    expect.pop(0)
+                    last_match = time.monotonic() - t0
+    finally:
+        proc.kill()
+        proc.wait()
+        if log:
+            log.close()
+
+    print("qemu_test: machine=%s kernel=%s" % (args.machine, args.kernel))
+    if first_byte is not None:
+        print("  host: first output %.3f s" % first_byte)
+    if last_match is not None:
+        print("  host: last expected line %.3f s" % last_match)
+    if boot:
+        print("  boot: kernel_main after %u ticks (%u us at %u Hz)" % boot)
+    for name, us, end in phases:
+        print("  boot phase %-14s %10u us (done at %u us)" % (name, us, end))
+    for name, f in benches:
+        print("  bench %-20s %12s ns_avg %14s %s/s" %
+              (name, f.get("ns_avg", "?"), f.get("units_per_s", "?"),
+               f.get("unit", "units")))
+
+    if expect:
+        print("qemu_test: FAIL, no match for %r within %.0f s" %
+              (expect[0].pattern, args.timeout))
+        return 1
+    print("qemu_test: PASS")
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("kernel", help="kernel image (build/qemu/kernel8.img)")
+    ap.add_argument("--qemu", default="qemu-system-aarch64")
+    ap.add_argument("--machine", default="raspi4b", help="raspi4b or raspi3b")
+    ap.add_argument("--expect", action="append",
+                    help="regex expected on the console, in order "
+                    "(default: banner, BOOT line, EL = 1)")
+    ap.add_argument("--bench", action="store_true",
+                    help="also expect the benchmark run to complete")
+    ap.add_argument("--timeout", type=float, default=30.0)
+    ap.add_argument("--log", help="save the console output")
+    ap.add_argument("--qemu-arg", action="append", default=[],
+                    help="extra QEMU argument (repeatable)")
+    ap.add_argument("-v", "--verbose", action="store_true", help="echo the console")
+    args = ap.parse_args()
+
+    if args.expect is None:
+        args.expect = list(DEFAULT_EXPECT)
+    if args.bench:
+        args.expect.append(r"BENCH_END")
+    sys.exit(run(args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Flat profile from the kernel sampling profiler (src/sprof.c).
+
+Reads a console capture containing 'sprof: <core> <pc hex>' lines,
+resolves each PC to the function containing it using the symbols of
+build/kernel8.elf and prints the functions sorted by sample count.
+
+Symbols come from '$(ARMGNU)-nm -n <elf>', or from the objdump symbol
+table written by 'make disassemble' (build/kernel8_asm_symbol.txt).
+
+Usage:
+    scripts/sprof.py capture.txt [--elf build/kernel8.elf] [--per-core]
+    cat /dev/ttyUSB0 | scripts/sprof.py -
+"""
+
+import argparse
+import bisect
+import collections
+import os
+import re
+import subprocess
+import sys
+
+SAMPLE_RE = re.compile(r"sprof: (\d+) ([0-9a-fA-F]+)\s*$")
+DROPPED_RE = re.compile(r"sprof: (\d+) dropped (\d+)")
+
+
+def load_symbols_nm(elf, nm):
+    """Function symbols (addr, name) from nm, sorted by address."""
+    out = subprocess.run([nm, "-n", elf], check=True, capture_output=True,
+                         text=True).stdout
+    syms = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "tTwW":
+            syms.append((int(parts[0], 16), parts[2]))
+    return syms
+
+
+def load_symbols_objdump(path):
+    """Function symbols from 'objdump -t' output (make disassemble)."""
+    syms = []
+    with open(path) as f:
+        for line in f:
+            parts = line.split()
+            # 0000000000080000 g     F .text.boot	0000000000000010 _start
+            if len(parts) >= 5 and re.fullmatch(r"[0-9a-fA-F]{8,16}", parts[0]) \
+                    and ".text" in line:
+                syms.append((int(parts[0], 16), parts[-1]))
+    syms.sort()
+    return syms
+
+
+def resolve(syms, addrs, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    return syms[i][1] if i >= 0 else "0x%x" % pc
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("log", help="console capture ('-' for stdin)")
+    ap.add_argument("--elf", default="build/kernel8.elf")
+    ap.add_argument("--nm", default=os.environ.get("ARMGNU", "aarch64-linux-gnu") + "-nm")
+    ap.add_argument("--symbols", help="objdump -t output to use instead of nm")
+    ap.add_argument("--per-core", action="store_true", help="one profile per core")
+    ap.add_argument("--top", type=int, default=30)
+    args = ap.parse_args()
+
+    if args.symbols:
+        syms = load_symbols_objdump(args.symbols)
+    else:
+        syms = load_symbols_nm(args.elf, args.nm)
+    addrs = [a for a, _ in syms]
+
+    counts = collections.defaultdict(collections.Counter)
+    dropped = collections.Counter()
+    src = sys.stdin if args.log == "-" else open(args.log, errors="replace")
+    for line in src:
+        m = SAMPLE_RE.search(line)
+        if m:
+            core = int(m.group(1)) if args.per_core else "all"
+            counts[core][resolve(syms, addrs, int(m.group(2), 16))] += 1
+            continue
+        m = DROPPED_RE.search(line)
+        if m:
+            dropped[int(m.group(1))] += int(m.group(2))
+
+    for core in sorted(counts, key=str):
+        total = sum(counts[core].values())
+        print("core %s: %d samples" % (core, total))
+        print("%8s %7s  %s" % ("samples", "%", "function"))
+        for fn, n in counts[core].most_common(args.top):
+            print("%8d %6.2f%%  %s" % (n, 100.0 * n / total, fn))
+        print()
+    for core, n in sorted(dropped.items()):
+        print("core %d: %d samples dropped (ring full)" % (core, n))
+
+
+if __name__ == "__main__":
+    main()
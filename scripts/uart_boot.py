@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""Send a kernel to the UART chain-loader (bootloader/, see loader.h).
+
+Opens the serial port raw at the loader baud rate, sends the header
+(magic, size, CRC-32) and the image, and checks the loader replies.
+With --console it then stays on the port as a terminal: the kernel's
+output goes to stdout and keystrokes (Ctrl-P, Ctrl-T, ...) to the
+board; Ctrl-] quits.
+
+The kernel reprograms the UART to CONSOLE_BAUD when it starts;
+--console-baud switches the host side to match once the image is sent.
+The console also follows the kernel's `baud` shell command (see
+include/baud.h): it switches on "BAUD <rate>" and acknowledges, and
+answers "BAUD DETECT" with a burst of 'U's at the current rate.
+
+Usage:
+    scripts/uart_boot.py build/kernel8.img [--port /dev/ttyUSB0]
+        [--baud 921600] [--wait] [--console]
+"""
+
+import argparse
+import os
+import re
+import selectors
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+LOADER_MAGIC = 0x4C425052  # "RPBL"
+READY = b"rpios-loader: ready"
+REPLIES = {b"OK": "ok", b"SZ": "image too big", b"CR": "CRC mismatch",
+           b"TO": "loader timed out"}
+QUIT = b"\x1d"  # Ctrl-]
+BAUD_RE = re.compile(rb"BAUD (\d+)\r?\n")  # board switches to this rate
+BAUD_OK = b"BAUD OK"
+BAUD_DETECT = b"BAUD DETECT"
+BAUD_ACK_TIMEOUT = 2.0  # BAUD_ACK_TIMEOUT_US
+
+
+def open_port(path, baud):
+    """Open the port raw (8N1, no flow control) at baud."""
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    set_baud(fd, baud)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def set_baud(fd, baud):
+    speed = getattr(termios, "B%d" % baud, None)
+    if speed is None:
+        sys.exit("uart_boot: unsupported baud rate %d" % baud)
+    set_speed(fd, speed)
+
+
+# RTS/CTS on the console (kernel built with CONSOLE_FLOW=y); the loader
+# never uses it
+rtscts = False
+
+
+def set_speed(fd, speed):
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[2] &= ~(termios.CSTOPB | termios.PARENB | termios.CRTSCTS)
+    attrs[2] |= termios.CLOCAL | termios.CREAD
+    if rtscts:
+        attrs[2] |= termios.CRTSCTS
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+
+
+def read_until(fd, pred, timeout):
+    """Read until pred(data) or the timeout; returns the data read."""
+    data = b""
+    deadline = time.monotonic() + timeout
+    sel = selectors.DefaultSelector()
+    sel.register(fd, selectors.EVENT_READ)
+    while not pred(data):
+        left = deadline - time.monotonic()
+        if left <= 0 or not sel.select(timeout=left):
+            break
+        data += os.read(fd, 4096)
+    sel.close()
+    return data
+
+
+def wait_reply(fd, timeout):
+    """First loader reply code seen on the line, or None."""
+    def find(data):
+        hits = [(data.find(k), k) for k in REPLIES if k in data]
+        return min(hits)[1] if hits else None
+    return find(read_until(fd, find, timeout))
+
+
+def send(fd, image, timeout):
+    header = struct.pack("<III", LOADER_MAGIC, len(image), zlib.crc32(image))
+    os.write(fd, header)
+    reply = wait_reply(fd, timeout)
+    if reply != b"OK":
+        sys.exit("uart_boot: header rejected: %s" % REPLIES.get(reply, "no reply"))
+
+    t0 = time.monotonic()
+    view = memoryview(image)
+    while view:
+        n = os.write(fd, view[:4096])
+        view = view[n:]
+    termios.tcdrain(fd)
+    reply = wait_reply(fd, timeout)
+    dt = time.monotonic() - t0
+    if reply != b"OK":
+        sys.exit("uart_boot: transfer failed: %s" % REPLIES.get(reply, "no reply"))
+    print("uart_boot: sent %d bytes in %.2f s (%.0f KiB/s)" %
+          (len(image), dt, len(image) / dt / 1024), file=sys.stderr)
+
+
+def follow_baud(fd, old, new):
+    """Switch with the board and acknowledge; returns the rate in use.
+
+    The board falls back to the old rate when the "OK" does not arrive
+    in time, so go back too if its "BAUD OK" does not show up.
+    """
+    speed = getattr(termios, "B%d" % new, None)
+    if speed is None:
+        print("\r\nuart_boot: baud %d unsupported here, staying at %d\r" %
+              (new, old), file=sys.stderr)
+        return old
+    termios.tcdrain(fd)
+    set_speed(fd, speed)
+    time.sleep(0.01)
+    os.write(fd, b"OK")
+    data = read_until(fd, lambda d: BAUD_OK in d, BAUD_ACK_TIMEOUT + 1)
+    os.write(sys.stdout.fileno(), data)
+    if BAUD_OK not in data:
+        set_baud(fd, old)
+        return old
+    return new
+
+
+def console(fd, baud):
+    """Relay port <-> stdin/stdout until Ctrl-]."""
+    print("uart_boot: console, Ctrl-] to quit", file=sys.stderr)
+    stdin = sys.stdin.fileno()
+    old = termios.tcgetattr(stdin) if os.isatty(stdin) else None
+    if old:
+        tty.setraw(stdin)
+    sel = selectors.DefaultSelector()
+    sel.register(fd, selectors.EVENT_READ)
+    sel.register(stdin, selectors.EVENT_READ)
+    tail = b""
+    try:
+        while True:
+            for key, _ in sel.select():
+                data = os.read(key.fd, 4096)
+                if key.fd == fd:
+                    os.write(sys.stdout.fileno(), data)
+                    tail = (tail + data)[-64:]
+                    m = BAUD_RE.search(tail)
+                    if m:
+                        tail = b""
+                        baud = follow_baud(fd, baud, int(m.group(1)))
+                    elif BAUD_DETECT in tail:
+                        tail = b""
+                        os.write(fd, b"U" * 64)
+                elif not data or QUIT in data:
+                    return
+                else:
+                    os.write(fd, data)
+    finally:
+        if old:
+            termios.tcsetattr(stdin, termios.TCSADRAIN, old)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image", help="kernel image (build/kernel8.img)")
+    ap.add_argument("--port", default="/dev/ttyUSB0")
+    ap.add_argument("--baud", type=int, default=921600, help="LOADER_BAUD")
+    ap.add_argument("--wait", action="store_true",
+                    help="wait for the loader banner (reset the board now)")
+    ap.add_argument("--timeout", type=float, default=5.0)
+    ap.add_argument("--console", action="store_true",
+                    help="stay on the port as a terminal after the transfer")
+    ap.add_argument("--console-baud", type=int, default=115200)
+    ap.add_argument("--rtscts", action="store_true",
+                    help="RTS/CTS flow control on the console (CONSOLE_FLOW=y)")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+
+    fd = open_port(args.port, args.baud)
+    try:
+        if args.wait:
+            print("uart_boot: waiting for the loader...", file=sys.stderr)
+            if READY not in read_until(fd, lambda d: READY in d, 3600):
+                sys.exit("uart_boot: no loader banner")
+        send(fd, image, args.timeout)
+        if args.console:
+            global rtscts
+            rtscts = args.rtscts
+            if args.console_baud != args.baud or rtscts:
+                set_baud(fd, args.console_baud)
+            console(fd, args.console_baud)
+    finally:
+        os.close(fd)
+
+
+if __name__ == "__main__":
+    main()
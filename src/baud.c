@@ -0,0 +1,246 @@
+/**
+ * @file baud.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Console baud rate negotiation and detection (protocol in
+ * baud.h)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "baud.h"
+#include "gpio.h"
+#include "printf.h"
+#include "serial.h"
+#include "shell.h"
+#include "timer.h"
+
+#define BAUD_FLUSH_QUIET_US 20000 /**< RX silence that ends the flush */
+
+static u32 baud_rate = 115200;
+
+u32 baud_get_rate() {
+  return baud_rate;
+}
+
+void baud_set_rate(u32 rate) {
+  baud_rate = rate;
+}
+
+static u64 baud_us_to_ticks(u64 us) {
+  return us * timer_get_freq() / USEC_PER_SEC;
+}
+
+/**
+ * Send out everything printed so far, buffered or not; -1 if the
+ * transmitter stalls (CTS held deasserted)
+ */
+static int baud_drain(pl011_uart *uart) {
+  if (serial_active()) {
+	return serial_flush();
+  }
+  return pl011_wait_idle(uart);
+}
+
+/**
+ * Wait for the host's acknowledge, matching it anywhere in the input
+ * (the host may send noise while it switches)
+ */
+static int baud_wait_ack(pl011_uart *uart) {
+  const char *ack = BAUD_ACK;
+  u64 start = timer_get_ticks();
+  u64 timeout = baud_us_to_ticks(BAUD_ACK_TIMEOUT_US);
+  u32 matched = 0;
+  char c;
+
+  while (timer_get_ticks() - start < timeout) {
+	if (!pl011_can_recv(uart)) {
+	  continue;
+	}
+	c = pl011_recv(uart);
+	if (c == ack[matched]) {
+	  if (!ack[++matched]) {
+		return 0;
+	  }
+	} else {
+	  matched = (c == ack[0]);
+	}
+  }
+  return -1;
+}
+
+/**
+ * Drop received chars until the line has been quiet for a while (the
+ * tail of the host's 'U's)
+ */
+static void baud_flush_rx(pl011_uart *uart) {
+  u64 quiet = baud_us_to_ticks(BAUD_FLUSH_QUIET_US);
+  u64 last = timer_get_ticks();
+
+  while (timer_get_ticks() - last < quiet) {
+	if (pl011_can_recv(uart)) {
+	  pl011_recv(uart);
+	  last = timer_get_ticks();
+	}
+  }
+}
+
+/**
+ * Negotiate
+ * - Take the UART back from the buffered driver, if it has it: the
+ *   exchange polls the UART directly
+ * - Announce at the old rate and let it go out before switching; if the
+ *   output does not drain (flow control stalled), keep the old rate
+ * - Wait for the host's "OK" at the new rate, or fall back
+ */
+int baud_negotiate(pl011_uart *uart, u32 rate) {
+  u32 old = baud_rate;
+  int stalled = 0;
+  int ret = 0;
+
+  if (rate == 0 || rate > pl011_get_uartclk() / 16) {
+	return -1;
+  }
+  if (serial_active()) {
+	stalled = serial_pause();
+  }
+  if (!stalled) {
+	printf(BAUD_ANNOUNCE "%u\n", rate);
+	stalled = baud_drain(uart) || pl011_set_baud(uart, rate);
+  }
+
+  if (stalled) {
+	printf("BAUD FAIL %u (TX stalled)\n", rate);
+	ret = -1;
+  } else if (baud_wait_ack(uart)) {
+	pl011_set_baud(uart, old);
+	printf("BAUD FAIL %u\n", rate);
+	ret = -1;
+  } else {
+	baud_rate = rate;
+	printf("BAUD OK %u\n", rate);
+  }
+  if (serial_active()) {
+	serial_resume();
+  }
+  return ret;
+}
+
+/**
+ * Wait for a GPIO level, timestamping when it is seen
+ */
+static int baud_wait_level(u8 pin, u32 level, u64 deadline, u64 *when) {
+  u64 now;
+
+  do {
+	now = timer_get_ticks();
+	if (now > deadline) {
+	  return -1;
+	}
+  } while (gpio_pin_read(pin) != level);
+  *when = now;
+  return 0;
+}
+
+/**
+ * Detect
+ * - Announce and let it go out; give up if the output does not drain
+ * - Take the RX pin from the UART and read it as a GPIO
+ * - Time BAUD_DETECT_PULSES low pulses: wait for idle (high), then the
+ *   falling and the rising edge
+ * - Average the pulses within 1.5x the shortest one (single bits: chars
+ *   other than 'U' have longer runs of zeros), snap to a standard rate
+ * - Give the pin back, switch, and drop what arrived meanwhile
+ */
+u32 baud_detect(pl011_uart *uart) {
+  u8 rx = uart->gpio->rx;
+  u64 width[BAUD_DETECT_PULSES];
+  u64 deadline, fall, rise, min = ~0UL, total = 0;
+  u32 i, n, count = 0, rate = 0;
+  int stalled = 0;
+
+  if (serial_active()) {
+	stalled = serial_pause();
+  }
+  if (!stalled) {
+	printf(BAUD_DETECT_ANNOUNCE "\n");
+	stalled = baud_drain(uart);
+  }
+  if (stalled) {
+	printf("BAUD FAIL detect (TX stalled)\n");
+	if (serial_active()) {
+	  serial_resume();
+	}
+	return 0;
+  }
+  gpio_pin_set_func(rx, GFInput);
+
+  deadline = timer_get_ticks() + baud_us_to_ticks(BAUD_DETECT_TIMEOUT_US);
+  for (n = 0; n < BAUD_DETECT_PULSES; n++) {
+	if (baud_wait_level(rx, 1, deadline, &rise) ||
+		baud_wait_level(rx, 0, deadline, &fall) ||
+		baud_wait_level(rx, 1, deadline, &rise)) {
+	  break;
+	}
+	width[n] = rise - fall;
+	if (width[n] < min) {
+	  min = width[n];
+	}
+  }
+  gpio_pin_set_func(rx, uart->gpio->func);
+
+  for (i = 0; i < n; i++) {
+	if (2 * width[i] <= 3 * min) {
+	  total += width[i];
+	  count++;
+	}
+  }
+  if (total) {
+	rate = pl011_baud_match(timer_get_freq() * count / total);
+  }
+  if (rate && pl011_set_baud(uart, rate) == 0) {
+	baud_rate = rate;
+  } else {
+	rate = 0;
+  }
+  baud_flush_rx(uart);
+  if (rate) {
+	printf("BAUD OK %u\n", rate);
+  } else {
+	printf("BAUD FAIL detect (%u pulses)\n", n);
+  }
+  if (serial_active()) {
+	serial_resume();
+  }
+  return rate;
+}
+
+SHELL_CMD(baud, "[<rate> | auto]",
+		  "show or change the console baud rate (the host follows)") {
+  pl011_uart *uart = shell_console();
+  u64 rate;
+
+  if (argc == 1) {
+	printf("baud: %u\n", baud_rate);
+	return 0;
+  }
+  if (argc != 2) {
+	return -1;
+  }
+  if (!uart) {
+	printf("baud: the console is not a PL011\n");
+	return 1;
+  }
+  if (shell_streq(argv[1], "auto")) {
+	return baud_detect(uart) ? 0 : 1;
+  }
+  if (shell_parse_u64(argv[1], &rate)) {
+	return -1;
+  }
+  if (rate == 0 || rate > pl011_get_uartclk() / 16) {
+	printf("baud: %lu out of range (max %u)\n", rate, pl011_get_uartclk() / 16);
+	return 1;
+  }
+  return baud_negotiate(uart, rate) ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file bench.c
+ * @author Jose Pires
+ * @date 2024-10-16
+ *
+ * @brief Micro-benchmark harness implementation
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "bench.h"
+#include "cpufreq.h"
+#include "pmu.h"
+#include "printf.h"
+#include "shell.h"
+#include "timer.h"
+
+/**< Bounds of the .bench section (see linker.ld) */
+extern const struct bench __bench_start[];
+extern const struct bench __bench_end[];
+
+static pl011_uart *bench_console;
+
+pl011_uart *bench_uart() {
+  return bench_console;
+}
+
+/**
+ * Run one benchmark
+ * - Warm up caches and branch predictors (untimed)
+ * - Time each repetition with the cycle counter and the system counter
+ * - Print the key=value result line
+ */
+static void bench_one(const struct bench *b) {
+  u64 cyc_min = ~0UL, cyc_max = 0, cyc_total = 0, ticks_total = 0;
+  u64 units = 0, ns_avg, rate;
+  u32 i;
+
+  for (i = 0; i < BENCH_WARMUP; i++) {
+	b->run(b->iters);
+  }
+
+  for (i = 0; i < BENCH_REPS; i++) {
+	u64 t0 = timer_get_ticks();
+	u64 c0 = pmu_read_cycles();
+	units = b->run(b->iters);
+	u64 c1 = pmu_read_cycles();
+	u64 t1 = timer_get_ticks();
+
+	c1 -= c0;
+	cyc_total += c1;
+	ticks_total += t1 - t0;
+	if (c1 < cyc_min) {
+	  cyc_min = c1;
+	}
+	if (c1 > cyc_max) {
+	  cyc_max = c1;
+	}
+  }
+
+  ns_avg = ticks_total * 1000000000UL / (timer_get_freq() * BENCH_REPS);
+  rate = ns_avg ? units * 1000000000UL / ns_avg : 0;
+
+  printf("BENCH name=%s unit=%s units=%lu reps=%u cyc_min=%lu cyc_avg=%lu "
+		 "cyc_max=%lu ns_avg=%lu units_per_s=%lu\n",
+		 b->name, b->unit, units, BENCH_REPS, cyc_min,
+		 cyc_total / BENCH_REPS, cyc_max, ns_avg, rate);
+}
+
+u32 bench_run(pl011_uart *uart, const char *name) {
+  const struct bench *b = __bench_start;
+  const struct bench *end = __bench_end;
+  u32 ran = 0;
+
+  bench_console = uart;
+  printf("BENCH_BEGIN board=%u arm_hz=%u timer_hz=%lu\n", RPI_VERSION,
+		 cpufreq_get_rate(), timer_get_freq());
+
+  for (; b < end; b++) {
+	if (name && !shell_streq(name, b->name)) {
+	  continue;
+	}
+	bench_one(b);
+	ran++;
+  }
+
+  printf("BENCH_END count=%u\n", ran);
+  return ran;
+}
+
+void bench_run_all(pl011_uart *uart) {
+  bench_run(uart, NULL);
+}
+
+SHELL_CMD(bench, "[name]", "run the benchmarks (all, or one)") {
+  if (argc > 2) {
+	return -1;
+  }
+  if (bench_run(shell_console(), argc == 2 ? argv[1] : NULL) == 0 && argc == 2) {
+	printf("bench: no benchmark %s\n", argv[1]);
+  }
+  return 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * @file benchmarks.c
+ * @author Jose Pires
+ * @date 2024-10-16
+ *
+ * @brief Kernel micro-benchmarks (see bench.h)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "bench.h"
+#include "gpio.h"
+#include "mm.h"
+#include "neon.h"
+#include "percpu.h"
+#include "peripherals/pl011.h"
+#include "printf.h"
+#include "smp.h"
+#include "spinlock.h"
+
+#define BENCH_BUF_SIZE (64 * 1024) /**< memzero buffer */
+#define BENCH_GPIO_PIN 21 /**< Free header pin toggled by gpio_toggle */
+
+static u8 __attribute__((aligned(64))) bench_buf[BENCH_BUF_SIZE];
+
+/**
+ * memzero throughput over a 64 KiB buffer
+ */
+BENCH(memzero, "bytes", 16) {
+  u32 i;
+
+  for (i = 0; i < iters; i++) {
+	memzero((unsigned long)bench_buf, BENCH_BUF_SIZE);
+  }
+  return (u64)iters * BENCH_BUF_SIZE;
+}
+
+/**
+ * Copy throughput, 32 KiB between the two halves of the buffer: 64-bit
+ * general register loop vs NEON (the first run takes the lazy FP/SIMD
+ * trap, in the warm-up)
+ */
+BENCH(copy_gpr, "bytes", 16) {
+  volatile u64 *src = (u64 *)bench_buf;
+  volatile u64 *dst = (u64 *)(bench_buf + BENCH_BUF_SIZE / 2);
+  u32 i, j;
+
+  for (i = 0; i < iters; i++) {
+	for (j = 0; j < BENCH_BUF_SIZE / 2 / 8; j++) {
+	  dst[j] = src[j];
+	}
+  }
+  return (u64)iters * BENCH_BUF_SIZE / 2;
+}
+
+BENCH(copy_neon, "bytes", 16) {
+  u32 i;
+
+  for (i = 0; i < iters; i++) {
+	neon_copy(bench_buf + BENCH_BUF_SIZE / 2, bench_buf, BENCH_BUF_SIZE / 2);
+  }
+  return (u64)iters * BENCH_BUF_SIZE / 2;
+}
+
+/**
+ * printf formatting rate (string, signed, hex and 64-bit conversions)
+ */
+BENCH(printf_format, "calls", 1000) {
+  u32 i;
+
+  for (i = 0; i < iters; i++) {
+	sprintf((char *)bench_buf, "%s %d %x %lu\n", "bench", -12345, 0xBEEF,
+			1234567890123UL);
+  }
+  return iters;
+}
+
+/**
+ * UART send rate, including draining the TX FIFO
+ */
+BENCH(uart_send, "chars", 128) {
+  pl011_uart *uart = bench_uart();
+  u32 i;
+
+  if (uart == NULL) {
+	return 0;
+  }
+  for (i = 0; i < iters - 2; i++) {
+	pl011_send(uart, '.');
+  }
+  pl011_send(uart, '\r');
+  pl011_send(uart, '\n');
+  while (uart->regs->fr & (1 << PL011_UARTFR_BUSY)) {
+	;
+  }
+  return iters;
+}
+
+/**
+ * GPIO toggle rate (set + clear through GPSET0/GPCLR0)
+ */
+BENCH(gpio_toggle, "toggles", 10000) {
+  u32 bit = 1 << BENCH_GPIO_PIN;
+  u32 i;
+
+  gpio_pin_set_func(BENCH_GPIO_PIN, GFOutput);
+  for (i = 0; i < iters; i++) {
+	REGS_GPIO->output_set.data[0] = bit;
+	REGS_GPIO->output_clear.data[0] = bit;
+  }
+  return 2 * (u64)iters;
+}
+
+static spinlock_t bench_lock = SPINLOCK_INIT;
+static volatile u64 bench_shared;
+static u32 bench_stop;
+static u32 bench_started;
+
+/**
+ * Uncontended lock/unlock pair
+ */
+BENCH(spinlock, "ops", 10000) {
+  u32 i;
+
+  for (i = 0; i < iters; i++) {
+	spin_lock(&bench_lock);
+	bench_shared++;
+	spin_unlock(&bench_lock);
+  }
+  return iters;
+}
+
+/**
+ * Secondary core side of the contention benchmark: hammer the lock
+ * until told to stop
+ */
+static void bench_lock_hammer(void *arg) {
+  __atomic_fetch_add(&bench_started, 1, __ATOMIC_RELEASE);
+  while (!__atomic_load_n(&bench_stop, __ATOMIC_ACQUIRE)) {
+	spin_lock(&bench_lock);
+	bench_shared++;
+	spin_unlock(&bench_lock);
+  }
+}
+
+/**
+ * Lock/unlock pair on the boot core while every other online core
+ * fights for the same lock
+ */
+BENCH(spinlock_contended, "ops", 10000) {
+  u32 core, others = 0, i;
+
+  bench_stop = 0;
+  bench_started = 0;
+  for (core = 1; core < NR_CPUS; core++) {
+	if (smp_run(core, bench_lock_hammer, NULL) == 0) {
+	  others++;
+	}
+  }
+  while (__atomic_load_n(&bench_started, __ATOMIC_ACQUIRE) < others) {
+	;
+  }
+
+  for (i = 0; i < iters; i++) {
+	spin_lock(&bench_lock);
+	bench_shared++;
+	spin_unlock(&bench_lock);
+  }
+
+  __atomic_store_n(&bench_stop, 1, __ATOMIC_RELEASE);
+  for (core = 1; core < NR_CPUS; core++) {
+	smp_wait(core);
+  }
+  return iters;
+}
+
+static u64 bench_shared_count;
+static DEFINE_PER_CPU(u64, bench_percpu_count);
+
+/**
+ * Secondary core side of the counter benchmarks: count until told to
+ * stop, in the shared counter (arg != NULL) or in our per-CPU one
+ */
+static void bench_count(void *arg) {
+  __atomic_fetch_add(&bench_started, 1, __ATOMIC_RELEASE);
+  while (!__atomic_load_n(&bench_stop, __ATOMIC_ACQUIRE)) {
+	if (arg) {
+	  __atomic_fetch_add(&bench_shared_count, 1, __ATOMIC_RELAXED);
+	} else {
+	  this_cpu_add(bench_percpu_count, 1);
+	}
+  }
+}
+
+/**
+ * Count on the boot core while the other cores count too: every
+ * increment pulls the shared counter's line away from another core
+ */
+static u64 bench_counter_run(u32 iters, int shared) {
+  u32 core, others = 0, i;
+
+  bench_stop = 0;
+  bench_started = 0;
+  for (core = 1; core < NR_CPUS; core++) {
+	if (smp_run(core, bench_count, shared ? &bench_shared_count : NULL) == 0) {
+	  others++;
+	}
+  }
+  while (__atomic_load_n(&bench_started, __ATOMIC_ACQUIRE) < others) {
+	;
+  }
+
+  for (i = 0; i < iters; i++) {
+	if (shared) {
+	  __atomic_fetch_add(&bench_shared_count, 1, __ATOMIC_RELAXED);
+	} else {
+	  this_cpu_add(bench_percpu_count, 1);
+	}
+  }
+
+  __atomic_store_n(&bench_stop, 1, __ATOMIC_RELEASE);
+  for (core = 1; core < NR_CPUS; core++) {
+	smp_wait(core);
+  }
+  return iters;
+}
+
+/**
+ * One counter shared by all cores (atomic increments)
+ */
+BENCH(counter_shared, "incs", 10000) {
+  return bench_counter_run(iters, 1);
+}
+
+/**
+ * One counter per core (this_cpu_add)
+ */
+BENCH(counter_percpu, "incs", 10000) {
+  return bench_counter_run(iters, 0);
+}
+
+static u32 bench_calls_done;
+
+static void bench_call_done(void *arg) {
+  __atomic_fetch_add(&bench_calls_done, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Cross-core call round trip: post to core 1, ring, wait for it to run
+ */
+BENCH(smp_call, "calls", 1000) {
+  u32 i;
+
+  bench_calls_done = 0;
+  for (i = 0; i < iters; i++) {
+	if (smp_call_function(1, bench_call_done, NULL)) {
+	  return i;
+	}
+	while (__atomic_load_n(&bench_calls_done, __ATOMIC_ACQUIRE) <= i) {
+	  ;
+	}
+  }
+  return iters;
+}
+
+/**
+ * Batched cross-core calls: half a queue of posts per doorbell
+ */
+BENCH(smp_call_batch, "calls", 32 * 32) {
+  u32 i, posted = 0;
+
+  bench_calls_done = 0;
+  while (posted < iters) {
+	for (i = 0; i < SMP_QUEUE_SIZE / 2 && posted < iters; i++, posted++) {
+	  if (smp_post(1, bench_call_done, NULL)) {
+		return posted;
+	  }
+	}
+	smp_kick(1);
+	while (__atomic_load_n(&bench_calls_done, __ATOMIC_ACQUIRE) < posted) {
+	  ;
+	}
+  }
+  return iters;
+}
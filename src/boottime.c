@@ -0,0 +1,68 @@
+/**
+ * @file boottime.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Boot phase timing implementation
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "boottime.h"
+#include "printf.h"
+#include "shell.h"
+#include "timer.h"
+
+u64 boot_early_ticks[BOOT_EARLY_NR];
+
+static const char *const boot_early_phases[BOOT_EARLY_NR] = {
+  "firmware", "el2_to_el1", "bss_clear",
+};
+
+static struct boot_mark boot_marks[BOOT_MARKS_MAX];
+static u32 boot_nr_marks;
+
+void boot_mark(const char *phase) {
+  if (boot_nr_marks < BOOT_MARKS_MAX) {
+	boot_marks[boot_nr_marks].phase = phase;
+	boot_marks[boot_nr_marks].ticks = timer_get_ticks();
+	boot_nr_marks++;
+  }
+}
+
+__cold void boot_time_init() {
+  u32 i;
+
+  boot_mark("kernel_entry");
+  boot_marks[BOOT_EARLY_NR] = boot_marks[0];
+  for (i = 0; i < BOOT_EARLY_NR; i++) {
+	boot_marks[i].phase = boot_early_phases[i];
+	boot_marks[i].ticks = boot_early_ticks[i];
+  }
+  boot_nr_marks = BOOT_EARLY_NR + 1;
+}
+
+/**
+ * Report
+ * - The kernel_main entry line first (unchanged format, qemu_test.py)
+ * - Each phase runs from the previous mark (reset for the first)
+ */
+__cold void boot_report() {
+  u64 entry = boot_marks[BOOT_EARLY_NR].ticks;
+  u64 prev = 0;
+  u32 i;
+
+  printf("BOOT kernel_main_ticks=%lu kernel_main_us=%lu timer_hz=%lu\n", entry,
+		 timer_ticks_to_us(entry), timer_get_freq());
+  for (i = 0; i < boot_nr_marks; i++) {
+	printf("BOOT phase=%s us=%lu end_us=%lu\n", boot_marks[i].phase,
+		   timer_ticks_to_us(boot_marks[i].ticks - prev),
+		   timer_ticks_to_us(boot_marks[i].ticks));
+	prev = boot_marks[i].ticks;
+  }
+}
+
+SHELL_CMD(boot, "", "boot phase timing since reset") {
+  boot_report();
+  return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file console_link.c
+ * @author Jose Pires
+ * @date 2024-10-20
+ *
+ * @brief Framed console implementation
+ *
+ * One lock serializes every frame sent and received, from any core; it
+ * is held (IRQs masked) for one frame at a time.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "console_link.h"
+#include "mmu.h"
+#include "printf.h"
+#include "shell.h"
+#include "spinlock.h"
+
+#define CONSOLE_LINK_SEND_MAX 0xFFFFFFFFU /**< `link send` length (u32) */
+#define CONSOLE_LINK_ADDR_END ((u64)MMU_L1_USED << MM_L1_SHIFT) /**< Mapped */
+
+static const struct console_link_ops *console_ops;
+static struct link console_link;
+static spinlock_t console_link_lock = SPINLOCK_INIT;
+static u32 console_link_on;
+
+/**
+ * @brief printf output gathered into one frame per call
+ */
+struct console_link_buf {
+  u8 buf[LINK_MTU];
+  u32 len;
+};
+
+/**
+ * @brief Send on a channel, one frame per lock hold: a bulk dump does
+ * not keep the IRQs masked for longer than one frame takes to send
+ */
+static void console_link_send(u32 chan, const void *buf, u32 len) {
+  const u8 *p = buf;
+  u32 n;
+  u64 flags;
+
+  do {
+	n = len < LINK_MTU ? len : LINK_MTU;
+	flags = spin_lock_irqsave(&console_link_lock);
+	link_send(&console_link, chan, p, n);
+	spin_unlock_irqrestore(&console_link_lock, flags);
+	p += n;
+	len -= n;
+  } while (len);
+}
+
+static void console_link_putc(void *p, char c) {
+  console_link_send(LINK_CH_CONSOLE, &c, 1);
+}
+
+static void console_link_bufc(void *p, char c) {
+  struct console_link_buf *b = p;
+
+  b->buf[b->len++] = c;
+  if (b->len == LINK_MTU) {
+	console_link_send(LINK_CH_CONSOLE, b->buf, b->len);
+	b->len = 0;
+  }
+}
+
+/**
+ * @brief printf output: a whole call per frame (split at LINK_MTU)
+ */
+static void console_link_vprintf(char *fmt, va_list va) {
+  struct console_link_buf b;
+
+  b.len = 0;
+  tfp_format(&b, console_link_bufc, fmt, va);
+  if (b.len) {
+	console_link_send(LINK_CH_CONSOLE, b.buf, b.len);
+  }
+}
+
+void console_link_trace(const struct trace_rec *rec, void *arg) {
+  console_link_send(LINK_CH_TRACE, rec, sizeof(*rec));
+}
+
+void console_link_init(const struct console_link_ops *ops) {
+  console_ops = ops;
+  console_link_on = 0;
+}
+
+int console_link_active() {
+  return console_link_on;
+}
+
+/**
+ * Receive: frames on the console channel feed the driver's key handler;
+ * the rest is handled (NAKs) or ignored
+ */
+void console_link_input(u8 c) {
+  struct link_frame f;
+  u64 flags;
+  u32 i;
+  int got;
+
+  flags = spin_lock_irqsave(&console_link_lock);
+  got = link_input(&console_link, c, &f);
+  spin_unlock_irqrestore(&console_link_lock, flags);
+
+  if (got && f.chan == LINK_CH_CONSOLE) {
+	for (i = 0; i < f.len; i++) {
+	  console_ops->key(f.data[i]);
+	}
+  }
+}
+
+/**
+ * Switch
+ * - On: new link (seq 0), then printf goes through it
+ * - Off: printf back to the UART first, so nothing is framed after
+ */
+static void console_link_set(u32 on) {
+  if (on && !console_link_on) {
+	link_init(&console_link, console_ops->write, NULL);
+	console_link_on = 1;
+	init_printf(NULL, console_link_putc);
+	init_vprintf(console_link_vprintf);
+  } else if (!on && console_link_on) {
+	console_ops->printf_init();
+	console_link_on = 0;
+  }
+}
+
+SHELL_CMD(link, "on | off | stats | send <addr> <len>",
+		  "framed console (scripts/link_demux.py on the host)") {
+  u64 addr, len;
+
+  if (!console_ops) {
+	printf("link: no console driver\n");
+	return 1;
+  }
+  if (argc == 2 && shell_streq(argv[1], "on")) {
+	console_link_set(1);
+	printf("link: on\n");
+	return 0;
+  }
+  if (argc == 2 && shell_streq(argv[1], "off")) {
+	console_link_set(0);
+	printf("link: off\n");
+	return 0;
+  }
+  if (argc == 2 && shell_streq(argv[1], "stats")) {
+	printf("link: %s, tx %u frames, rx %u frames, %u bad, %u retransmitted, "
+		   "%u lost\n", console_link_on ? "on" : "off",
+		   console_link.tx_frames, console_link.rx_frames, console_link.rx_bad,
+		   console_link.retransmits, console_link.lost);
+	return 0;
+  }
+  if (argc == 4 && shell_streq(argv[1], "send") && console_link_on &&
+	  !shell_parse_u64(argv[2], &addr) && !shell_parse_u64(argv[3], &len)) {
+	if (len == 0 || len > CONSOLE_LINK_SEND_MAX ||
+		addr > CONSOLE_LINK_ADDR_END - len) {
+	  printf("link: send: 1-%u bytes below 0x%lx\n", CONSOLE_LINK_SEND_MAX,
+			 CONSOLE_LINK_ADDR_END);
+	  return 1;
+	}
+	console_link_send(LINK_CH_BULK, (const void *)addr, len);
+	return 0;
+  }
+  return -1;
+}
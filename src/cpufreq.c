@@ -0,0 +1,152 @@
+/**
+ * @file cpufreq.c
+ * @author Jose Pires
+ * @date 2024-10-09
+ *
+ * @brief ARM frequency scaling with a thermal-aware governor
+ *
+ * Policy, evaluated every CPUFREQ_PERIOD_US:
+ * - Thermal: at (limit - HOT_MARGIN) lower the cap by one step; below
+ *   (limit - COOL_MARGIN) raise it again by one step (hysteresis)
+ * - Load: busy -> run at the cap; idle for CPUFREQ_IDLE_PERIODS -> min
+ * - The firmware is only asked to change the clock when the target
+ *   differs from the current rate (a mailbox call is not cheap)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "cpufreq.h"
+#include "mailbox.h"
+#include "printf.h"
+#include "shell.h"
+#include "timer.h"
+#include "trace.h"
+
+/**
+ * @brief Governor state
+ */
+static struct {
+  u32 min;         /**< Lowest ARM rate (Hz) */
+  u32 max;         /**< Highest ARM rate (Hz) */
+  u32 cap;         /**< Current thermal ceiling (Hz) */
+  u32 rate;        /**< Rate currently set (Hz) */
+  u32 temp;        /**< Last sampled temperature (m°C) */
+  u32 temp_limit;  /**< Firmware throttling temperature (m°C) */
+  u32 idle;        /**< Consecutive idle periods */
+  u64 last;        /**< Timestamp of the last evaluation (ticks) */
+  u64 period;      /**< Evaluation period (ticks) */
+  volatile int busy; /**< Work seen since the last evaluation */
+} gov;
+
+void cpufreq_init() {
+  gov.max = mbox_get_max_clock_rate(MBOX_CLK_ARM);
+  gov.min = mbox_get_min_clock_rate(MBOX_CLK_ARM);
+  gov.temp_limit = mbox_get_max_temperature();
+  gov.temp = mbox_get_temperature();
+  gov.period = CPUFREQ_PERIOD_US * timer_get_freq() / USEC_PER_SEC;
+  gov.last = timer_get_ticks();
+  gov.idle = 0;
+  gov.busy = 1;
+
+  if (gov.max == 0) { /**< No firmware answer: leave the clock alone */
+	gov.rate = mbox_get_clock_rate(MBOX_CLK_ARM);
+	gov.min = gov.max = gov.cap = gov.rate;
+	return;
+  }
+  if (gov.min == 0 || gov.min > gov.max) {
+	gov.min = gov.max;
+  }
+
+  gov.cap = gov.max;
+  gov.rate = mbox_set_clock_rate(MBOX_CLK_ARM, gov.max);
+}
+
+void cpufreq_mark_busy() {
+  gov.busy = 1;
+}
+
+/**
+ * Adjust the thermal cap by one step, within [min, max]
+ * - Without a throttling limit from the firmware, the cap stays at max
+ */
+static void cpufreq_thermal() {
+  gov.temp = mbox_get_temperature();
+  if (gov.temp_limit == 0 || gov.temp == 0) {
+	return;
+  }
+
+  if (gov.temp + CPUFREQ_HOT_MARGIN >= gov.temp_limit) {
+	gov.cap = (gov.cap > gov.min + CPUFREQ_STEP_HZ) ?
+	  gov.cap - CPUFREQ_STEP_HZ : gov.min;
+  } else if (gov.temp + CPUFREQ_COOL_MARGIN <= gov.temp_limit) {
+	gov.cap = (gov.cap + CPUFREQ_STEP_HZ < gov.max) ?
+	  gov.cap + CPUFREQ_STEP_HZ : gov.max;
+  }
+}
+
+/**
+ * Evaluate the policy
+ * - Pick the target from the load, then clamp it to the thermal cap
+ */
+int cpufreq_evaluate() {
+  u32 target;
+
+  gov.last = timer_get_ticks();
+  cpufreq_thermal();
+
+  if (gov.busy) {
+	gov.idle = 0;
+	target = gov.cap;
+  } else if (++gov.idle >= CPUFREQ_IDLE_PERIODS) {
+	gov.idle = CPUFREQ_IDLE_PERIODS;
+	target = gov.min;
+  } else {
+	target = gov.rate;
+  }
+  gov.busy = 0;
+
+  if (target > gov.cap) {
+	target = gov.cap;
+  }
+  if (target == gov.rate) {
+	return 0;
+  }
+
+  TRACE(FREQ, gov.rate, target);
+  gov.rate = mbox_set_clock_rate(MBOX_CLK_ARM, target);
+  return 1;
+}
+
+/**
+ * Rate-limited by the system counter
+ */
+int cpufreq_update() {
+  if (timer_get_ticks() - gov.last < gov.period) {
+	return 0;
+  }
+  return cpufreq_evaluate();
+}
+
+int cpufreq_settled() {
+  return !gov.busy && gov.idle >= CPUFREQ_IDLE_PERIODS && gov.rate == gov.min;
+}
+
+u32 cpufreq_get_rate() {
+  return gov.rate;
+}
+
+u32 cpufreq_get_temp() {
+  return gov.temp;
+}
+
+void cpufreq_report() {
+  printf("cpufreq: %u MHz (cap %u, min %u, max %u) temp %u.%u C (limit %u C)\n",
+		 gov.rate / 1000000, gov.cap / 1000000, gov.min / 1000000,
+		 gov.max / 1000000, gov.temp / 1000, (gov.temp % 1000) / 100,
+		 gov.temp_limit / 1000);
+}
+
+SHELL_CMD(freq, "", "show the ARM clock and the governor state") {
+  cpufreq_report();
+  return 0;
+}
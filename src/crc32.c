@@ -0,0 +1,85 @@
+/**
+ * @file crc32.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief CRC-32 implementation
+ *
+ * Reflected polynomial 0xEDB88320, initial value and final XOR
+ * 0xFFFFFFFF. Built for ARMv8 with the CRC extension (the kernel, see
+ * the Makefile) it uses the CRC32B/CRC32X instructions, which compute
+ * this same CRC, 8 bytes per instruction; elsewhere (host tests,
+ * bootloader) it is processed a nibble at a time.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "crc32.h"
+
+#if defined(__ARM_FEATURE_CRC32)
+
+static inline u32 crc32_byte(u32 crc, u8 b) {
+  asm("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"((u32)b));
+  return crc;
+}
+
+static inline u32 crc32_dword(u32 crc, u64 d) {
+  asm("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(d));
+  return crc;
+}
+
+/**
+ * Update the CRC
+ * - Bytes up to an 8-byte boundary, so no 64-bit load straddles a cache
+ *   line
+ * - Then 8 bytes per CRC32X, and the tail by bytes
+ */
+u32 crc32_update(u32 crc, const void *buf, u32 len) {
+  const u8 *p = buf;
+
+  crc = ~crc;
+  while (len && ((u64)p & 7)) {
+	crc = crc32_byte(crc, *p++);
+	len--;
+  }
+  for (; len >= 8; len -= 8, p += 8) {
+	crc = crc32_dword(crc, *(const u64 *)p);
+  }
+  while (len--) {
+	crc = crc32_byte(crc, *p++);
+  }
+  return ~crc;
+}
+
+#else
+
+/**< CRC of each nibble value: crc32_nibble[i] = crc(i) over 4 bits */
+static const u32 crc32_nibble[16] = {
+  0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+  0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+  0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+  0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+/**
+ * Update the CRC
+ * - Undo the final XOR of the previous call (so calls can be chained)
+ * - Per byte: fold it in, then shift out the low and the high nibble
+ */
+u32 crc32_update(u32 crc, const void *buf, u32 len) {
+  const u8 *p = buf;
+
+  crc = ~crc;
+  while (len--) {
+	crc ^= *p++;
+	crc = (crc >> 4) ^ crc32_nibble[crc & 0xF];
+	crc = (crc >> 4) ^ crc32_nibble[crc & 0xF];
+  }
+  return ~crc;
+}
+
+#endif
+
+u32 crc32(const void *buf, u32 len) {
+  return crc32_update(0, buf, len);
+}
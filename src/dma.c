@@ -0,0 +1,130 @@
+/**
+ * @file dma.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief DMA buffer pool implementation
+ *
+ * The pool is tracked with one bit per DMA_BLOCK and allocated first
+ * fit: DMA buffers are few, long-lived and small (mailbox messages,
+ * UART/EMMC transfer blocks), so a scan of DMA_POOL_SIZE / DMA_BLOCK
+ * bits is cheap and nothing fragments much. The pool memory itself is
+ * not zeroed at boot (NOLOAD), only the bitmap.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "dma.h"
+#include "cache.h"
+#include "printf.h"
+#include "sections.h"
+#include "shell.h"
+#include "spinlock.h"
+
+#define DMA_NR_BLOCKS (DMA_POOL_SIZE / DMA_BLOCK)
+
+static u8 dma_pool[DMA_POOL_SIZE]
+  __attribute__((aligned(PAGE_SIZE), section(".dma")));
+static u64 dma_used[DMA_NR_BLOCKS / 64]; /**< 1 bit per block */
+static spinlock_t dma_lock = SPINLOCK_INIT;
+
+static inline int dma_block_used(u32 i) {
+  return (dma_used[i / 64] >> (i % 64)) & 1;
+}
+
+static void dma_mark(u32 first, u32 n, int used) {
+  u32 i;
+
+  for (i = first; i < first + n; i++) {
+	if (used) {
+	  dma_used[i / 64] |= 1UL << (i % 64);
+	} else {
+	  dma_used[i / 64] &= ~(1UL << (i % 64));
+	}
+  }
+}
+
+/**
+ * Allocate
+ * - Round up to whole blocks
+ * - First fit: extend a run of free blocks, restart after a used one
+ */
+int dma_alloc(struct dma_buf *buf, u32 size) {
+  u32 n = (size + DMA_BLOCK - 1) / DMA_BLOCK;
+  u32 i, run = 0;
+  u64 flags;
+
+  if (n == 0 || n > DMA_NR_BLOCKS) {
+	return -1;
+  }
+  flags = spin_lock_irqsave(&dma_lock);
+  for (i = 0; i < DMA_NR_BLOCKS; i++) {
+	run = dma_block_used(i) ? 0 : run + 1;
+	if (run == n) {
+	  break;
+	}
+  }
+  if (run < n) {
+	spin_unlock_irqrestore(&dma_lock, flags);
+	return -1;
+  }
+  dma_mark(i + 1 - n, n, 1);
+  spin_unlock_irqrestore(&dma_lock, flags);
+
+  buf->cpu = &dma_pool[(i + 1 - n) * DMA_BLOCK];
+  buf->bus = dma_bus_addr(buf->cpu);
+  buf->size = n * DMA_BLOCK;
+  return 0;
+}
+
+void dma_free(struct dma_buf *buf) {
+  u32 first;
+  u64 flags;
+
+  if (!buf->cpu) {
+	return;
+  }
+  first = ((u8 *)buf->cpu - dma_pool) / DMA_BLOCK;
+  flags = spin_lock_irqsave(&dma_lock);
+  dma_mark(first, buf->size / DMA_BLOCK, 0);
+  spin_unlock_irqrestore(&dma_lock, flags);
+  buf->cpu = NULL;
+  buf->bus = 0;
+  buf->size = 0;
+}
+
+void dma_sync_for_device(const struct dma_buf *buf, u32 off, u32 len) {
+  dcache_clean_range((u8 *)buf->cpu + off, len);
+}
+
+void dma_sync_for_cpu(const struct dma_buf *buf, u32 off, u32 len) {
+  dcache_invalidate_range((u8 *)buf->cpu + off, len);
+}
+
+u32 dma_pool_free() {
+  u32 i, n = 0;
+
+  for (i = 0; i < DMA_NR_BLOCKS; i++) {
+	n += !dma_block_used(i);
+  }
+  return n * DMA_BLOCK;
+}
+
+u32 dma_pool_largest() {
+  u32 i, run = 0, max = 0;
+
+  for (i = 0; i < DMA_NR_BLOCKS; i++) {
+	run = dma_block_used(i) ? 0 : run + 1;
+	if (run > max) {
+	  max = run;
+	}
+  }
+  return max * DMA_BLOCK;
+}
+
+SHELL_CMD(dma, "", "DMA pool usage") {
+  printf("dma: pool 0x%lx-0x%lx, free %u B, largest free %u B, line %u B\n",
+		 (u64)dma_pool, (u64)dma_pool + DMA_POOL_SIZE, dma_pool_free(),
+		 dma_pool_largest(), dcache_line_size());
+  return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file event.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Run-to-completion event loop implementation
+ *
+ * Each core has a lock-free LIFO of queued work: producers (any core,
+ * any IRQ handler) push with a compare-and-swap of the head, the owning
+ * core takes the whole list with one exchange and runs it oldest first.
+ * No producer ever waits on the consumer or on another producer.
+ *
+ * The CAS and the exchanges are LDXR/STXR loops: the lists live in
+ * Normal memory, mapped by mmu.c before the first core runs C code, so
+ * the first work_queue() from an interrupt handler already finds the
+ * exclusive monitor working.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "event.h"
+#include "idle.h"
+#include "irq.h"
+#include "printf.h"
+#include "shell.h"
+#include "smp.h"
+
+#define GPIO_PINS 54
+
+/**
+ * @brief Work queued on a core, and its stats (written by the owner)
+ */
+struct work_list {
+  struct work *head; /**< Newest first */
+  u64 runs;          /**< Work items run */
+  u64 batches;       /**< Non-empty passes of the loop */
+  u64 sleeps;        /**< WFIs */
+} ____cacheline_aligned;
+
+static struct work_list work_lists[NR_CPUS];
+static struct work *gpio_work[GPIO_PINS];
+static u32 gpio_irq_on;
+
+/**
+ * Push
+ * - The pending flag makes a second queueing a no-op, so the item is on
+ *   at most one list and its link is free to use
+ * - Publish with a release CAS of the head
+ */
+static int work_push(struct work_list *wl, struct work *w) {
+  struct work *head;
+
+  if (__atomic_exchange_n(&w->pending, 1, __ATOMIC_ACQUIRE)) {
+	return 1;
+  }
+  head = __atomic_load_n(&wl->head, __ATOMIC_RELAXED);
+  do {
+	w->next = head;
+  } while (!__atomic_compare_exchange_n(&wl->head, &head, w, 1,
+										__ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  return 0;
+}
+
+int work_queue(struct work *w) {
+  return work_push(&work_lists[smp_processor_id()], w);
+}
+
+/**
+ * Cross-core: push, then ring the target's doorbell; the IPI brings it
+ * out of WFI (its handler finds no call to run)
+ */
+int work_queue_on(u32 core, struct work *w) {
+  int ret;
+
+  if (core == smp_processor_id()) {
+	return work_queue(w);
+  }
+  ret = work_push(&work_lists[core], w);
+  if (!ret) {
+	smp_kick(core);
+  }
+  return ret;
+}
+
+/**
+ * Run one batch
+ * - Take the whole list, reverse it to queueing order
+ * - Clear pending before each call: the item may queue itself again
+ */
+static __hot void event_run(struct work_list *wl) {
+  struct work *w, *next, *batch = NULL;
+
+  w = __atomic_exchange_n(&wl->head, NULL, __ATOMIC_ACQUIRE);
+  if (!w) {
+	return;
+  }
+  for (; w; w = next) {
+	next = w->next;
+	w->next = batch;
+	batch = w;
+  }
+  for (w = batch; w; w = next) {
+	next = w->next;
+	__atomic_store_n(&w->pending, 0, __ATOMIC_RELEASE);
+	w->fn(w->arg);
+	wl->runs++;
+  }
+  wl->batches++;
+}
+
+/**
+ * Loop
+ * - Mask IRQs, check for work and sleep only if there is none: an IRQ
+ *   taken after the check is still pending and ends the WFI (idle.h)
+ * - Unmask: the handlers run here and queue their work
+ * - Run the batch
+ */
+void event_loop() {
+  struct work_list *wl = &work_lists[smp_processor_id()];
+
+  while (1) {
+	irq_local_disable();
+	if (!__atomic_load_n(&wl->head, __ATOMIC_ACQUIRE)) {
+	  wl->sleeps++;
+	  idle_enter();
+	}
+	irq_local_enable();
+	event_run(wl);
+  }
+}
+
+/**
+ * GPIO interrupt: take the latched events and queue each pin's work
+ */
+static void gpio_irq(void *arg, struct pt_regs *regs) {
+  u32 bank, events, pin;
+
+  for (bank = 0; bank < 2; bank++) {
+	events = gpio_events_take(bank);
+	while (events) {
+	  pin = 32 * bank + __builtin_ctz(events);
+	  events &= events - 1;
+	  if (pin < GPIO_PINS && gpio_work[pin]) {
+		work_queue(gpio_work[pin]);
+	  }
+	}
+  }
+}
+
+/**
+ * GPIO source
+ * - Set the work before enabling detection, clear it after disabling
+ * - The interrupt is routed to the first core registering a pin
+ */
+int event_gpio(u8 pin, u32 edges, struct work *w) {
+  if (pin >= GPIO_PINS) {
+	return -1;
+  }
+  if (edges) {
+	gpio_work[pin] = w;
+	gpio_pin_set_edge(pin, edges);
+  } else {
+	gpio_pin_set_edge(pin, 0);
+	gpio_work[pin] = NULL;
+  }
+
+  if (edges && !gpio_irq_on) {
+	gpio_irq_on = 1;
+	irq_register(IRQ_GPIO, gpio_irq, NULL);
+	irq_enable(IRQ_GPIO);
+  }
+  return 0;
+}
+
+SHELL_CMD(events, "", "event loop stats per core") {
+  u32 core;
+  struct work_list *wl;
+
+  for (core = 0; core < NR_CPUS; core++) {
+	wl = &work_lists[core];
+	printf("core %u: %lu work in %lu batches, %lu sleeps\n", core, wl->runs,
+		   wl->batches, wl->sleeps);
+  }
+  return 0;
+}
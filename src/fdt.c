@@ -0,0 +1,195 @@
+/**
+ * @file fdt.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Flattened device tree lookup implementation
+ *
+ * Layout (devicetree specification, chapter 5): a header, then the
+ * structure block, a sequence of 32-bit tokens (BEGIN_NODE name,
+ * PROP len nameoff value, END_NODE, NOP, END) each padded to 4 bytes,
+ * and the strings block holding the property names.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "fdt.h"
+
+#define FDT_BEGIN_NODE 1
+#define FDT_END_NODE 2
+#define FDT_PROP 3
+#define FDT_NOP 4
+#define FDT_END 9
+
+#define FDT_HDR_MAGIC 0
+#define FDT_HDR_TOTALSIZE 4
+#define FDT_HDR_OFF_STRUCT 8
+#define FDT_HDR_OFF_STRINGS 12
+#define FDT_HDR_VERSION 20
+#define FDT_HDR_SIZE_STRINGS 32
+#define FDT_HDR_SIZE_STRUCT 36
+#define FDT_HDR_LEN 40
+
+static u32 fdt32(const u8 *p) {
+  return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+}
+
+static u32 fdt_hdr(const void *fdt, u32 off) {
+  return fdt32((const u8 *)fdt + off);
+}
+
+static u32 fdt_align(u32 off) {
+  return (off + 3) & ~3U;
+}
+
+int fdt_check(const void *fdt) {
+  u32 size;
+
+  if (!fdt || fdt_hdr(fdt, FDT_HDR_MAGIC) != FDT_MAGIC ||
+	  fdt_hdr(fdt, FDT_HDR_VERSION) < 17) {
+	return -1;
+  }
+  size = fdt_hdr(fdt, FDT_HDR_TOTALSIZE);
+  if (size < FDT_HDR_LEN ||
+	  fdt_hdr(fdt, FDT_HDR_OFF_STRUCT) > size ||
+	  fdt_hdr(fdt, FDT_HDR_SIZE_STRUCT) >
+	  size - fdt_hdr(fdt, FDT_HDR_OFF_STRUCT) ||
+	  fdt_hdr(fdt, FDT_HDR_OFF_STRINGS) > size ||
+	  fdt_hdr(fdt, FDT_HDR_SIZE_STRINGS) >
+	  size - fdt_hdr(fdt, FDT_HDR_OFF_STRINGS)) {
+	return -1;
+  }
+  return 0;
+}
+
+u32 fdt_size(const void *fdt) {
+  return fdt_hdr(fdt, FDT_HDR_TOTALSIZE);
+}
+
+/**
+ * Compare a node name with a path component (len bytes): equal, or the
+ * component has no unit address and the name does (before its '@')
+ */
+static int fdt_name_match(const char *node, const char *comp, u32 len) {
+  u32 i;
+
+  for (i = 0; i < len; i++) {
+	if (node[i] != comp[i]) {
+	  return 0;
+	}
+  }
+  return node[len] == '\0' || node[len] == '@';
+}
+
+static int fdt_streq(const char *a, const char *b) {
+  while (*a && *a == *b) {
+	a++;
+	b++;
+  }
+  return *a == *b;
+}
+
+/**
+ * Walk
+ * - Split the path into components ("/" has none: the root itself)
+ * - Track the depth and how many levels of the path the current node
+ *   matches; only the properties of a node matching the whole path are
+ *   looked at
+ * - Stop at END or at anything that runs past the structure block
+ */
+const void *fdt_getprop(const void *fdt, const char *path, const char *name,
+						u32 *len) {
+  const u8 *base = fdt;
+  const char *strings = (const char *)base + fdt_hdr(fdt, FDT_HDR_OFF_STRINGS);
+  u32 strings_size = fdt_hdr(fdt, FDT_HDR_SIZE_STRINGS);
+  u32 off = fdt_hdr(fdt, FDT_HDR_OFF_STRUCT);
+  u32 end = off + fdt_hdr(fdt, FDT_HDR_SIZE_STRUCT);
+  const char *comp[FDT_MAX_DEPTH];
+  u32 comp_len[FDT_MAX_DEPTH];
+  u32 ncomp = 0, depth = 0, matched = 0, tok, plen, nameoff;
+  const char *node;
+
+  while (*path) {
+	while (*path == '/') {
+	  path++;
+	}
+	if (!*path) {
+	  break;
+	}
+	if (ncomp == FDT_MAX_DEPTH) {
+	  return NULL;
+	}
+	comp[ncomp] = path;
+	while (*path && *path != '/') {
+	  path++;
+	}
+	comp_len[ncomp] = path - comp[ncomp];
+	ncomp++;
+  }
+
+  while (off + 4 <= end) {
+	tok = fdt32(base + off);
+	off += 4;
+	switch (tok) {
+	case FDT_BEGIN_NODE:
+	  node = (const char *)base + off;
+	  while (off < end && base[off]) {
+		off++;
+	  }
+	  off = fdt_align(off + 1);
+	  /* depth: nodes open; the root opens at 0, component i at i + 1 */
+	  if (depth > 0 && matched == depth - 1 && matched < ncomp &&
+		  fdt_name_match(node, comp[matched], comp_len[matched])) {
+		matched++;
+	  }
+	  depth++;
+	  break;
+	case FDT_END_NODE:
+	  if (depth <= 1) {
+		return NULL; /**< Root closed: the path is not in the tree */
+	  }
+	  if (matched == depth - 1) {
+		matched--; /**< Leaving a node of the path */
+	  }
+	  depth--;
+	  break;
+	case FDT_PROP:
+	  if (off + 8 > end) {
+		return NULL;
+	  }
+	  plen = fdt32(base + off);
+	  nameoff = fdt32(base + off + 4);
+	  off += 8;
+	  if (plen > end - off) {
+		return NULL;
+	  }
+	  if (depth == ncomp + 1 && matched == ncomp && nameoff < strings_size &&
+		  fdt_streq(strings + nameoff, name)) {
+		if (len) {
+		  *len = plen;
+		}
+		return base + off;
+	  }
+	  off = fdt_align(off + plen);
+	  break;
+	case FDT_NOP:
+	  break;
+	default:
+	  return NULL;
+	}
+  }
+  return NULL;
+}
+
+int fdt_getprop_u64(const void *fdt, const char *path, const char *name,
+					u64 *val) {
+  const u8 *p;
+  u32 len;
+
+  p = fdt_getprop(fdt, path, name, &len);
+  if (!p || (len != 4 && len != 8)) {
+	return -1;
+  }
+  *val = len == 4 ? fdt32(p) : (u64)fdt32(p) << 32 | fdt32(p + 4);
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file fpsimd.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Lazy FP/SIMD context handling implementation
+ *
+ * All the state is per core and only touched by its core, with IRQs
+ * masked (IRQ entry/exit, the trap), so it needs no lock.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "fpsimd.h"
+#include "printf.h"
+#include "shell.h"
+#include "smp.h"
+#include "sysregs.h"
+
+/**
+ * @brief FP/SIMD state of a core
+ */
+struct fpsimd_cpu {
+  struct fpsimd_state thread; /**< Thread registers, saved by an IRQ user */
+  u32 thread_live; /**< The thread context has used FP/SIMD */
+  u32 in_irq;      /**< Between fpsimd_irq_enter() and _exit() */
+  u32 irq_used;    /**< The current IRQ has used FP/SIMD */
+  u32 thread_traps;
+  u32 irq_traps;
+  u32 saves;       /**< Thread registers saved (and restored) */
+} ____cacheline_aligned;
+
+static struct fpsimd_cpu fpsimd_cpus[NR_CPUS];
+
+static inline void fpsimd_set(u64 cpacr) {
+  asm volatile("msr cpacr_el1, %0\n\tisb" :: "r"(cpacr) : "memory");
+}
+
+void fpsimd_init_cpu() {
+  fpsimd_set(CPACR_EL1_FPEN_TRAP);
+}
+
+/**
+ * First use in a context
+ * - Thread: enable for good
+ * - IRQ: enable for the handler, after saving the thread's live
+ *   registers (fpsimd_save() needs FP/SIMD on, and nothing has touched
+ *   them since the IRQ was taken)
+ */
+void fpsimd_trap() {
+  struct fpsimd_cpu *fp = &fpsimd_cpus[smp_processor_id()];
+
+  fpsimd_set(CPACR_EL1_FPEN_ON);
+  if (!fp->in_irq) {
+	fp->thread_live = 1;
+	fp->thread_traps++;
+	return;
+  }
+  if (fp->thread_live) {
+	fpsimd_save(&fp->thread);
+	fp->saves++;
+  }
+  fp->irq_used = 1;
+  fp->irq_traps++;
+}
+
+/**
+ * IRQ entry: make the handlers trap, unless FP/SIMD is off already
+ */
+void fpsimd_irq_enter() {
+  struct fpsimd_cpu *fp = &fpsimd_cpus[smp_processor_id()];
+
+  fp->in_irq = 1;
+  if (fp->thread_live) {
+	fpsimd_set(CPACR_EL1_FPEN_TRAP);
+  }
+}
+
+/**
+ * IRQ exit
+ * - The handlers used FP/SIMD: put the thread's registers back (or just
+ *   turn it off again if the thread has none live)
+ * - They did not: only turn it back on for the thread
+ */
+void fpsimd_irq_exit() {
+  struct fpsimd_cpu *fp = &fpsimd_cpus[smp_processor_id()];
+
+  if (fp->irq_used) {
+	fp->irq_used = 0;
+	if (fp->thread_live) {
+	  fpsimd_load(&fp->thread);
+	} else {
+	  fpsimd_set(CPACR_EL1_FPEN_TRAP);
+	}
+  } else if (fp->thread_live) {
+	fpsimd_set(CPACR_EL1_FPEN_ON);
+  }
+  fp->in_irq = 0;
+}
+
+SHELL_CMD(fpsimd, "", "lazy FP/SIMD traps and saves per core") {
+  struct fpsimd_cpu *fp;
+  u32 core;
+
+  for (core = 0; core < NR_CPUS; core++) {
+	fp = &fpsimd_cpus[core];
+	printf("core %u: thread %s, traps %u thread / %u irq, %u saves\n", core,
+		   fp->thread_live ? "live" : "off", fp->thread_traps, fp->irq_traps,
+		   fp->saves);
+  }
+  return 0;
+}
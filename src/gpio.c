@@ -8,11 +8,13 @@
  * Provides utility functions to handle the GPIO:
  * - Set the alternate function
  * - Enable a GPIO
+ * - Detect edges
  *
  * @copyright Jose Pires 2024
  */
 
 #include "gpio.h"
+#include "prof.h"
 #include "utils.h"
 
 #define GPIO_BITS 3
@@ -53,6 +55,8 @@ void gpio_pin_set_func(u8 pinNumber, GpioFunc func) {
  * 6. Write to GPPUDCLK0/1 to remove the clock
  */
 void gpio_pin_enable(u8 pinNumber){
+  PROF_SCOPE("gpio_pin_enable");
+
   REGS_GPIO->pupd_enable = GPUD_Off;
   delay(150);
   REGS_GPIO->pupd_enable_clocks[pinNumber / 32] = 1 << (pinNumber % 32);
@@ -60,3 +64,38 @@ void gpio_pin_enable(u8 pinNumber){
   REGS_GPIO->pupd_enable = GPUD_Off;
   REGS_GPIO->pupd_enable_clocks[pinNumber / 32] = 0;
 }
+
+u32 gpio_pin_read(u8 pinNumber) {
+  return (REGS_GPIO->level.data[pinNumber / 32] >> (pinNumber % 32)) & 1;
+}
+
+/**
+ * Edge detection
+ * - One bit per pin in each of GPREN/GPFEN: update only this pin's
+ * - Clear a stale event, so only edges from now on are reported
+ */
+void gpio_pin_set_edge(u8 pinNumber, u32 edges) {
+  u32 bank = pinNumber / 32;
+  u32 bit = 1 << (pinNumber % 32);
+
+  if (edges & GPIO_EDGE_RISING) {
+	REGS_GPIO->re_detect_enable.data[bank] |= bit;
+  } else {
+	REGS_GPIO->re_detect_enable.data[bank] &= ~bit;
+  }
+  if (edges & GPIO_EDGE_FALLING) {
+	REGS_GPIO->fe_detect_enable.data[bank] |= bit;
+  } else {
+	REGS_GPIO->fe_detect_enable.data[bank] &= ~bit;
+  }
+  REGS_GPIO->ev_detect_status.data[bank] = bit;
+}
+
+u32 gpio_events_take(u8 bank) {
+  u32 events = REGS_GPIO->ev_detect_status.data[bank];
+
+  if (events) {
+	REGS_GPIO->ev_detect_status.data[bank] = events;
+  }
+  return events;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file idle.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Tickless idle implementation
+ *
+ * The statistics of a core are written by that core only, with IRQs
+ * masked; the shell command reads them racily (stats only).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "idle.h"
+#include "irq.h"
+#include "printf.h"
+#include "shell.h"
+#include "smp.h"
+#include "timer.h"
+
+/**
+ * @brief Idle statistics of a core
+ */
+struct idle_cpu {
+  u64 since;       /**< Start of the accounting (ticks) */
+  u64 sleeps;      /**< WFIs */
+  u64 asleep;      /**< Ticks spent in WFI */
+  u64 timer_wakes; /**< Sleeps ended by the armed deadline */
+  u64 lat_sum;     /**< Wake-up latency of those (ticks) */
+  u64 lat_min;
+  u64 lat_max;
+} ____cacheline_aligned;
+
+static struct idle_cpu idle_cpus[NR_CPUS];
+
+/**
+ * Sleep
+ * - Read the deadline the timer is programmed for (IRQs are masked, so
+ *   it cannot change under us)
+ * - WFI; a pending interrupt ends it even though it is masked
+ * - A sleep that started before the deadline and ended after it was
+ *   ended by the timer: the overshoot is the wake-up latency
+ */
+void idle_enter() {
+  struct idle_cpu *ic = &idle_cpus[smp_processor_id()];
+  u64 deadline = timer_next_deadline();
+  u64 start, end, lat;
+
+  start = timer_get_ticks();
+  asm volatile("dsb sy\n\twfi" ::: "memory");
+  end = timer_get_ticks();
+
+  if (!ic->since) {
+	ic->since = start;
+  }
+  ic->sleeps++;
+  ic->asleep += end - start;
+  if (deadline && start < deadline && end >= deadline) {
+	lat = end - deadline;
+	if (!ic->timer_wakes++ || lat < ic->lat_min) {
+	  ic->lat_min = lat;
+	}
+	if (lat > ic->lat_max) {
+	  ic->lat_max = lat;
+	}
+	ic->lat_sum += lat;
+  }
+}
+
+void idle_reset() {
+  struct idle_cpu *ic = &idle_cpus[smp_processor_id()];
+  u64 flags = irq_local_save();
+
+  ic->since = timer_get_ticks();
+  ic->sleeps = ic->asleep = ic->timer_wakes = 0;
+  ic->lat_sum = ic->lat_min = ic->lat_max = 0;
+  irq_local_restore(flags);
+}
+
+static u64 idle_ticks_to_ns(u64 ticks) {
+  return ticks * 1000 * USEC_PER_SEC / timer_get_freq();
+}
+
+/**
+ * Report: residency as the share of the time since the accounting
+ * started, latencies in ns
+ */
+SHELL_CMD(idle, "[reset]", "idle residency and wake-up latency per core") {
+  struct idle_cpu *ic;
+  u64 now = timer_get_ticks(), total;
+  u32 core;
+
+  if (argc == 2 && shell_streq(argv[1], "reset")) {
+	idle_reset();
+	return 0;
+  }
+  for (core = 0; core < NR_CPUS; core++) {
+	ic = &idle_cpus[core];
+	if (!ic->since) {
+	  printf("core %u: never idle\n", core);
+	  continue;
+	}
+	total = now - ic->since;
+	printf("core %u: %lu sleeps, %lu%% asleep, %lu timer wake-ups", core,
+		   ic->sleeps, total ? ic->asleep * 100 / total : 0, ic->timer_wakes);
+	if (ic->timer_wakes) {
+	  printf(", latency %lu/%lu/%lu ns (min/avg/max)",
+			 idle_ticks_to_ns(ic->lat_min),
+			 idle_ticks_to_ns(ic->lat_sum / ic->timer_wakes),
+			 idle_ticks_to_ns(ic->lat_max));
+	}
+	printf("\n");
+  }
+  return 0;
+}
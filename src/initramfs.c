@@ -0,0 +1,349 @@
+/**
+ * @file initramfs.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Initramfs index implementation
+ *
+ * The index is an open-addressing hash table (linear probing) of
+ * positions in files[], which holds the entries in archive order. With
+ * at most half of the slots used, a lookup is one hash of the path and
+ * one or two probes, each compared on the hash first.
+ *
+ * Archive headers are ASCII (hex for cpio, octal for tar) and read byte
+ * by byte, so the parsing does no unaligned access.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "initramfs.h"
+#include "printf.h"
+#include "shell.h"
+
+#define CPIO_HDR_LEN 110      /**< "070701" + 13 fields of 8 hex digits */
+#define CPIO_MODE 1           /**< Field nr of c_mode */
+#define CPIO_FILESIZE 6
+#define CPIO_NAMESIZE 11
+#define CPIO_S_IFMT 0170000
+#define CPIO_S_IFREG 0100000
+#define CPIO_TRAILER "TRAILER!!!"
+
+#define TAR_BLOCK 512
+#define TAR_NAME_LEN 100
+#define TAR_SIZE 124          /**< 12 octal digits */
+#define TAR_TYPEFLAG 156
+#define TAR_MAGIC 257         /**< "ustar" */
+#define TAR_PREFIX 345
+
+#define FNV_OFFSET 2166136261U
+#define FNV_PRIME 16777619U
+
+static struct file files[INITRAMFS_MAX_FILES];
+static u16 slots[INITRAMFS_HASH_SIZE]; /**< files[] position + 1, 0: free */
+static u32 nr_files;
+static u32 nr_skipped;                 /**< Entries not indexed */
+static const u8 *archive;
+static u64 archive_size;
+
+static u32 initramfs_hash(const char *name, u32 len) {
+  u32 h = FNV_OFFSET;
+
+  while (len--) {
+	h = (h ^ (u8)*name++) * FNV_PRIME;
+  }
+  return h;
+}
+
+/**
+ * Drop the leading "/" and "./" of a path
+ */
+static const char *initramfs_strip(const char *name, u32 *len) {
+  while (*len) {
+	if (name[0] == '/') {
+	  name++;
+	  (*len)--;
+	} else if (*len >= 2 && name[0] == '.' && name[1] == '/') {
+	  name += 2;
+	  *len -= 2;
+	} else {
+	  break;
+	}
+  }
+  return name;
+}
+
+static int initramfs_name_eq(const struct file *f, const char *name, u32 len,
+							 u32 hash) {
+  u32 i;
+
+  if (f->hash != hash || f->name_len != len) {
+	return 0;
+  }
+  for (i = 0; i < len; i++) {
+	if (f->name[i] != name[i]) {
+	  return 0;
+	}
+  }
+  return 1;
+}
+
+/**
+ * Probe for a name: the slot holding it, or the free slot where it goes
+ */
+static u16 *initramfs_slot(const char *name, u32 len, u32 hash) {
+  u32 i = hash & (INITRAMFS_HASH_SIZE - 1);
+
+  while (slots[i] && !initramfs_name_eq(&files[slots[i] - 1], name, len, hash)) {
+	i = (i + 1) & (INITRAMFS_HASH_SIZE - 1);
+  }
+  return &slots[i];
+}
+
+/**
+ * Index one regular file
+ * - Same path again: the entry is updated in place
+ * - Table full (or a name that is only "/" or "./"): skipped
+ */
+static void initramfs_add(const char *name, u32 len, const u8 *data, u64 size) {
+  struct file *f;
+  u16 *slot;
+  u32 hash;
+
+  name = initramfs_strip(name, &len);
+  if (!len) {
+	nr_skipped++;
+	return;
+  }
+  hash = initramfs_hash(name, len);
+  slot = initramfs_slot(name, len, hash);
+  if (*slot) {
+	f = &files[*slot - 1];
+  } else if (nr_files < INITRAMFS_MAX_FILES) {
+	f = &files[nr_files++];
+	*slot = nr_files;
+  } else {
+	nr_skipped++;
+	return;
+  }
+  f->name = name;
+  f->name_len = len;
+  f->hash = hash;
+  f->data = data;
+  f->size = size;
+}
+
+/**
+ * Parse n digits in a base (8 or 16); spaces and NULs end the number
+ * (tar pads with them)
+ */
+static int initramfs_number(const u8 *p, u32 n, u32 base, u64 *val) {
+  u32 d;
+
+  *val = 0;
+  while (n-- && *p != ' ' && *p != '\0') {
+	if (*p >= '0' && *p <= '9') {
+	  d = *p - '0';
+	} else if (*p >= 'a' && *p <= 'f') {
+	  d = *p - 'a' + 10;
+	} else if (*p >= 'A' && *p <= 'F') {
+	  d = *p - 'A' + 10;
+	} else {
+	  return -1;
+	}
+	if (d >= base) {
+	  return -1;
+	}
+	*val = *val * base + d;
+	p++;
+  }
+  return 0;
+}
+
+static int initramfs_prefix(const u8 *p, const char *s) {
+  while (*s) {
+	if (*p++ != (u8)*s++) {
+	  return 0;
+	}
+  }
+  return 1;
+}
+
+static u64 initramfs_align(u64 off, u64 align) {
+  return (off + align - 1) & ~(align - 1);
+}
+
+/**
+ * cpio newc
+ * - Header, name (namesize counts the NUL) padded so header + name is a
+ *   multiple of 4, data padded to 4
+ * - Stop at the trailer, at a bad header or at anything past the end
+ */
+static void initramfs_cpio(const u8 *p, u64 size) {
+  u64 off = 0, mode, filesize, namesize, data;
+  const u8 *hdr;
+
+  while (off + CPIO_HDR_LEN <= size) {
+	hdr = p + off;
+	if (!initramfs_prefix(hdr, "07070") || (hdr[5] != '1' && hdr[5] != '2') ||
+		initramfs_number(hdr + 6 + 8 * CPIO_MODE, 8, 16, &mode) ||
+		initramfs_number(hdr + 6 + 8 * CPIO_FILESIZE, 8, 16, &filesize) ||
+		initramfs_number(hdr + 6 + 8 * CPIO_NAMESIZE, 8, 16, &namesize) ||
+		namesize == 0 || namesize > size - off - CPIO_HDR_LEN) {
+	  return;
+	}
+	data = initramfs_align(off + CPIO_HDR_LEN + namesize, 4);
+	if (data > size || filesize > size - data) {
+	  return;
+	}
+	if (namesize == sizeof(CPIO_TRAILER) &&
+		initramfs_prefix(hdr + CPIO_HDR_LEN, CPIO_TRAILER)) {
+	  return;
+	}
+	if ((mode & CPIO_S_IFMT) == CPIO_S_IFREG) {
+	  initramfs_add((const char *)hdr + CPIO_HDR_LEN, namesize - 1, p + data,
+					filesize);
+	} else {
+	  nr_skipped++;
+	}
+	off = initramfs_align(data + filesize, 4);
+  }
+}
+
+/**
+ * ustar
+ * - 512-byte header, then the data rounded up to 512 bytes
+ * - A zero block (or a header without the magic) ends the archive
+ */
+static void initramfs_tar(const u8 *p, u64 size) {
+  u64 off = 0, filesize;
+  const u8 *hdr;
+  u32 len;
+  u8 type;
+
+  while (off + TAR_BLOCK <= size) {
+	hdr = p + off;
+	if (hdr[0] == '\0' || !initramfs_prefix(hdr + TAR_MAGIC, "ustar") ||
+		initramfs_number(hdr + TAR_SIZE, 12, 8, &filesize) ||
+		filesize > size - off - TAR_BLOCK) {
+	  return;
+	}
+	type = hdr[TAR_TYPEFLAG];
+	if ((type == '0' || type == '\0') && hdr[TAR_PREFIX] == '\0') {
+	  for (len = 0; len < TAR_NAME_LEN && hdr[len]; len++) {
+		;
+	  }
+	  initramfs_add((const char *)hdr, len, hdr + TAR_BLOCK, filesize);
+	} else {
+	  nr_skipped++;
+	}
+	off += TAR_BLOCK + initramfs_align(filesize, TAR_BLOCK);
+  }
+}
+
+/**
+ * Index
+ * - Clear the previous index
+ * - Pick the parser from the first header's magic
+ */
+int initramfs_init(const void *base, u64 size) {
+  const u8 *p = base;
+  u32 i;
+
+  for (i = 0; i < INITRAMFS_HASH_SIZE; i++) {
+	slots[i] = 0;
+  }
+  nr_files = nr_skipped = 0;
+  archive = NULL;
+  archive_size = 0;
+
+  if (size >= CPIO_HDR_LEN && initramfs_prefix(p, "07070")) {
+	initramfs_cpio(p, size);
+  } else if (size >= TAR_BLOCK && initramfs_prefix(p + TAR_MAGIC, "ustar")) {
+	initramfs_tar(p, size);
+  } else {
+	return -1;
+  }
+  archive = p;
+  archive_size = size;
+  return nr_files;
+}
+
+/**
+ * Lookup: strip the path like the archive names, hash, probe
+ */
+const struct file *file_open(const char *path) {
+  u32 len = 0, hash;
+  u16 *slot;
+
+  while (path[len]) {
+	len++;
+  }
+  path = initramfs_strip(path, &len);
+  hash = initramfs_hash(path, len);
+  slot = initramfs_slot(path, len, hash);
+  return *slot ? &files[*slot - 1] : NULL;
+}
+
+const void *file_map(const char *path, u64 *size) {
+  const struct file *f = file_open(path);
+
+  if (!f) {
+	return NULL;
+  }
+  if (size) {
+	*size = f->size;
+  }
+  return f->data;
+}
+
+u32 initramfs_count() {
+  return nr_files;
+}
+
+const struct file *initramfs_file(u32 i) {
+  return i < nr_files ? &files[i] : NULL;
+}
+
+SHELL_CMD(ls, "", "list the initramfs files") {
+  const struct file *f;
+  u32 i, j;
+
+  if (!archive) {
+	printf("initramfs: none\n");
+	return 0;
+  }
+  for (i = 0; i < nr_files; i++) {
+	f = &files[i];
+	printf("%10lu ", f->size);
+	for (j = 0; j < f->name_len; j++) {
+	  printf("%c", f->name[j]); /**< Names are not all NUL-terminated */
+	}
+	printf("\n");
+  }
+  printf("%u files (%u entries skipped), %lu bytes at 0x%lx\n", nr_files,
+		 nr_skipped, archive_size, (u64)(uintptr_t)archive);
+  return 0;
+}
+
+/**
+ * Print a file; bytes that are not printable text go out as '.'
+ */
+SHELL_CMD(cat, "<path>", "print an initramfs file") {
+  const u8 *data;
+  u64 size, i;
+  u8 c;
+
+  if (argc != 2) {
+	return -1;
+  }
+  data = file_map(argv[1], &size);
+  if (!data) {
+	printf("cat: %s: not found\n", argv[1]);
+	return 1;
+  }
+  for (i = 0; i < size; i++) {
+	c = data[i];
+	printf("%c", (c >= ' ' && c < 0x7F) || c == '\n' || c == '\t' ? c : '.');
+  }
+  return 0;
+}
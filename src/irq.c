@@ -0,0 +1,290 @@
+/**
+ * @file irq.c
+ * @author Jose Pires
+ * @date 2024-10-14
+ *
+ * @brief Interrupt handling implementation
+ *
+ * It follows the documentation:
+ * - ARM GIC-400 TRM, ARM GICv2 architecture specification (RPi 4)
+ * - BCM2836 ARM-local peripherals, BCM2835 peripherals (RPi 3)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "irq.h"
+#include "common.h"
+#include "fpsimd.h"
+#include "peripherals/irq.h"
+#include "printf.h"
+#include "smp.h"
+#include "sysregs.h"
+#include "trace.h"
+
+extern char vectors[]; /**< Vector table (entry.S) */
+extern void err_hang() __attribute__((noreturn)); /**< entry.S */
+
+/**
+ * @brief Registered handler
+ */
+struct irq_action {
+  irq_handler fn;
+  void *arg;
+};
+
+static struct irq_action irq_table[IRQ_NR];
+
+static const char *entry_error_messages[] = {
+  "SYNC_INVALID_EL1t",   "IRQ_INVALID_EL1t",
+  "FIQ_INVALID_EL1t",    "ERROR_INVALID_EL1t",
+  "SYNC_INVALID_EL1h",   "IRQ_INVALID_EL1h",
+  "FIQ_INVALID_EL1h",    "ERROR_INVALID_EL1h",
+  "SYNC_INVALID_EL0_64", "IRQ_INVALID_EL0_64",
+  "FIQ_INVALID_EL0_64",  "ERROR_INVALID_EL0_64",
+  "SYNC_INVALID_EL0_32", "IRQ_INVALID_EL0_32",
+  "FIQ_INVALID_EL0_32",  "ERROR_INVALID_EL0_32",
+};
+
+/**
+ * Report an exception we do not handle (called from entry.S)
+ */
+__cold void show_invalid_entry_message(u32 type, u64 esr, u64 elr) {
+  printf("Unhandled exception %s on core %u: ESR 0x%lx, ELR 0x%lx\n",
+		 entry_error_messages[type & 0xF], smp_processor_id(), esr, elr);
+}
+
+/**
+ * Synchronous exception from EL1 (called from entry.S)
+ * - FP/SIMD access trap: lazy FP/SIMD enable, then retry the instruction
+ * - Anything else is a kernel bug: report and hang
+ */
+void handle_sync(struct pt_regs *regs) {
+  u64 esr;
+
+  asm volatile("mrs %0, esr_el1" : "=r"(esr));
+  if (((esr >> ESR_ELx_EC_SHIFT) & ESR_ELx_EC_MASK) == ESR_ELx_EC_FP_ASIMD) {
+	fpsimd_trap();
+	return;
+  }
+  show_invalid_entry_message(SYNC_INVALID_EL1h, esr, regs->elr);
+  err_hang();
+}
+
+void irq_register(u32 irq, irq_handler fn, void *arg) {
+  if (irq >= IRQ_NR) {
+	return;
+  }
+  irq_table[irq].arg = arg;
+  irq_table[irq].fn = fn;
+}
+
+/**
+ * Run the handler of an IRQ
+ */
+static void irq_dispatch(u32 irq, struct pt_regs *regs) {
+  struct irq_action *action = &irq_table[irq];
+
+  if (action->fn) {
+	TRACE(IRQ_ENTRY, irq);
+	action->fn(action->arg, regs);
+	TRACE(IRQ_EXIT, irq);
+  } else {
+	printf("Unhandled IRQ %u on core %u\n", irq, smp_processor_id());
+  }
+}
+
+#if RPI_VERSION == 4
+
+/**
+ * Initialize the GIC distributor
+ * - Disable it while configuring
+ * - SPIs: disabled, not pending, default priority, level-sensitive,
+ *   routed to core 0
+ * - Enable it
+ */
+void irq_init() {
+  u32 i, nr_lines = 32 * ((REGS_GICD->typer & 0x1F) + 1);
+
+  if (nr_lines > IRQ_NR) {
+	nr_lines = IRQ_NR;
+  }
+
+  REGS_GICD->ctlr = 0;
+  for (i = 32; i < nr_lines; i += 32) {
+	REGS_GICD->icenabler[i / 32] = 0xFFFFFFFF;
+	REGS_GICD->icpendr[i / 32] = 0xFFFFFFFF;
+  }
+  for (i = 32; i < nr_lines; i++) {
+	REGS_GICD->ipriorityr[i] = GIC_PRIO_DEFAULT;
+	REGS_GICD->itargetsr[i] = 1 << 0;
+  }
+  for (i = 2; i < nr_lines / 16; i++) {
+	REGS_GICD->icfgr[i] = 0;
+  }
+  REGS_GICD->ctlr = 1;
+
+  irq_init_cpu();
+}
+
+/**
+ * Initialize the banked per-core parts
+ * - SGIs and PPIs (ids 0 - 31): disabled, default priority
+ * - CPU interface: let every priority through, enable
+ */
+void irq_init_cpu() {
+  u32 i;
+
+  asm volatile("msr vbar_el1, %0" :: "r"(vectors));
+
+  REGS_GICD->icenabler[0] = 0xFFFFFFFF;
+  for (i = 0; i < 32; i++) {
+	REGS_GICD->ipriorityr[i] = GIC_PRIO_DEFAULT;
+  }
+
+  REGS_GICC->pmr = GIC_PRIO_MASK;
+  REGS_GICC->bpr = 0;
+  REGS_GICC->ctlr = 1;
+}
+
+void irq_enable(u32 irq) {
+  if (irq >= IRQ_NR) {
+	return;
+  }
+  if (irq >= 32) {
+	REGS_GICD->itargetsr[irq] = 1 << smp_processor_id();
+  }
+  REGS_GICD->isenabler[irq / 32] = 1 << (irq % 32);
+}
+
+void irq_disable(u32 irq) {
+  if (irq >= IRQ_NR) {
+	return;
+  }
+  REGS_GICD->icenabler[irq / 32] = 1 << (irq % 32);
+}
+
+/**
+ * SGI to one core: target list filter 0 (use the list), CPU target list
+ * in bits 16-23
+ */
+void irq_send_ipi(u32 core) {
+  asm volatile("dsb sy" ::: "memory");
+  REGS_GICD->sgir = (1 << (16 + core)) | IRQ_IPI;
+}
+
+/**
+ * Nothing to clear: the SGI is acknowledged by IAR/EOIR in handle_irq()
+ */
+void irq_ack_ipi() {
+}
+
+/**
+ * Handle IRQs until none is pending
+ * - Acknowledge (IAR), dispatch, signal the end (EOIR)
+ */
+void handle_irq(struct pt_regs *regs) {
+  u32 iar, irq;
+
+  while ((irq = (iar = REGS_GICC->iar) & 0x3FF) < GIC_SPURIOUS) {
+	irq_dispatch(irq, regs);
+	REGS_GICC->eoir = iar;
+  }
+}
+
+#else
+
+/**
+ * Initialize the BCM2835 controller: every VideoCore IRQ disabled and
+ * routed to core 0 (GPU_INT_ROUTING)
+ */
+void irq_init() {
+  REGS_IRQ->disable[0] = 0xFFFFFFFF;
+  REGS_IRQ->disable[1] = 0xFFFFFFFF;
+  REGS_IRQ->disable_basic = 0xFFFFFFFF;
+  REGS_ARM_LOCAL->gpu_int_routing = 0;
+
+  irq_init_cpu();
+}
+
+void irq_init_cpu() {
+  asm volatile("msr vbar_el1, %0" :: "r"(vectors));
+}
+
+/**
+ * Unmask an IRQ
+ * - VideoCore IRQs: BCM2835 enable registers
+ * - ARM-local sources: the calling core's timer/mailbox control, or the
+ *   PMU routing
+ */
+void irq_enable(u32 irq) {
+  u32 core = smp_processor_id();
+
+  if (irq >= IRQ_VC(0) && irq < IRQ_NR) {
+	REGS_IRQ->enable[(irq - IRQ_VC(0)) / 32] = 1 << (irq % 32);
+  } else if (irq <= IRQ_TIMER_CNTV) {
+	REGS_ARM_LOCAL->timer_int_ctrl[core] |= 1 << irq;
+  } else if (irq <= IRQ_LOCAL_MBOX(3)) {
+	REGS_ARM_LOCAL->mbox_int_ctrl[core] |= 1 << (irq - IRQ_LOCAL_MBOX(0));
+  } else if (irq == IRQ_PMU(core)) {
+	REGS_ARM_LOCAL->pmu_int_routing_set = 1 << core;
+  }
+}
+
+void irq_disable(u32 irq) {
+  u32 core = smp_processor_id();
+
+  if (irq >= IRQ_VC(0) && irq < IRQ_NR) {
+	REGS_IRQ->disable[(irq - IRQ_VC(0)) / 32] = 1 << (irq % 32);
+  } else if (irq <= IRQ_TIMER_CNTV) {
+	REGS_ARM_LOCAL->timer_int_ctrl[core] &= ~(1 << irq);
+  } else if (irq <= IRQ_LOCAL_MBOX(3)) {
+	REGS_ARM_LOCAL->mbox_int_ctrl[core] &= ~(1 << (irq - IRQ_LOCAL_MBOX(0)));
+  } else if (irq == IRQ_PMU(core)) {
+	REGS_ARM_LOCAL->pmu_int_routing_clr = 1 << core;
+  }
+}
+
+/**
+ * Set a bit in the target's mailbox 0: the mailbox IRQ stays raised
+ * until the target clears it
+ */
+void irq_send_ipi(u32 core) {
+  asm volatile("dsb sy" ::: "memory");
+  REGS_ARM_LOCAL->mbox_set[4 * core] = 1;
+}
+
+void irq_ack_ipi() {
+  u32 core = smp_processor_id();
+
+  REGS_ARM_LOCAL->mbox_clr[4 * core] = 0xFFFFFFFF;
+}
+
+/**
+ * Handle the pending IRQs
+ * - Walk the core's IRQ source bits (lowest first)
+ * - The GPU bit fans out to the BCM2835 pending registers
+ */
+void handle_irq(struct pt_regs *regs) {
+  u32 core = smp_processor_id();
+  u32 src = REGS_ARM_LOCAL->irq_source[core] & 0xFFF;
+  u32 i, pending;
+
+  while (src) {
+	u32 irq = __builtin_ctz(src);
+	src &= src - 1;
+
+	if (irq != IRQ_LOCAL_GPU) {
+	  irq_dispatch(irq, regs);
+	  continue;
+	}
+	for (i = 0; i < 2; i++) {
+	  pending = REGS_IRQ->pending[i];
+	  while (pending) {
+		irq_dispatch(IRQ_VC(32 * i + __builtin_ctz(pending)), regs);
+		pending &= pending - 1;
+	  }
+	}
+  }
+}
+
+#endif
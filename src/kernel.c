@@ -1,13 +1,61 @@
+#include "baud.h"
+#include "bench.h"
+#include "boottime.h"
 #include "common.h"
-//#include "mini_uart.h"
+#include "console_link.h"
+#include "cpufreq.h"
+#include "event.h"
+#include "fdt.h"
+#include "fpsimd.h"
+#include "initramfs.h"
+#include "irq.h"
+#include "mailbox.h"
+#include "mini_uart.h"
+#include "mm.h"
+#include "mmu.h"
 #include "peripherals/pl011.h"
+#include "percpu.h"
 #include "pl011.h"
+#include "prof.h"
+#include "sections.h"
+#include "serial.h"
+#include "shell.h"
+#include "smp.h"
+#include "sprof.h"
+#include "timer.h"
+#include "trace.h"
 #include "utils.h"
 
 #include "printf.h"
 
 #define UART_PL011 1 /**< UART to use: 1 (PL011), 0 (mini-uart) */
+#ifndef CONSOLE_UART
+#define CONSOLE_UART 5 /**< PL011 console: 5 (GPIO 12/13), 0 (GPIO 14/15, QEMU) */
+#endif
+#ifndef CONSOLE_BAUD
+#define CONSOLE_BAUD 115200 /**< Console rate at boot */
+#endif
+#define CONSOLE_CMD_PROF 0x10 /**< Ctrl-P: dump the profiling stats */
+#define CONSOLE_CMD_SPROF 0x14 /**< Ctrl-T: start/stop the sampling profiler */
+#define STREAM_PERIOD_US 10000 /**< Sample/trace streaming period */
+#define INITRAMFS_MAP_END (1UL << MM_L1_SHIFT) /**< RAM mapped Normal */
 
+#if UART_PL011 == 1
+/**
+ * @brief Console PL011, fixed at build time: console_send(),
+ * console_putc() and console_vprintf() have its register base folded in
+ * (see PL011_DEFINE); console_dev() is the same UART for the generic API
+ */
+#if CONSOLE_UART == 0 && defined(CONSOLE_FLOW)
+PL011_DEFINE_CFG(console, UART0, UART0_GPIO_FLOW)
+#elif CONSOLE_UART == 0
+PL011_DEFINE(console, UART0, 14, 15, GFAlt0)
+#elif defined(CONSOLE_FLOW)
+PL011_DEFINE_CFG(console, UART5, UART5_GPIO_FLOW)
+#else
+PL011_DEFINE(console, UART5, 12, 13, GFAlt4)
+#endif
+#else
 /**
  * @brief Put a char on the output (UART)
  * @param p: unused
@@ -24,15 +72,6 @@
  * - args: (void *, char c)
  * - return: void
  */
-#if UART_PL011 == 1
-void putc(void *p, char c) {
-  pl011_uart *uart = (pl011_uart *) p;
-  if(c == '\n'){
-	pl011_send(uart, '\r');
-  }
-  pl011_send(uart, c);
-}
-#else
 void putc(void* p, char c){
   if(c == '\n'){
 	uart_send('\r');
@@ -85,8 +124,7 @@ void test_pl011() {
 
   put32(UART_CR, 0x301);
 
-  while(get3
-2(UART_FR)&0x20) {}			// wait if TX is full
+  while(get32(UART_FR)&0x20) {}			// wait if TX is full
   put32(UART_DR,'H');
   while(get32(UART_FR)&0x20) {}			// wait if TX is full
   put32(UART_DR,'H');
@@ -96,27 +134,350 @@ void test_pl011() {
   put32(UART_DR,'H');
 }
 
-void kernel_main() {
+/**
+ * @brief Bring the clocks to a known state before the UARTs are set up
+ *
+ * - Start the frequency governor, which raises the ARM cores to their
+ *   max frequency (the firmware default is often lower)
+ * - Hand the real UART and core clocks to the UART drivers, so the
+ *   divisors are computed from what the firmware actually configured
+ */
+__cold static void clocks_init() {
+  cpufreq_init();
+
+  pl011_set_uartclk(mbox_get_clock_rate(MBOX_CLK_UART));
+  uart_set_sysclk(mbox_get_clock_rate(MBOX_CLK_CORE));
+}
+
+/**
+ * @brief Print the board information reported by the firmware
+ */
+__cold static void board_info() {
+  u32 mem_base = 0, mem_size = 0;
+
+  mbox_get_arm_memory(&mem_base, &mem_size);
+  printf("\tRevision: 0x%x\n", mbox_get_board_revision());
+  printf("\tARM memory: 0x%x + %u MiB\n", mem_base, mem_size >> 20);
+  printf("\tARM clock: %u MHz (max %u MHz)\n",
+		 mbox_get_clock_rate(MBOX_CLK_ARM) / 1000000,
+		 mbox_get_max_clock_rate(MBOX_CLK_ARM) / 1000000);
+  printf("\tUART clock: %u Hz\n", pl011_get_uartclk());
+  cpufreq_report();
+}
+
+/**
+ * @brief Print where the image and the stacks sit in memory
+ *
+ * There is no heap: this is all the kernel's memory
+ */
+static void mem_info() {
+  printf("\ttext   0x%lx-0x%lx %lu KiB (hot %lu B, cold %lu B)\n",
+		 (u64)_text, (u64)_etext, (u64)(_etext - _text) >> 10,
+		 (u64)(__hot_text_end - __hot_text_start),
+		 (u64)(__cold_text_end - __cold_text_start));
+  printf("\trodata 0x%lx-0x%lx %lu KiB\n", (u64)_rodata, (u64)_erodata,
+		 (u64)(_erodata - _rodata) >> 10);
+  printf("\tdata   0x%lx-0x%lx %lu KiB\n", (u64)_data, (u64)_edata,
+		 (u64)(_edata - _data) >> 10);
+  printf("\tbss    0x%lx-0x%lx %lu KiB\n", (u64)bss_begin, (u64)bss_end,
+		 (u64)(bss_end - bss_begin) >> 10);
+  printf("\tdma    0x%lx-0x%lx %lu KiB\n", (u64)__dma_start, (u64)__dma_end,
+		 (u64)(__dma_end - __dma_start) >> 10);
+  printf("\tpercpu %lu B x %u cores\n",
+		 (u64)(__per_cpu_end - __per_cpu_start), NR_CPUS);
+  printf("\tstacks 0x%lx-0x%x %u KiB x %u cores\n",
+		 (u64)(LOW_MEMORY - NR_CPUS * CORE_STACK_SIZE), LOW_MEMORY,
+		 CORE_STACK_SIZE >> 10, NR_CPUS);
+}
+
+SHELL_CMD(info, "", "board, clocks and memory layout") {
+  board_info();
+  mem_info();
+  return 0;
+}
+
+static struct timer_event stream_timer; /**< Defined with stream_tick() */
+
+/**
+ * @brief Run the console hotkey a received char stands for, or hand it
+ * to the shell
+ * @param c: received char
+ */
+static void console_key(char c) {
+  if (c == CONSOLE_CMD_PROF) {
+	prof_dump();
+	return;
+  }
+  if (c == CONSOLE_CMD_SPROF) {
+	if (sprof_active()) {
+	  sprof_stop();
+	  sprof_stream();
+	} else {
+	  sprof_start(SPROF_DEFAULT_PERIOD);
+	  timer_event_start(&stream_timer, STREAM_PERIOD_US, STREAM_PERIOD_US);
+	}
+	return;
+  }
+  shell_input(c);
+}
+
+/**
+ * @brief Point printf at the console UART (boot, and `link off`)
+ */
+static void console_printf_init() {
+#if UART_PL011 == 1 && defined(CONSOLE_FLOW)
+  init_printf(NULL, serial_putc);
+  init_vprintf(serial_vprintf); /**< printf formats into the TX ring */
+#elif UART_PL011 == 1
+  init_printf(NULL, console_putc);
+  init_vprintf(console_vprintf); /**< One inlined send loop per printf */
+#else
+  init_printf(0, putc);
+#endif
+}
+
+/**
+ * @brief Send bytes untranslated (no CR before LF): the framed console's
+ * output (console_link.h)
+ */
+static void console_write_raw(void *arg, const u8 *buf, u32 len) {
+#if UART_PL011 == 1 && defined(CONSOLE_FLOW)
+  u32 n;
+
+  while (len) {
+	n = serial_write(buf, len);
+	buf += n;
+	len -= n;
+  }
+#elif UART_PL011 == 1
+  while (len--) {
+	console_send(*buf++);
+  }
+#else
+  while (len--) {
+	uart_send(*buf++);
+  }
+#endif
+}
+
+static const struct console_link_ops console_link_ops = {
+  .write = console_write_raw,
+  .key = console_key,
+  .printf_init = console_printf_init,
+};
+
+/**
+ * @brief Take a received char, in framed mode or not
+ */
+static void console_input(char c) {
+  if (console_link_active()) {
+	console_link_input(c);
+  } else {
+	console_key(c);
+  }
+}
+
+/**
+ * @brief Governor tick: report every frequency change on the console;
+ * once settled at the minimum rate, stop ticking until there is work
+ */
+static void cpufreq_tick(void *arg);
+static struct timer_event cpufreq_timer = TIMER_EVENT_INIT(cpufreq_tick, NULL);
+
+static void cpufreq_tick(void *arg) {
+  if (cpufreq_evaluate()) {
+	cpufreq_report();
+  }
+  if (cpufreq_settled()) {
+	timer_event_stop(&cpufreq_timer);
+  }
+}
+
+/**
+ * @brief Count work for the governor, restarting its tick if it stopped
+ */
+static void console_busy() {
+  cpufreq_mark_busy();
+  if (!cpufreq_timer.armed) {
+	timer_event_start(&cpufreq_timer, CPUFREQ_PERIOD_US, CPUFREQ_PERIOD_US);
+  }
+}
+
+/**
+ * @brief Console RX work: hand every char waiting to console_input()
+ *
+ * Received chars count as work (keeps the ARM clock up). The RX
+ * interrupt was masked by console_rx_irq(): unmask it once the FIFO is
+ * empty.
+ */
+static void console_rx(void *arg) {
+#if UART_PL011 == 1 && defined(CONSOLE_FLOW)
+  int c;
+
+  while ((c = serial_getc()) >= 0) {
+	console_input(c);
+	console_busy();
+  }
+#elif UART_PL011 == 1
+  while (console_can_recv()) {
+	console_input( console_recv() );
+	console_busy();
+  }
+  pl011_rx_irq(console_dev(), 1);
+#else
+  while (uart_can_recv()) {
+	console_input( uart_recv() );
+	console_busy();
+  }
+  uart_rx_irq(1);
+#endif
+}
+
+static struct work console_rx_work = WORK_INIT(console_rx, NULL);
+
+#if !defined(CONSOLE_FLOW) || UART_PL011 != 1
+/**
+ * @brief Console UART interrupt: mask RX and leave the reading to the
+ * console work
+ */
+static void console_rx_irq(void *arg, struct pt_regs *regs) {
+#if UART_PL011 == 1
+  pl011_rx_irq(console_dev(), 0);
+#else
+  uart_rx_irq(0);
+#endif
+  work_queue(&console_rx_work);
+}
+#endif
+
+/**
+ * @brief Make received console chars queue the console work
+ * - Buffered console: from the serial interrupt
+ * - PL011 / mini-UART: from the UART interrupt, RX masked until the
+ *   work has run
+ */
+static void console_events_init() {
+#if UART_PL011 == 1 && defined(CONSOLE_FLOW)
+  serial_set_rx_work(&console_rx_work);
+#elif UART_PL011 == 1
+  irq_register(IRQ_UART, console_rx_irq, NULL);
+  pl011_rx_irq(console_dev(), 1);
+  irq_enable(IRQ_UART);
+#else
+  irq_register(IRQ_AUX, console_rx_irq, NULL);
+  uart_rx_irq(1);
+  irq_enable(IRQ_AUX);
+#endif
+}
+
+/**
+ * @brief Stream the profiler samples and trace records; go again right
+ * away while the trace backlog fills whole batches. Without TRACE=y
+ * there is nothing to stream once sampling stops: stop ticking (Ctrl-T
+ * starts it again)
+ */
+static void stream_tick(void *arg) {
+  struct timer_event *self = arg;
+
+  sprof_stream();
+#ifdef KERNEL_TRACE
+  if ((console_link_active() ?
+	   trace_stream_to(TRACE_STREAM_BATCH, console_link_trace, NULL) :
+	   trace_stream(TRACE_STREAM_BATCH)) == TRACE_STREAM_BATCH) {
+	work_queue(&self->work);
+  }
+#else
+  if (!sprof_active()) {
+	timer_event_stop(self);
+  }
+#endif
+}
+
+static struct timer_event stream_timer =
+  TIMER_EVENT_INIT(stream_tick, &stream_timer);
+
+/**
+ * @brief Index the initramfs the firmware loaded, if any
+ * @param dtb: DTB address passed by the firmware
+ *
+ * The archive must lie above the kernel image, its BSS and the stacks:
+ * the firmware's `followkernel` placement puts it right after the
+ * image, where the BSS clear has already overwritten it (config.txt
+ * gives it a fixed address instead), and within the first GiB, the only
+ * RAM mapped Normal (mmu.c)
+ */
+static void initramfs_setup(u64 dtb) {
+  const void *fdt = (const void *)dtb;
+  u64 start, end;
+  int n;
+
+  if (fdt_check(fdt)) {
+	printf("initramfs: no device tree at 0x%lx\n", dtb);
+	return;
+  }
+  if (fdt_getprop_u64(fdt, "/chosen", "linux,initrd-start", &start) ||
+	  fdt_getprop_u64(fdt, "/chosen", "linux,initrd-end", &end) ||
+	  end <= start) {
+	printf("initramfs: none\n");
+	return;
+  }
+  if (start < (u64)_end || start < LOW_MEMORY) {
+	printf("initramfs: at 0x%lx, overlaps the kernel (load it above 0x%lx)\n",
+		   start, (u64)_end > LOW_MEMORY ? (u64)_end : (u64)LOW_MEMORY);
+	return;
+  }
+  if (end > INITRAMFS_MAP_END) {
+	printf("initramfs: at 0x%lx, past the first GiB (not mapped as RAM)\n",
+		   start);
+	return;
+  }
+  n = initramfs_init((const void *)start, end - start);
+  if (n < 0) {
+	printf("initramfs: unknown format at 0x%lx\n", start);
+  } else {
+	printf("initramfs: %d files, %lu bytes at 0x%lx\n", n, end - start, start);
+  }
+}
+
+/**
+ * @brief Kernel entry (boot.S), on core 0
+ * @param dtb: DTB address passed by the firmware in x0
+ */
+void kernel_main(u64 dtb) {
+  boot_time_init();
+
+  percpu_init();
+  boot_mark("percpu_init");
+  irq_init();
+  fpsimd_init_cpu(); /**< NEON_FILES code traps in on first use */
+  timer_init_cpu(); /**< Event stream: udelay() sleeps in WFE */
+  boot_mark("irq_init");
+  prof_init();
+  boot_mark("prof_init");
+  clocks_init();
+  boot_mark("clocks_init");
 
 #if UART_PL011 == 1
 #warning "PL011 UART is being used"
 
   // test_pl011();
-  const uart_gpio uart5_alt4 = {.tx = 12, .rx = 13, .func = GFAlt4};
-  pl011_uart uart5 = {.regs = (pl011_regs *const)UART5, .gpio = &uart5_alt4};
+  pl011_uart *uart = console_dev();
 
-  pl011_uart *uart = &uart5;
-
- pl011_init(uart, 115200);
- init_printf(uart, putc); /**< Init printf w/ a function ptr to putchar */
- printf("\n\nuart5->regs %u\n", (unsigned long)uart5.regs);
- printf("UART0 %u\n", (unsigned long)UART0);
+ pl011_init(uart, CONSOLE_BAUD);
+ baud_set_rate(CONSOLE_BAUD);
+#ifdef CONSOLE_FLOW
+ serial_init(uart); /**< Buffered, interrupt-driven, RTS/CTS */
+#endif
+ console_printf_init();
+ boot_mark("console_init");
+ printf("\n\nconsole->regs 0x%lx\n", (unsigned long)uart->regs);
 
- printf("RPI4 Baremetal UART5 PL011 in the house");
+ printf("RPI%u Baremetal UART%u PL011 in the house", RPI_VERSION, CONSOLE_UART);
 #else
 #warning "mini-UART is being used"
   uart_init(); /**< Initialize the UART */
-  init_printf(0, putc); /**< Init printf w/ a function ptr to putchar */
+  console_printf_init();
+  boot_mark("console_init");
   printf("RPi Baremetal OS initializing...\n");
 #endif  
 
@@ -128,13 +489,45 @@ void kernel_main() {
   printf("\tBoard: RPi 4\n");
 #endif
 
+  board_info();
+  boot_report();
+  initramfs_setup(dtb);
+  boot_mark("initramfs");
+
   printf("\n\nEL = %d\n", get_el()); /**< Get current Exception level */
 
-  while (1) {
+  smp_init();
+  boot_mark("smp_init");
+
+#ifdef KERNEL_BENCH
 #if UART_PL011 == 1
-	pl011_send( uart, pl011_recv(uart) );
+  bench_run_all(uart);
 #else
-	uart_send( uart_recv() );
-#endif  
-  }
+  bench_run_all(NULL);
+#endif
+#endif
+
+  console_link_init(&console_link_ops); /**< `link on` */
+#if UART_PL011 == 1
+  shell_init(uart);
+#else
+  shell_init(NULL);
+#endif
+
+  /**
+   * Event loop: everything from here on runs as work queued by an event
+   * source, and the core sleeps in WFI in between (tickless, idle.h)
+   * - Console RX: the UART interrupt queues the console work, which feeds
+   *   the shell
+   * - Governor: evaluated every CPUFREQ_PERIOD_US, changes reported;
+   *   stopped while idle at the minimum rate
+   * - Samples (Ctrl-T) and, with TRACE=y, trace records streamed every
+   *   STREAM_PERIOD_US
+   */
+  console_events_init();
+  timer_event_start(&cpufreq_timer, CPUFREQ_PERIOD_US, CPUFREQ_PERIOD_US);
+  timer_event_start(&stream_timer, STREAM_PERIOD_US, STREAM_PERIOD_US);
+  irq_local_enable();
+
+  event_loop();
 }
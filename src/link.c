@@ -0,0 +1,203 @@
+/**
+ * @file link.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Multiplexed framed transport implementation
+ *
+ * COBS as in Cheshire & Baker, "Consistent Overhead Byte Stuffing":
+ * each block is a code byte n followed by n - 1 data bytes, and stands
+ * for those bytes plus a 0x00 unless n is 0xFF (or it ends the frame).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "link.h"
+#include "crc32.h"
+
+/**
+ * Encode
+ * - code_at: where the code of the open block goes
+ * - A 0x00 closes the block; so do 254 data bytes (code 0xFF, no 0x00)
+ */
+u32 cobs_encode(const u8 *src, u32 len, u8 *dst) {
+  u32 i, out = 1, code_at = 0;
+  u8 code = 1;
+
+  for (i = 0; i < len; i++) {
+	if (src[i] == 0) {
+	  dst[code_at] = code;
+	  code_at = out++;
+	  code = 1;
+	  continue;
+	}
+	dst[out++] = src[i];
+	if (++code == 0xFF) {
+	  dst[code_at] = code;
+	  code_at = out++;
+	  code = 1;
+	}
+  }
+  dst[code_at] = code;
+  return out;
+}
+
+int cobs_decode(const u8 *src, u32 len, u8 *dst) {
+  u32 i = 0, out = 0, j;
+  u8 code;
+
+  while (i < len) {
+	code = src[i++];
+	if (code == 0) {
+	  return -1;
+	}
+	for (j = 1; j < code; j++) {
+	  if (i == len || src[i] == 0) {
+		return -1;
+	  }
+	  dst[out++] = src[i++];
+	}
+	if (code != 0xFF && i < len) {
+	  dst[out++] = 0;
+	}
+  }
+  return out;
+}
+
+void link_init(struct link *l, link_write_fn write, void *arg) {
+  u32 i;
+
+  l->write = write;
+  l->arg = arg;
+  l->seq = 0;
+  for (i = 0; i < LINK_HISTORY; i++) {
+	l->hist[i].len = 0;
+  }
+  l->rx_len = 0;
+  l->tx_frames = l->rx_frames = l->rx_bad = l->retransmits = l->lost = 0;
+}
+
+/**
+ * Encode a frame of the history and send it between delimiters: the
+ * leading one ends any garbage before it, so the frame survives it
+ */
+static void link_tx(struct link *l, const struct link_hist *h) {
+  u32 n = cobs_encode(h->frame, h->len, l->tx_enc + 1);
+
+  l->tx_enc[0] = 0;
+  l->tx_enc[n + 1] = 0;
+  l->write(l->arg, l->tx_enc, n + 2);
+}
+
+/**
+ * One frame
+ * - Built in place in its history slot (the oldest frame goes)
+ * - CRC-32 over header and payload, little endian
+ */
+static void link_send_frame(struct link *l, u32 chan, const u8 *buf, u32 len) {
+  struct link_hist *h = &l->hist[l->seq & (LINK_HISTORY - 1)];
+  u32 crc, i;
+
+  h->frame[0] = chan;
+  h->frame[1] = l->seq++;
+  for (i = 0; i < len; i++) {
+	h->frame[LINK_HDR + i] = buf[i];
+  }
+  crc = crc32(h->frame, LINK_HDR + len);
+  for (i = 0; i < LINK_CRC; i++) {
+	h->frame[LINK_HDR + len + i] = crc >> (8 * i);
+  }
+  h->len = LINK_HDR + len + LINK_CRC;
+  l->tx_frames++;
+  link_tx(l, h);
+}
+
+int link_send(struct link *l, u32 chan, const void *buf, u32 len) {
+  const u8 *p = buf;
+  u32 n;
+
+  if (chan >= LINK_CH_NR) {
+	return -1;
+  }
+  do {
+	n = len < LINK_MTU ? len : LINK_MTU;
+	link_send_frame(l, chan, p, n);
+	p += n;
+	len -= n;
+  } while (len);
+  return 0;
+}
+
+/**
+ * Control frame from the host
+ * - NAK: send the frame again if the history still has it, else LOST
+ */
+static void link_control(struct link *l, const u8 *data, u32 len) {
+  struct link_hist *h;
+  u8 lost[2];
+
+  if (len < 2 || data[0] != LINK_CTL_NAK) {
+	return;
+  }
+  h = &l->hist[data[1] & (LINK_HISTORY - 1)];
+  if (h->len && h->frame[1] == data[1]) {
+	l->retransmits++;
+	link_tx(l, h);
+	return;
+  }
+  l->lost++;
+  lost[0] = LINK_CTL_LOST;
+  lost[1] = data[1];
+  link_send_frame(l, LINK_CH_CTL, lost, sizeof(lost));
+}
+
+/**
+ * Receive
+ * - Collect the encoded bytes up to the delimiter (an overflow drops
+ *   the frame, but still ends at the delimiter)
+ * - Decode, check the size and the CRC, then dispatch
+ */
+int link_input(struct link *l, u8 c, struct link_frame *f) {
+  int len;
+  u32 crc, i;
+
+  if (c != 0) {
+	if (l->rx_len < LINK_ENC_MAX) {
+	  l->rx_enc[l->rx_len] = c;
+	}
+	if (l->rx_len <= LINK_ENC_MAX) {
+	  l->rx_len++;
+	}
+	return 0;
+  }
+
+  if (l->rx_len == 0) {
+	return 0;
+  }
+  len = l->rx_len > LINK_ENC_MAX ? -1 :
+	cobs_decode(l->rx_enc, l->rx_len, l->rx_frame);
+  l->rx_len = 0;
+  if (len < LINK_HDR + LINK_CRC || len > LINK_FRAME_MAX) {
+	l->rx_bad++;
+	return 0;
+  }
+  len -= LINK_CRC;
+  for (i = 0, crc = 0; i < LINK_CRC; i++) {
+	crc |= (u32)l->rx_frame[len + i] << (8 * i);
+  }
+  if (crc != crc32(l->rx_frame, len) || l->rx_frame[0] >= LINK_CH_NR) {
+	l->rx_bad++;
+	return 0;
+  }
+
+  l->rx_frames++;
+  if (l->rx_frame[0] == LINK_CH_CTL) {
+	link_control(l, l->rx_frame + LINK_HDR, len - LINK_HDR);
+	return 0;
+  }
+  f->chan = l->rx_frame[0];
+  f->seq = l->rx_frame[1];
+  f->data = l->rx_frame + LINK_HDR;
+  f->len = len - LINK_HDR;
+  return 1;
+}
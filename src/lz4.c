@@ -0,0 +1,96 @@
+/**
+ * @file lz4.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief LZ4 block decompression
+ *
+ * A block is a series of sequences:
+ * - token: literal length (high nibble), match length - 4 (low nibble);
+ *   15 means more length bytes follow (each added, until one != 255)
+ * - literals
+ * - match offset (16-bit little-endian, back from the output position)
+ *   and the match, absent in the last sequence
+ *
+ * Byte copies only: the stub calls this before the MMU allows unaligned
+ * accesses, and matches may overlap their own output (offset < length).
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "lz4.h"
+
+/**
+ * Read an extended length: add bytes while they are 255
+ * - Returns 0 if the block ends in the middle of it
+ */
+static int lz4_length(const u8 **src, const u8 *end, u32 *len) {
+  u8 b;
+
+  do {
+	if (*src >= end) {
+	  return 0;
+	}
+	b = *(*src)++;
+	*len += b;
+  } while (b == 255);
+  return 1;
+}
+
+/**
+ * Decompress
+ * - Literals: check they fit in both buffers, copy
+ * - The block may end right after the literals
+ * - Match: check the offset points into the output so far and the
+ *   length fits, copy forwards (so overlapping matches repeat)
+ */
+int lz4_decompress(const u8 *src, u32 src_len, u8 *dst, u32 dst_cap) {
+  const u8 *end = src + src_len;
+  u8 *out = dst;
+  u8 *out_end = dst + dst_cap;
+
+  while (src < end) {
+	u8 token = *src++;
+	u32 len = token >> 4;
+	const u8 *match;
+	u32 offset;
+
+	if (len == 15 && !lz4_length(&src, end, &len)) {
+	  return -1;
+	}
+	if (len > (u32)(end - src) || len > (u32)(out_end - out)) {
+	  return -1;
+	}
+	while (len--) {
+	  *out++ = *src++;
+	}
+
+	if (src == end) {
+	  break;
+	}
+
+	if (end - src < 2) {
+	  return -1;
+	}
+	offset = src[0] | (src[1] << 8);
+	src += 2;
+	if (offset == 0 || offset > (u32)(out - dst)) {
+	  return -1;
+	}
+
+	len = token & 0xF;
+	if (len == 15 && !lz4_length(&src, end, &len)) {
+	  return -1;
+	}
+	len += 4;
+	if (len > (u32)(out_end - out)) {
+	  return -1;
+	}
+	match = out - offset;
+	while (len--) {
+	  *out++ = *match++;
+	}
+  }
+
+  return out - dst;
+}
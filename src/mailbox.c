@@ -0,0 +1,192 @@
+/**
+ * @file mailbox.c
+ * @author Jose Pires
+ * @date 2024-10-07
+ *
+ * @brief VideoCore mailbox property interface implementation
+ *
+ * It follows the documentation:
+ * - BCM2835 ARM peripherals (ARM to VC mailbox)
+ * - raspberrypi/firmware wiki: Mailbox property interface
+ *
+ * The message buffer is shared, so only one core may talk to the
+ * firmware at a time.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "mailbox.h"
+#include "cache.h"
+#include "common.h"
+#include "dma.h"
+#include "peripherals/mailbox.h"
+#include "sections.h"
+
+/**< Largest message we build is 144 bytes: 3 whole cache lines */
+#define MBOX_BUF_WORDS (3 * L1_CACHE_BYTES / 4)
+#define MBOX_TAG_HDR_WORDS 5 /**< size, code, tag id, value size, tag code */
+
+/**< The lower 4 bits of the address carry the channel: 16-byte aligned.
+     Line aligned too, so cache maintenance touches nothing else. */
+static volatile u32 __attribute__((aligned(L1_CACHE_BYTES)))
+  mbox_buf[MBOX_BUF_WORDS];
+
+/**
+ * Write a message to the VideoCore
+ * - Wait while mailbox 1 (ARM -> VC) is full
+ * - Write the buffer address with the channel in the lower 4 bits
+ */
+static void mbox_write(u8 ch, u32 data) {
+  while (REGS_MBOX->write_status & MBOX_STATUS_FULL) {
+	;
+  }
+  REGS_MBOX->write = (data & ~0xFU) | (ch & 0xF);
+}
+
+/**
+ * Read a message from the VideoCore
+ * - Wait while mailbox 0 (VC -> ARM) is empty
+ * - Discard messages addressed to other channels
+ */
+static u32 mbox_read(u8 ch) {
+  u32 data;
+
+  do {
+	while (REGS_MBOX->status & MBOX_STATUS_EMPTY) {
+	  ;
+	}
+	data = REGS_MBOX->read;
+  } while ((data & 0xF) != ch);
+
+  return data & ~0xFU;
+}
+
+/**
+ * Send a property buffer
+ * - Clean it, so the VC reads what we wrote and not stale memory
+ * - Post its bus address on the property channel and wait for our
+ *   buffer to come back
+ * - Invalidate it, so we read the response and not stale lines
+ * - The firmware sets the response code in buf[1]
+ */
+int mbox_property(volatile u32 *buf) {
+  u32 addr = dma_bus_addr(buf);
+  u32 size = buf[0];
+
+  dcache_clean_range((const void *)buf, size);
+  mbox_write(MBOX_CH_PROP, addr);
+
+  while (mbox_read(MBOX_CH_PROP) != addr) {
+	;
+  }
+  dcache_invalidate_range((const void *)buf, size);
+
+  return buf[1] == MBOX_RESPONSE;
+}
+
+/**
+ * Run a request with a single tag
+ * - Build: size, request code, tag, value size, tag code, values, end tag
+ * - vals holds n request words and is overwritten with the response
+ * - The tag code has bit 31 set by the firmware when it was handled
+ */
+static int mbox_tag(u32 tag, u32 *vals, u32 n) {
+  u32 i;
+
+  mbox_buf[0] = (MBOX_TAG_HDR_WORDS + n + 1) * 4;
+  mbox_buf[1] = MBOX_REQUEST;
+  mbox_buf[2] = tag;
+  mbox_buf[3] = n * 4;
+  mbox_buf[4] = MBOX_REQUEST;
+  for (i = 0; i < n; i++) {
+	mbox_buf[MBOX_TAG_HDR_WORDS + i] = vals[i];
+  }
+  mbox_buf[MBOX_TAG_HDR_WORDS + n] = MBOX_TAG_LAST;
+
+  if (!mbox_property(mbox_buf) || !(mbox_buf[4] & MBOX_RESPONSE)) {
+	return 0;
+  }
+
+  for (i = 0; i < n; i++) {
+	vals[i] = mbox_buf[MBOX_TAG_HDR_WORDS + i];
+  }
+  return 1;
+}
+
+/**
+ * Clock rate getters share the same layout: (clock id) -> (clock id, rate)
+ */
+static u32 mbox_clock_query(u32 tag, MboxClock clk) {
+  u32 vals[2] = {clk, 0};
+
+  if (!mbox_tag(tag, vals, 2)) {
+	return 0;
+  }
+  return vals[1];
+}
+
+u32 mbox_get_clock_rate(MboxClock clk) {
+  return mbox_clock_query(MBOX_TAG_GET_CLOCK_RATE, clk);
+}
+
+u32 mbox_get_max_clock_rate(MboxClock clk) {
+  return mbox_clock_query(MBOX_TAG_GET_MAX_CLOCK_RATE, clk);
+}
+
+u32 mbox_get_min_clock_rate(MboxClock clk) {
+  return mbox_clock_query(MBOX_TAG_GET_MIN_CLOCK_RATE, clk);
+}
+
+/**
+ * Set a clock rate
+ * - (clock id, rate, skip turbo) -> (clock id, rate)
+ * - skip turbo = 0: let the firmware raise the voltage when needed
+ */
+u32 mbox_set_clock_rate(MboxClock clk, u32 hz) {
+  u32 vals[3] = {clk, hz, 0};
+
+  if (!mbox_tag(MBOX_TAG_SET_CLOCK_RATE, vals, 3)) {
+	return 0;
+  }
+  return vals[1];
+}
+
+u32 mbox_get_board_revision() {
+  u32 vals[1] = {0};
+
+  if (!mbox_tag(MBOX_TAG_GET_BOARD_REVISION, vals, 1)) {
+	return 0;
+  }
+  return vals[0];
+}
+
+int mbox_get_arm_memory(u32 *base, u32 *size) {
+  u32 vals[2] = {0, 0};
+
+  if (!mbox_tag(MBOX_TAG_GET_ARM_MEMORY, vals, 2)) {
+	return 0;
+  }
+  *base = vals[0];
+  *size = vals[1];
+  return 1;
+}
+
+/**
+ * Temperature getters share the same layout: (sensor id 0) -> (id, value)
+ */
+static u32 mbox_temp_query(u32 tag) {
+  u32 vals[2] = {0, 0};
+
+  if (!mbox_tag(tag, vals, 2)) {
+	return 0;
+  }
+  return vals[1];
+}
+
+u32 mbox_get_temperature() {
+  return mbox_temp_query(MBOX_TAG_GET_TEMPERATURE);
+}
+
+u32 mbox_get_max_temperature() {
+  return mbox_temp_query(MBOX_TAG_GET_MAX_TEMPERATURE);
+}
@@ -19,6 +19,13 @@
 #define TXD 14
 #define RXD 15
 
+/**
+ * IER bits as they really are (BCM2835 peripherals errata): bit 0
+ * enables the RX interrupt, and bits 3:2, documented as don't care,
+ * must be set for it to be raised
+ */
+#define MU_IER_RX ((1 << 0) | (3 << 2))
+
 /**
  * @brief Calculate Baudrate register value
  * @param sysclk: system clock frequency (in Hz) [in]
@@ -31,6 +38,19 @@ u32 static inline calc_br_reg(u32 sysclk, u32 baudrate){
   return (sysclk / ( 8 * baudrate ) - 1);
 };
 
+/**< VPU core clock feeding the Mini UART; firmware defaults per board */
+#if RPI_VERSION == 3
+static u32 uart_sysclk = 250000000;
+#else
+static u32 uart_sysclk = 500000000;
+#endif
+
+void uart_set_sysclk(u32 hz) {
+  if (hz != 0) {
+	uart_sysclk = hz;
+  }
+}
+
 
 /**
  * Initialize the UART
@@ -41,7 +61,7 @@ u32 static inline calc_br_reg(u32 sysclk, u32 baudrate){
  *   - disable the control to manipulate extra flags
  *   - Set the data size to 8-bits
  *   - Clear modem signals (RTS low)
- *   - Set the baudrate to 115200 bps
+ *   - Set the baudrate to 115200 bps, derived from the core clock
  *   - Send some characters over to fix boot messages
  */
 void uart_init(){
@@ -57,16 +77,9 @@ void uart_init(){
   REGS_AUX->mu_lcr = (1 << 0) | (1 << 1); // Why?
   REGS_AUX->mu_mcr = 0;
 
-
-#if RPI_VERSION == 3
-  //REGS_AUX->mu_baud_rate = 270;
-  REGS_AUX->mu_baud_rate = (reg32)calc_br_reg(250e6, 115200);
-#endif
-
-#if RPI_VERSION == 4
-  //REGS_AUX->mu_baud_rate = 541;
-  REGS_AUX->mu_baud_rate = (reg32) calc_br_reg(500e6, 115200);
-#endif
+  //REGS_AUX->mu_baud_rate = 270; (RPi 3, 250 MHz)
+  //REGS_AUX->mu_baud_rate = 541; (RPi 4, 500 MHz)
+  REGS_AUX->mu_baud_rate = (reg32) calc_br_reg(uart_sysclk, 115200);
 
   REGS_AUX->mu_control = (1 << 0) | (1 << 1); /**< Enable TX and RX */
 
@@ -103,6 +116,18 @@ char uart_recv(){
   return REGS_AUX->mu_io & 0xFF;
 }
 
+/**
+ * Check the receive side without blocking
+ * - LSR_REG bit 0 is set while the RX FIFO holds data
+ */
+int uart_can_recv() {
+  return REGS_AUX->mu_lsr & (1 << 0);
+}
+
+void uart_rx_irq(int on) {
+  REGS_AUX->mu_ier = on ? MU_IER_RX : 0;
+}
+
 /**
  * Send a string
  * - While the NUL terminator is not found
@@ -0,0 +1,52 @@
+/**
+ * @file mmu.c
+ * @author Jose Pires
+ * @date 2024-10-20
+ *
+ * @brief Kernel identity map (see mmu.h)
+ *
+ * VA == PA over the 32-bit address space:
+ * - First GiB: 2 MiB blocks, RAM Normal write-back (code, data, stacks,
+ *   the DTB and the initramfs), from PBASE up Device (RPi 3 peripherals)
+ * - Other GiBs: 1 GiB Device blocks (RPi 3 local peripherals at
+ *   0x40000000; RPi 4 peripherals and GIC from 0xFC000000). RAM the
+ *   RPi 4 has above the first GiB is Device too: the kernel keeps
+ *   nothing there
+ *
+ * Normal memory is what the exclusives (spinlocks, the __atomic
+ * builtins) need on the Cortex-A53/A72, and it lets code and data run
+ * from the caches. Memory shared with bus masters (mailbox, DMA) stays
+ * cacheable and is handed over with the cache.h maintenance.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "mmu.h"
+#include "peripherals/base.h"
+
+#define MMU_L1 0
+#define MMU_L2 1
+
+u64 __attribute__((aligned(PAGE_SIZE))) mmu_tables[MMU_NR_TABLES][MM_ENTRIES];
+
+/**
+ * Map
+ * - Level 2: the first GiB in 2 MiB blocks, Device from the peripheral
+ *   base up
+ * - Level 1: entry 0 -> level 2 table, the next GiBs Device blocks, the
+ *   rest unmapped (the BSS is zeroed)
+ */
+u64 mmu_map() {
+  u64 *l1 = mmu_tables[MMU_L1], *l2 = mmu_tables[MMU_L2];
+  u64 i, addr;
+
+  for (i = 0; i < MM_ENTRIES; i++) {
+	addr = i << MM_L2_SHIFT;
+	l2[i] = addr | (addr >= PBASE ? MMU_FLAGS_DEVICE : MMU_FLAGS_NORMAL);
+  }
+  l1[0] = (u64)l2 | MM_TYPE_TABLE;
+  for (i = 1; i < MMU_L1_USED; i++) {
+	l1[i] = (i << MM_L1_SHIFT) | MMU_FLAGS_DEVICE;
+  }
+  return (u64)l1;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file neon.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief FP/SIMD (NEON) accelerated routines implementation
+ *
+ * Written with GCC vector types rather than arm_neon.h intrinsics: the
+ * compiler picks the Q-register loads and stores, and the file still
+ * builds with the host tools.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "neon.h"
+
+typedef u8 u8x16 __attribute__((vector_size(16)));
+
+/**
+ * Copy
+ * - Aligned: 4 x 16-byte vectors per iteration (LDP/STP Q)
+ * - Tail, or unaligned buffers: bytes
+ */
+void neon_copy(void *dst, const void *src, u64 len) {
+  u8 *d = dst;
+  const u8 *s = src;
+  u8x16 v0, v1, v2, v3;
+
+  if ((((u64)d | (u64)s) & 15) == 0) {
+	for (; len >= 64; len -= 64, d += 64, s += 64) {
+	  v0 = ((const u8x16 *)s)[0];
+	  v1 = ((const u8x16 *)s)[1];
+	  v2 = ((const u8x16 *)s)[2];
+	  v3 = ((const u8x16 *)s)[3];
+	  ((u8x16 *)d)[0] = v0;
+	  ((u8x16 *)d)[1] = v1;
+	  ((u8x16 *)d)[2] = v2;
+	  ((u8x16 *)d)[3] = v3;
+	}
+  }
+  while (len--) {
+	*d++ = *s++;
+  }
+}
@@ -0,0 +1,48 @@
+/**
+ * @file percpu.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Per-CPU areas (see percpu.h)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "percpu.h"
+#include "sections.h"
+
+#define PERCPU_STR_(x) #x
+#define PERCPU_STR(x) PERCPU_STR_(x)
+
+u64 __per_cpu_offset[NR_CPUS];
+
+/**< Nr of copies linker.ld reserves after the BSS: NR_CPUS, as an
+   absolute symbol so the link cannot get out of step with smp.h */
+asm(".globl __nr_cpus\n\t.set __nr_cpus, " PERCPU_STR(NR_CPUS));
+
+/**
+ * Replicate the template
+ * - The copies are reserved by linker.ld after the BSS, each one a
+ *   multiple of a cache line (the section is padded)
+ * - Copy with 64-bit words: both ends are cache-line aligned
+ */
+void percpu_init() {
+  u64 size = __per_cpu_end - __per_cpu_start;
+  u32 core;
+  u64 i;
+
+  for (core = 0; core < NR_CPUS; core++) {
+	u64 *dst = (u64 *)(__per_cpu_areas + core * size);
+	const u64 *src = (const u64 *)__per_cpu_start;
+
+	for (i = 0; i < size / sizeof(u64); i++) {
+	  dst[i] = src[i];
+	}
+	__per_cpu_offset[core] = (u64)dst - (u64)__per_cpu_start;
+  }
+  percpu_init_cpu(0);
+}
+
+void percpu_init_cpu(u32 core) {
+  asm volatile("msr tpidr_el1, %0" :: "r"(__per_cpu_offset[core]) : "memory");
+}
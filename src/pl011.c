@@ -16,6 +16,18 @@
 #include "common.h"
 #include "gpio.h"
 #include "peripherals/pl011.h"
+#include "prof.h"
+
+#if defined(HOST_TEST)
+/* Host tests: the fake UART is never busy, and there is no counter */
+#define pl011_ticks() 0UL
+#define pl011_idle_ticks() 1UL
+#else
+#include "timer.h"
+#define pl011_ticks() timer_get_ticks()
+#define pl011_idle_ticks() \
+  ((u64)PL011_IDLE_TIMEOUT_US * timer_get_freq() / USEC_PER_SEC)
+#endif
 
 //const uart_gpio uart0_alt0 = {.tx = 14, .rx = 15, .func = GFAlt0};
 //const uart_gpio uart5_alt4 = {.tx = 12, .rx = 13, .func = GFAlt4};
@@ -47,10 +59,26 @@
 //  return &uart_instances[index];
 //}
 
+/**< UARTCLK in Hz; the firmware default until told otherwise */
+static u32 pl011_uartclk = PL011_FSYSCLK;
+
+void pl011_set_uartclk(u32 hz) {
+  if (hz != 0) {
+	pl011_uartclk = hz;
+  }
+}
+
+u32 pl011_get_uartclk() {
+  return pl011_uartclk;
+}
+
 /**
  * Set the baudrate register
- * - Check the baudrate is valid
- * - Disable the UART and wait until it is disabled, before we configure it
+ * - Check the baudrate is valid: BAUDDIV must be >= 1, so the maximum
+ *   baudrate is UARTCLK / 16 (3 Mbaud with the default 48 MHz)
+ * - Wait until the UART is idle (the char being sent and the TX FIFO
+ *   drained), then disable it before we configure it; give up, leaving
+ *   it as it is, if it does not drain in time (CTS held deasserted)
  * - Calculate the Baud rate divisor integer (IBRD) and fractional parts (FBRD)
  *   - BAUDDIV = FUARTCLK / (16 * Baud_rate)
  *   - IBRD = (int) BAUDDIV
@@ -58,47 +86,117 @@
  *     - n = FBDR_Width (6 bits)
  *
  *   ### Integer-arithmetic implementation
- * u64 brd_scaled = ( PL011_FSYSCLK * 4 + baudrate / 2 ) / baudrate;
+ * u64 brd_scaled = ( UARTCLK * 4 + baudrate / 2 ) / baudrate;
  * uart->regs->ibrd = (reg32)( brd_scaled / 64 );
  * uart->regs->fbrd = (reg32)( brd_scaled % 64 );
  */
-void pl011_set_br(pl011_uart *uart, u32 baudrate) {
- if (baudrate == 0) {
-        return;
+int pl011_set_br(pl011_uart *uart, u32 baudrate) {
+ if (baudrate == 0 || baudrate > pl011_uartclk / 16) {
+        return -1;
  }
 
-    /* Disable the UART first */
-    //uart->regs->cr &= ~(1 << PL011_UARTCR_UARTEN);
-    uart->regs->cr = 0;
-
-    /* Optionally wait until UART is disabled */
-    //while (uart->regs->fr & (1 << PL011_UARTFR_BUSY)) {
-    //    // Wait or implement a timeout
-	//  ;
-    //}
-
-    /* Flush the Transmit FIFO by setting FEN bit to 0 */
-    // uart->regs->lcrh &= ~(1 << PL011_UARTLCRH_FEN);
+  /* Let the transmitter drain, then disable the UART */
+  if (pl011_wait_idle(uart)) {
+	return -1;
+  }
+  uart->regs->cr = 0;
 
   /* Calculate BAUDDIV = FUARTCLK / (16 * Baud rate) */
   /* To calculate FBRD = round((BAUDDIV - IBRD) * 64) */
   /* BAUDDIV * 64 = (FUARTCLK * 4) / baudrate */
-  u64 brd_scaled = ( PL011_FSYSCLK * 4 + baudrate / 2 ) / baudrate; // Adding baudrate/2 for rounding
+  u64 brd_scaled = ( (u64)pl011_uartclk * 4 + baudrate / 2 ) / baudrate; // Adding baudrate/2 for rounding
 
   uart->regs->ibrd = (reg32)( brd_scaled / 64 );
   uart->regs->fbrd = (reg32)( brd_scaled % 64 );
   //uart->regs->ibrd = 26;
   //uart->regs->fbrd = 3;
+  return 0;
+}
+
+
+/**
+ * Wait for the transmitter
+ * - BUSY is set from the moment the TX FIFO becomes non-empty until
+ *   the last stop bit has left the shift register
+ * - With CTSEn set, a peer holding CTS deasserted keeps it set forever:
+ *   bounded by PL011_IDLE_TIMEOUT_US
+ */
+int pl011_wait_idle(pl011_uart *uart) {
+  u64 start = pl011_ticks();
+  u64 timeout = pl011_idle_ticks();
+
+  while (uart->regs->fr & (1 << PL011_UARTFR_BUSY)) {
+	if (pl011_ticks() - start >= timeout) {
+	  return -1;
+	}
+  }
+  return 0;
 }
 
+/**
+ * Change the baudrate of a running UART
+ * - pl011_set_br() drains the transmitter and disables the UART (or
+ *   fails, nothing changed, if it does not drain)
+ * - IBRD/FBRD only take effect on an LCRH write: write it back,
+ *   flushing the FIFOs on the way (FEN cleared, then restored)
+ * - Re-enable with the previous control bits
+ */
+int pl011_set_baud(pl011_uart *uart, u32 baudrate) {
+  u32 cr = uart->regs->cr;
+  u32 lcrh = uart->regs->lcrh;
+
+  if (baudrate == 0 || baudrate > pl011_uartclk / 16) {
+	return -1;
+  }
+  if (pl011_set_br(uart, baudrate)) {
+	return -1;
+  }
+  uart->regs->lcrh = lcrh & ~(1 << PL011_UARTLCRH_FEN);
+  uart->regs->lcrh = lcrh;
+  uart->regs->cr = cr;
+  return 0;
+}
+
+/**< Rates auto-baud snaps to */
+static const u32 pl011_std_rates[] = {
+  9600, 19200, 38400, 57600, 115200, 230400, 460800, 500000, 576000,
+  921600, 1000000, 1152000, 1500000, 2000000, 2500000, 3000000, 4000000,
+};
+
+/**
+ * Closest standard rate
+ * - Accept it if the measurement is within PL011_BAUD_TOLERANCE percent
+ *   (the UART itself tolerates a few percent of mismatch)
+ */
+u32 pl011_baud_match(u32 measured) {
+  u32 i, best = 0;
+  u32 best_diff = ~0U, diff;
+
+  for (i = 0; i < sizeof(pl011_std_rates) / sizeof(pl011_std_rates[0]); i++) {
+	u32 rate = pl011_std_rates[i];
+
+	diff = measured > rate ? measured - rate : rate - measured;
+	if (diff < best_diff) {
+	  best_diff = diff;
+	  best = rate;
+	}
+  }
+  if ((u64)best_diff * 100 > (u64)best * PL011_BAUD_TOLERANCE) {
+	return 0;
+  }
+  return best;
+}
 
 /**
  * Initialize the UART with a defined baudrate
  *  - Calculate the baudrate register
  *  - Set the Word length to 8-bits
+ *  - Mux CTS/RTS, if wired, and enable hardware flow control for them
  *  - Enable RX, TX and the UART
  */
 void pl011_init(pl011_uart *uart, u32 baudrate) {
+  u32 cr;
+
   gpio_pin_set_func(uart->gpio->tx, uart->gpio->func);
   gpio_pin_set_func(uart->gpio->rx, uart->gpio->func);
 
@@ -115,8 +213,19 @@ void pl011_init(pl011_uart *uart, u32 baudrate) {
   uart->regs->lcrh = (PL011_WLEN_8 << PL011_UARTLCRH_WLEN);
   //uart->regs->lcrh = 0x60;
 
-  uart->regs->cr = (1 << PL011_UARTCR_RXE) | (1 << PL011_UARTCR_TXE) |
-                   (1 << PL011_UARTCR_UARTEN);
+  cr = (1 << PL011_UARTCR_RXE) | (1 << PL011_UARTCR_TXE) |
+	(1 << PL011_UARTCR_UARTEN);
+  if (uart->gpio->cts) {
+	gpio_pin_set_func(uart->gpio->cts, uart->gpio->flow_func);
+	gpio_pin_enable(uart->gpio->cts);
+	cr |= 1 << PL011_UARTCR_CTSEN;
+  }
+  if (uart->gpio->rts) {
+	gpio_pin_set_func(uart->gpio->rts, uart->gpio->flow_func);
+	gpio_pin_enable(uart->gpio->rts);
+	cr |= 1 << PL011_UARTCR_RTSEN;
+  }
+  uart->regs->cr = cr;
   //uart->regs->cr = 0x301;
 }
 
@@ -126,6 +235,8 @@ void pl011_init(pl011_uart *uart, u32 baudrate) {
  * - Send a char to the Data Register
  */
 void pl011_send(pl011_uart *uart, char c){
+  PROF_SCOPE("pl011_send");
+
   while( uart->regs->fr & (1 << PL011_UARTFR_TXFF)){
           ;
   }
@@ -144,6 +255,14 @@ char pl011_recv(pl011_uart *uart) {
   return ((char)(uart->regs->dr & 0xFF));
 }
 
+/**
+ * Check the receive side without blocking
+ * - Data is available while the RX FIFO is not empty
+ */
+int pl011_can_recv(pl011_uart *uart) {
+  return !(uart->regs->fr & (1 << PL011_UARTFR_RXFE));
+}
+
 /**
  * Send a string over UART
  */
@@ -158,3 +277,47 @@ void pl011_send_string(pl011_uart *uart, char *str) {
   }
 
 }
+
+/**
+ * Refill the TX FIFO from a ring
+ * - Stop when the FIFO is full: with CTS flow control it also stays
+ *   full while the peer holds CTS off
+ */
+u32 pl011_tx_fill(pl011_uart *uart, struct ring *tx) {
+  u32 n = 0;
+  int c;
+
+  while (!(uart->regs->fr & (1 << PL011_UARTFR_TXFF))) {
+	c = ring_get(tx);
+	if (c < 0) {
+	  break;
+	}
+	uart->regs->dr = c;
+	n++;
+  }
+  return n;
+}
+
+/**
+ * Empty the RX FIFO into a ring
+ * - Stop when the ring is full, leaving the rest in the FIFO
+ */
+u32 pl011_rx_drain(pl011_uart *uart, struct ring *rx) {
+  u32 n = 0;
+
+  while (!ring_full(rx) && !(uart->regs->fr & (1 << PL011_UARTFR_RXFE))) {
+	ring_put(rx, uart->regs->dr & 0xFF);
+	n++;
+  }
+  return n;
+}
+
+void pl011_rx_irq(pl011_uart *uart, int on) {
+  u32 rx = (1 << PL011_INT_RX) | (1 << PL011_INT_RT);
+
+  if (on) {
+	uart->regs->imsc |= rx;
+  } else {
+	uart->regs->imsc &= ~rx;
+  }
+}
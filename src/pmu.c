@@ -0,0 +1,74 @@
+/**
+ * @file pmu.c
+ * @author Jose Pires
+ * @date 2024-10-11
+ *
+ * @brief Cortex-A72 Performance Monitors Unit (PMU) implementation
+ *
+ * It follows the documentation:
+ * - ARM Architecture Reference Manual ARMv8 (D7: Performance Monitors)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "pmu.h"
+
+/**
+ * Enable the PMU
+ * - Cycle counter filter: count at EL0/EL1 and EL2 (NSH)
+ * - Reset the counters, 64-bit cycle counter overflow, enable
+ * - Enable the cycle counter and every implemented event counter
+ */
+void pmu_init() {
+  u64 enable = (1UL << PMU_CYCLE_IDX) | ((1UL << pmu_num_counters()) - 1);
+
+  asm volatile("msr pmccfiltr_el0, %0" :: "r"((u64)PMU_FILTER_NSH));
+  asm volatile("msr pmcr_el0, %0" ::
+			   "r"((u64)(PMCR_E | PMCR_P | PMCR_C | PMCR_LC)));
+  asm volatile("msr pmcntenset_el0, %0" :: "r"(enable));
+  asm volatile("isb");
+}
+
+u32 pmu_num_counters() {
+  u64 pmcr;
+  u32 n;
+
+  asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+  n = (pmcr >> PMCR_N_SHIFT) & PMCR_N_MASK;
+
+  return n > PMU_MAX_COUNTERS ? PMU_MAX_COUNTERS : n;
+}
+
+/**
+ * Select an event
+ * - Select the counter through PMSELR_EL0, then program its type and
+ *   clear it through the PMXEV* views
+ */
+void pmu_set_event(u32 idx, u32 event) {
+  if (idx >= pmu_num_counters()) {
+	return;
+  }
+
+  asm volatile("msr pmselr_el0, %0" :: "r"((u64)idx));
+  asm volatile("isb");
+  asm volatile("msr pmxevtyper_el0, %0" ::
+			   "r"((u64)(PMU_FILTER_NSH | (event & 0xFFFF))));
+  asm volatile("msr pmxevcntr_el0, xzr");
+  asm volatile("isb");
+}
+
+const char *pmu_event_name(u32 event) {
+  switch (event) {
+  case PMU_EVT_L1I_CACHE_REFILL: return "l1i_miss";
+  case PMU_EVT_L1D_CACHE_REFILL: return "l1d_miss";
+  case PMU_EVT_L1D_CACHE:        return "l1d_access";
+  case PMU_EVT_INST_RETIRED:     return "inst";
+  case PMU_EVT_EXC_TAKEN:        return "exc";
+  case PMU_EVT_BR_MIS_PRED:      return "br_miss";
+  case PMU_EVT_CPU_CYCLES:       return "cycles";
+  case PMU_EVT_BR_PRED:          return "br_pred";
+  case PMU_EVT_L2D_CACHE:        return "l2d_access";
+  case PMU_EVT_L2D_CACHE_REFILL: return "l2d_miss";
+  default:                       return "?";
+  }
+}
@@ -15,10 +15,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
 #include "printf.h"
+#include "percpu.h"
+#include "prof.h"
+#include "sections.h"
 
 typedef void (*putcf) (void*,char);
-static putcf stdout_putf;
-static void* stdout_putp;
+/* Per core: each core reads its own copy, and can be given its own output */
+static DEFINE_PER_CPU(putcf, stdout_putf);
+static DEFINE_PER_CPU(void*, stdout_putp);
+static DEFINE_PER_CPU(vprintf_t, stdout_vprintf);
 
 
 #ifdef PRINTF_LONG_SUPPORT
@@ -26,7 +31,7 @@ static void* stdout_putp;
 static void uli2a(unsigned long int num, unsigned int base, int uc,char * bf)
     {
     int n=0;
-    unsigned int d=1;
+    unsigned long int d=1;
     while (num/d >= base)
         d*=base;
     while (d!=0) {
@@ -105,7 +110,28 @@ static char a2i(char ch, char** src,int base,int* nump)
     return ch;
     }
 
-static void putchw(void* putp,putcf putf,int n, char z, char* bf)
+/* Output of one format run: a putf callback, or a bounded buffer
+   written directly (putf NULL). len counts every char produced, stored
+   or not, so a bounded run returns the length it would have needed. */
+struct fmt_out
+    {
+    putcf putf;
+    void* putp;
+    char* buf;
+    char* end;
+    unsigned int len;
+    };
+
+static inline void outc(struct fmt_out* o, char c)
+    {
+    if (o->putf)
+        o->putf(o->putp,c);
+    else if (o->buf < o->end)
+        *o->buf++ = c;
+    o->len++;
+    }
+
+static void putchw(struct fmt_out* o,int n, char z, char* bf)
     {
     char fc=z? '0' : ' ';
     char ch;
@@ -113,21 +139,26 @@ static void putchw(void* putp,putcf putf,int n, char z, char* bf)
     while (*p++ && n > 0)
         n--;
     while (n-- > 0)
-        putf(putp,fc);
+        outc(o,fc);
     while ((ch= *bf++))
-        putf(putp,ch);
+        outc(o,ch);
     }
 
-void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
+static __hot void format(struct fmt_out* o,char *fmt, va_list va)
     {
+    PROF_SCOPE("tfp_format");
+#ifdef PRINTF_LONG_SUPPORT
+    char bf[24];
+#else
     char bf[12];
+#endif
 
     char ch;
 
 
     while ((ch=*(fmt++))) {
         if (ch!='%')
-            putf(putp,ch);
+            outc(o,ch);
         else {
             char lz=0;
 #ifdef  PRINTF_LONG_SUPPORT
@@ -158,7 +189,7 @@ void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
                     else
 #endif
                     ui2a(va_arg(va, unsigned int),10,0,bf);
-                    putchw(putp,putf,w,lz,bf);
+                    putchw(o,w,lz,bf);
                     break;
                     }
                 case 'd' :  {
@@ -168,7 +199,7 @@ void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
                     else
 #endif
                     i2a(va_arg(va, int),bf);
-                    putchw(putp,putf,w,lz,bf);
+                    putchw(o,w,lz,bf);
                     break;
                     }
                 case 'x': case 'X' :
@@ -178,16 +209,16 @@ void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
                     else
 #endif
                     ui2a(va_arg(va, unsigned int),16,(ch=='X'),bf);
-                    putchw(putp,putf,w,lz,bf);
+                    putchw(o,w,lz,bf);
                     break;
                 case 'c' :
-                    putf(putp,(char)(va_arg(va, int)));
+                    outc(o,(char)(va_arg(va, int)));
                     break;
                 case 's' :
-                    putchw(putp,putf,w,0,va_arg(va, char*));
+                    putchw(o,w,0,va_arg(va, char*));
                     break;
                 case '%' :
-                    putf(putp,ch);
+                    outc(o,ch);
                 default:
                     break;
                 }
@@ -196,33 +227,67 @@ void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
     abort:;
     }
 
+void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
+    {
+    struct fmt_out o = {.putf=putf, .putp=putp};
+    format(&o,fmt,va);
+    }
 
-void init_printf(void* putp,void (*putf) (void*,char))
+int tfp_vsnprintf(char* s,unsigned int n,char *fmt, va_list va)
     {
-    stdout_putf=putf;
-    stdout_putp=putp;
+    struct fmt_out o = {.buf=s, .end=n ? s+n-1 : s};
+    format(&o,fmt,va);
+    if (n)
+        *o.buf = 0;
+    return o.len;
     }
 
-void tfp_printf(char *fmt, ...)
+int tfp_snprintf(char* s,unsigned int n,char *fmt, ...)
     {
     va_list va;
+    int len;
     va_start(va,fmt);
-    tfp_format(stdout_putp,stdout_putf,fmt,va);
+    len=tfp_vsnprintf(s,n,fmt,va);
     va_end(va);
+    return len;
     }
 
-static void putcp(void* p,char c)
+
+void init_printf(void* putp,void (*putf) (void*,char))
     {
-    *(*((char**)p))++ = c;
+    unsigned int cpu;
+    for (cpu=0; cpu<NR_CPUS; cpu++) {
+        per_cpu(stdout_putf,cpu)=putf;
+        per_cpu(stdout_putp,cpu)=putp;
+        per_cpu(stdout_vprintf,cpu)=0;
+        }
     }
 
+void init_vprintf(vprintf_t vpf)
+    {
+    unsigned int cpu;
+    for (cpu=0; cpu<NR_CPUS; cpu++)
+        per_cpu(stdout_vprintf,cpu)=vpf;
+    }
 
+void tfp_printf(char *fmt, ...)
+    {
+    va_list va;
+    vprintf_t vpf=this_cpu_read(stdout_vprintf);
+    va_start(va,fmt);
+    if (vpf)
+        vpf(fmt,va);
+    else
+        tfp_format(this_cpu_read(stdout_putp),this_cpu_read(stdout_putf),fmt,va);
+    va_end(va);
+    }
 
 void tfp_sprintf(char* s,char *fmt, ...)
     {
+    struct fmt_out o = {.buf=s, .end=(char*)~0UL};
     va_list va;
     va_start(va,fmt);
-    tfp_format(&s,putcp,fmt,va);
-    putcp(&s,0);
+    format(&o,fmt,va);
+    *o.buf = 0;
     va_end(va);
     }
@@ -0,0 +1,103 @@
+/**
+ * @file prof.c
+ * @author Jose Pires
+ * @date 2024-10-11
+ *
+ * @brief Hot-path profiling over the PMU
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "prof.h"
+#include "pmu.h"
+#include "printf.h"
+#include "shell.h"
+
+/**< Bounds of the .prof_sites section (see linker.ld) */
+extern struct prof_site __prof_sites_start[];
+extern struct prof_site __prof_sites_end[];
+
+/**< Event programmed in each profiler slot */
+static u32 prof_events[PROF_NR_EVENTS] = {
+  PMU_EVT_INST_RETIRED,
+  PMU_EVT_L1D_CACHE_REFILL,
+  PMU_EVT_BR_MIS_PRED,
+  PMU_EVT_L2D_CACHE_REFILL,
+};
+
+void prof_init() {
+  u32 i;
+
+  pmu_init();
+  for (i = 0; i < PROF_NR_EVENTS; i++) {
+	pmu_set_event(i, prof_events[i]);
+  }
+}
+
+void prof_set_event(u32 slot, u32 event) {
+  if (slot >= PROF_NR_EVENTS) {
+	return;
+  }
+  prof_events[slot] = event;
+  pmu_set_event(slot, event);
+  prof_reset();
+}
+
+void prof_reset() {
+  struct prof_site *site;
+  u32 i;
+
+  for (site = __prof_sites_start; site < __prof_sites_end; site++) {
+	site->calls = site->total = site->max = 0;
+	site->min = ~0UL;
+	for (i = 0; i < PROF_NR_EVENTS; i++) {
+	  site->events[i] = 0;
+	}
+  }
+}
+
+/**
+ * Dump the stats
+ * - Header with the event names of each slot
+ * - Skip sites that never ran
+ */
+void prof_dump() {
+  struct prof_site *site = __prof_sites_start;
+  struct prof_site *end = __prof_sites_end;
+  u32 i;
+
+  if (site == end) {
+	printf("prof: no sites (build with PROFILE=y)\n");
+	return;
+  }
+
+  printf("prof: %16s %10s %10s %10s %10s", "site", "calls", "min", "avg",
+		 "max");
+  for (i = 0; i < PROF_NR_EVENTS; i++) {
+	printf(" %10s", pmu_event_name(prof_events[i]));
+  }
+  printf("\n");
+
+  for (; site < end; site++) {
+	if (site->calls == 0) {
+	  continue;
+	}
+	printf("prof: %16s %10lu %10lu %10lu %10lu", site->name, site->calls,
+		   site->min, site->total / site->calls, site->max);
+	for (i = 0; i < PROF_NR_EVENTS; i++) {
+	  printf(" %10lu", site->events[i] / site->calls);
+	}
+	printf("\n");
+  }
+}
+
+SHELL_CMD(prof, "[reset]", "dump (or clear) the profiling stats") {
+  if (argc == 1) {
+	prof_dump();
+  } else if (argc == 2 && shell_streq(argv[1], "reset")) {
+	prof_reset();
+  } else {
+	return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,286 @@
+/**
+ * @file serial.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Interrupt-driven buffered PL011 implementation
+ *
+ * Any core may print, and the interrupt (routed to core 0) also
+ * consumes the TX ring, so the TX side and every IMSC update go under
+ * one IRQ-safe spinlock. The RX ring has a single consumer (the console
+ * work) and a single producer (the interrupt) and needs no lock.
+ *
+ * The TX interrupt fires when the FIFO drains through its level, not
+ * while it sits below it, so output is always started by filling the
+ * FIFO directly; the interrupt then keeps it going.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "serial.h"
+#include "irq.h"
+#include "printf.h"
+#include "shell.h"
+#include "spinlock.h"
+#include "timer.h"
+
+#define SERIAL_INT_RX ((1 << PL011_INT_RX) | (1 << PL011_INT_RT))
+#define SERIAL_INT_TX (1 << PL011_INT_TX)
+
+/**< RX interrupt at 1/2 full, TX interrupt at 1/8 full */
+#define SERIAL_IFLS ((2 << PL011_UARTIFLS_RXIFLSEL) | (0 << PL011_UARTIFLS_TXIFLSEL))
+
+static u8 tx_buf[SERIAL_TX_SIZE];
+static u8 rx_buf[SERIAL_RX_SIZE];
+static struct ring tx_ring = RING_INIT(tx_buf);
+static struct ring rx_ring = RING_INIT(rx_buf);
+
+static struct {
+  pl011_uart *uart;
+  spinlock_t lock;
+  u32 imsc;         /**< Shadow of the interrupt mask */
+  u32 paused;
+  u32 rx_throttled;
+  u32 tx_stalls;
+  struct work *rx_work; /**< Queued when chars arrive */
+} ser = {.lock = SPINLOCK_INIT};
+
+static void serial_set_imsc(u32 imsc) {
+  if (ser.paused) {
+	imsc = 0;
+  }
+  if (imsc != ser.imsc) {
+	ser.imsc = imsc;
+	ser.uart->regs->imsc = imsc;
+  }
+}
+
+/**
+ * Move what fits to the FIFO; keep the TX interrupt on while the ring
+ * still has data (lock held)
+ */
+static void serial_tx_pump() {
+  pl011_tx_fill(ser.uart, &tx_ring);
+  if (ring_empty(&tx_ring)) {
+	serial_set_imsc(ser.imsc & ~SERIAL_INT_TX);
+  } else {
+	serial_set_imsc(ser.imsc | SERIAL_INT_TX);
+  }
+}
+
+/**
+ * UART interrupt
+ * - RX: drain the FIFO; if the ring is full, mask RX so the FIFO fills
+ *   and RTS holds the sender (serial_getc() unmasks); queue the reader
+ * - TX: refill the FIFO
+ */
+static void serial_irq(void *arg, struct pt_regs *regs) {
+  pl011_uart *uart = ser.uart;
+  u32 mis = uart->regs->mis;
+
+  spin_lock(&ser.lock);
+  if (mis & SERIAL_INT_RX) {
+	pl011_rx_drain(uart, &rx_ring);
+	if (ring_full(&rx_ring)) {
+	  serial_set_imsc(ser.imsc & ~SERIAL_INT_RX);
+	  ser.rx_throttled++;
+	}
+	uart->regs->icr = SERIAL_INT_RX;
+	if (ser.rx_work) {
+	  work_queue(ser.rx_work);
+	}
+  }
+  if (mis & SERIAL_INT_TX) {
+	serial_tx_pump();
+  }
+  spin_unlock(&ser.lock);
+}
+
+/**
+ * Take over a UART
+ * - FIFOs on (LCRH may only change with the UART disabled)
+ * - Interrupt levels; RX interrupts on, TX on demand
+ */
+void serial_init(pl011_uart *uart) {
+  u32 cr;
+
+  pl011_wait_idle(uart);
+  cr = uart->regs->cr;
+  uart->regs->cr = 0;
+  uart->regs->lcrh |= 1 << PL011_UARTLCRH_FEN;
+  uart->regs->ifls = SERIAL_IFLS;
+  uart->regs->icr = 0x7FF;
+  uart->regs->cr = cr;
+
+  ser.uart = uart;
+  ser.imsc = ~0U;
+  serial_set_imsc(SERIAL_INT_RX);
+
+  irq_register(IRQ_UART, serial_irq, NULL);
+  irq_enable(IRQ_UART);
+}
+
+int serial_active() {
+  return ser.uart != NULL;
+}
+
+/**
+ * Queue a char
+ * - Full ring: pump by polling, so output makes progress with IRQs
+ *   masked too (and waits for as long as CTS holds it)
+ */
+void serial_putc(void *p, char c) {
+  u64 flags;
+
+  if (c == '\n') {
+	serial_putc(p, '\r');
+  }
+  flags = spin_lock_irqsave(&ser.lock);
+  while (ring_put(&tx_ring, c)) {
+	ser.tx_stalls++;
+	pl011_tx_fill(ser.uart, &tx_ring);
+  }
+  serial_tx_pump();
+  spin_unlock_irqrestore(&ser.lock, flags);
+}
+
+/**
+ * Format into the ring
+ * - Reserve the contiguous free space and format straight into it
+ * - If it fits with room for a CR per LF, add the CRs from the end
+ *   backwards and commit
+ * - Otherwise nothing was committed: format again char by char, which
+ *   waits for room
+ */
+void serial_vprintf(char *fmt, va_list va) {
+  va_list va_ring;
+  u64 flags;
+  u32 avail, len = 0, lf = 0, i, j;
+  u8 *p;
+
+  va_copy(va_ring, va);
+  flags = spin_lock_irqsave(&ser.lock);
+  p = ring_reserve(&tx_ring, &avail);
+  if (avail) {
+	len = vsnprintf((char *)p, avail, fmt, va_ring);
+	for (i = 0; i < len && len < avail; i++) {
+	  lf += p[i] == '\n';
+	}
+  }
+  if (avail && len + lf < avail) {
+	for (i = len, j = len + lf; i > 0 && j > i;) {
+	  p[--j] = p[--i];
+	  if (p[i] == '\n') {
+		p[--j] = '\r';
+	  }
+	}
+	ring_commit(&tx_ring, len + lf);
+	serial_tx_pump();
+	spin_unlock_irqrestore(&ser.lock, flags);
+  } else {
+	spin_unlock_irqrestore(&ser.lock, flags);
+	tfp_format(NULL, serial_putc, fmt, va);
+  }
+  va_end(va_ring);
+}
+
+u32 serial_write(const void *buf, u32 len) {
+  u64 flags = spin_lock_irqsave(&ser.lock);
+
+  len = ring_write(&tx_ring, buf, len);
+  serial_tx_pump();
+  spin_unlock_irqrestore(&ser.lock, flags);
+  return len;
+}
+
+/**
+ * Take a char; if RX was throttled, drain the FIFO into the room just
+ * made and unmask RX once the ring has space again
+ */
+int serial_getc() {
+  int c = ring_get(&rx_ring);
+  u64 flags;
+
+  if (!(ser.imsc & SERIAL_INT_RX) && !ser.paused) {
+	flags = spin_lock_irqsave(&ser.lock);
+	pl011_rx_drain(ser.uart, &rx_ring);
+	if (!ring_full(&rx_ring)) {
+	  serial_set_imsc(ser.imsc | SERIAL_INT_RX);
+	}
+	spin_unlock_irqrestore(&ser.lock, flags);
+  }
+  return c;
+}
+
+/**
+ * Flush
+ * - Pump the ring into the TX FIFO until it is empty; the deadline is
+ *   reset whenever the ring shrinks, so only a stalled transmitter
+ *   (CTS held deasserted) times out, not a long queue at a low rate
+ * - Then wait for the FIFO and shift register (pl011_wait_idle())
+ */
+int serial_flush() {
+  u64 timeout = timer_us_to_ticks(PL011_IDLE_TIMEOUT_US);
+  u64 start = timer_get_ticks();
+  u32 left = ring_count(&tx_ring);
+  u64 flags;
+
+  while (!ring_empty(&tx_ring)) {
+	flags = spin_lock_irqsave(&ser.lock);
+	serial_tx_pump();
+	spin_unlock_irqrestore(&ser.lock, flags);
+	if (ring_count(&tx_ring) < left) {
+	  left = ring_count(&tx_ring);
+	  start = timer_get_ticks();
+	} else if (timer_get_ticks() - start >= timeout) {
+	  return -1;
+	}
+  }
+  return pl011_wait_idle(ser.uart);
+}
+
+int serial_pause() {
+  u64 flags;
+  int ret;
+
+  ret = serial_flush();
+  flags = spin_lock_irqsave(&ser.lock);
+  serial_set_imsc(0);
+  ser.paused = 1;
+  spin_unlock_irqrestore(&ser.lock, flags);
+  return ret;
+}
+
+void serial_resume() {
+  u64 flags = spin_lock_irqsave(&ser.lock);
+
+  ser.paused = 0;
+  serial_set_imsc(SERIAL_INT_RX);
+  serial_tx_pump();
+  spin_unlock_irqrestore(&ser.lock, flags);
+}
+
+void serial_set_rx_work(struct work *w) {
+  ser.rx_work = w;
+}
+
+u32 serial_rx_throttled() {
+  return ser.rx_throttled;
+}
+
+u32 serial_tx_stalls() {
+  return ser.tx_stalls;
+}
+
+SHELL_CMD(serial, "", "buffered console state and flow control stats") {
+  if (!serial_active()) {
+	printf("serial: not in use (build with CONSOLE_FLOW=y)\n");
+	return 0;
+  }
+  printf("serial: cts %s, rts %s, tx %u/%u, rx %u/%u, rx throttled %u, "
+		 "tx stalls %u\n",
+		 ser.uart->gpio->cts ? "on" : "off", ser.uart->gpio->rts ? "on" : "off",
+		 ring_count(&tx_ring), SERIAL_TX_SIZE, ring_count(&rx_ring),
+		 SERIAL_RX_SIZE, ser.rx_throttled, ser.tx_stalls);
+  return 0;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file shell.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Console shell implementation
+ *
+ * The editor keeps the line NUL-terminated at all times and redraws
+ * with VT100 sequences (any serial terminal: screen, minicom, picocom,
+ * scripts/uart_boot.py --console). The history is a ring of
+ * SHELL_HISTORY lines; Up/Down browse it from the newest.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "shell.h"
+#include "printf.h"
+
+#if defined(HOST_TEST)
+extern const struct shell_cmd __start_shell_cmds[];
+extern const struct shell_cmd __stop_shell_cmds[];
+#define __shell_cmds_start __start_shell_cmds
+#define __shell_cmds_end __stop_shell_cmds
+#else
+/**< Bounds of the .shell_cmds section (see linker.ld) */
+extern const struct shell_cmd __shell_cmds_start[];
+extern const struct shell_cmd __shell_cmds_end[];
+#endif
+
+#define KEY_CTRL(c) ((c) & 0x1F)
+#define KEY_ESC 0x1B
+#define KEY_DEL 0x7F
+
+/**
+ * @brief Escape sequence decoder state
+ */
+enum shell_esc {
+  ESC_NONE,
+  ESC_START, /**< ESC received */
+  ESC_CSI,   /**< ESC [ or ESC O received */
+  ESC_PARAM, /**< ESC [ <digit> received, waiting for ~ */
+};
+
+static struct {
+  char line[SHELL_LINE_MAX];
+  u32 len;  /**< Chars in line */
+  u32 cur;  /**< Cursor position (0..len) */
+  char hist[SHELL_HISTORY][SHELL_LINE_MAX];
+  u32 hist_n;   /**< Lines ever added (the newest is hist_n - 1) */
+  u32 hist_pos; /**< Lines back from the edited one (0: not browsing) */
+  enum shell_esc esc;
+  char esc_param;
+  char last; /**< Previous char (swallows the LF of a CR LF) */
+  pl011_uart *uart;
+} sh;
+
+int shell_streq(const char *a, const char *b) {
+  while (*a && *a == *b) {
+	a++;
+	b++;
+  }
+  return *a == *b;
+}
+
+static u32 shell_strcpy(char *dst, const char *src) {
+  u32 n = 0;
+
+  while (src[n]) {
+	dst[n] = src[n];
+	n++;
+  }
+  dst[n] = 0;
+  return n;
+}
+
+pl011_uart *shell_console() {
+  return sh.uart;
+}
+
+const struct shell_cmd *shell_find(const char *name) {
+  const struct shell_cmd *cmd;
+
+  for (cmd = __shell_cmds_start; cmd < __shell_cmds_end; cmd++) {
+	if (shell_streq(name, cmd->name)) {
+	  return cmd;
+	}
+  }
+  return NULL;
+}
+
+int shell_parse_u64(const char *s, u64 *val) {
+  u64 v = 0;
+  u32 base = 10, digit;
+
+  if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+	base = 16;
+	s += 2;
+  }
+  if (!*s) {
+	return -1;
+  }
+  for (; *s; s++) {
+	if (*s >= '0' && *s <= '9') {
+	  digit = *s - '0';
+	} else if (base == 16 && *s >= 'a' && *s <= 'f') {
+	  digit = *s - 'a' + 10;
+	} else if (base == 16 && *s >= 'A' && *s <= 'F') {
+	  digit = *s - 'A' + 10;
+	} else {
+	  return -1;
+	}
+	v = v * base + digit;
+  }
+  *val = v;
+  return 0;
+}
+
+/**
+ * Split and run
+ * - Arguments are separated by spaces; the separators become NULs
+ * - A usage error (-1 from the command) prints the synopsis
+ */
+int shell_exec(char *line) {
+  char *argv[SHELL_MAX_ARGS];
+  const struct shell_cmd *cmd;
+  int argc = 0, ret;
+
+  while (*line) {
+	while (*line == ' ') {
+	  *line++ = 0;
+	}
+	if (!*line) {
+	  break;
+	}
+	if (argc == SHELL_MAX_ARGS) {
+	  printf("too many arguments (max %u)\n", SHELL_MAX_ARGS - 1);
+	  return -1;
+	}
+	argv[argc++] = line;
+	while (*line && *line != ' ') {
+	  line++;
+	}
+  }
+  if (argc == 0) {
+	return 0;
+  }
+
+  cmd = shell_find(argv[0]);
+  if (!cmd) {
+	printf("%s: unknown command (try help)\n", argv[0]);
+	return -1;
+  }
+  ret = cmd->fn(argc, argv);
+  if (ret == -1) {
+	printf("usage: %s %s\n", cmd->name, cmd->args);
+  }
+  return ret;
+}
+
+/**
+ * Redraw from the cursor to the end of the line, erase what is left of
+ * the old line and put the cursor back
+ */
+static void shell_redraw_tail() {
+  printf("%s\x1b[K", &sh.line[sh.cur]);
+  if (sh.len > sh.cur) {
+	printf("\x1b[%uD", sh.len - sh.cur);
+  }
+}
+
+static void shell_move(u32 pos) {
+  if (pos < sh.cur) {
+	printf("\x1b[%uD", sh.cur - pos);
+  } else if (pos > sh.cur) {
+	printf("\x1b[%uC", pos - sh.cur);
+  }
+  sh.cur = pos;
+}
+
+/**
+ * Replace the whole line (history), cursor at the end
+ */
+static void shell_set_line(const char *s) {
+  shell_move(0);
+  sh.len = shell_strcpy(sh.line, s);
+  printf("%s\x1b[K", sh.line);
+  sh.cur = sh.len;
+}
+
+static void shell_reset_line() {
+  sh.line[0] = 0;
+  sh.len = 0;
+  sh.cur = 0;
+  sh.hist_pos = 0;
+}
+
+static void shell_insert(char c) {
+  u32 i;
+
+  if (sh.len >= SHELL_LINE_MAX - 1) {
+	return;
+  }
+  for (i = sh.len; i > sh.cur; i--) {
+	sh.line[i] = sh.line[i - 1];
+  }
+  sh.line[sh.cur] = c;
+  sh.line[++sh.len] = 0;
+  printf("%c", c);
+  sh.cur++;
+  if (sh.cur < sh.len) {
+	shell_redraw_tail();
+  }
+}
+
+/**
+ * Delete the char at pos (the one under the cursor, or before it for
+ * a backspace), then redraw the tail
+ */
+static void shell_delete(u32 pos) {
+  u32 i;
+
+  if (pos >= sh.len) {
+	return;
+  }
+  for (i = pos; i < sh.len; i++) {
+	sh.line[i] = sh.line[i + 1];
+  }
+  sh.len--;
+  if (pos < sh.cur) {
+	sh.cur--;
+	printf("\b");
+  }
+  shell_redraw_tail();
+}
+
+/**
+ * Browse the history
+ * - back > 0 goes to older lines, back < 0 to newer ones
+ * - Going past the newest line gives an empty line
+ */
+static void shell_history(int back) {
+  u32 avail = sh.hist_n < SHELL_HISTORY ? sh.hist_n : SHELL_HISTORY;
+  u32 pos = sh.hist_pos;
+
+  if (back > 0 && pos < avail) {
+	pos++;
+  } else if (back < 0 && pos > 0) {
+	pos--;
+  } else {
+	return;
+  }
+  sh.hist_pos = pos;
+  shell_set_line(pos ? sh.hist[(sh.hist_n - pos) % SHELL_HISTORY] : "");
+}
+
+/**
+ * Keep a line in the history, unless it is empty or repeats the newest
+ */
+static void shell_history_add() {
+  if (sh.len == 0 ||
+	  (sh.hist_n && shell_streq(sh.line, sh.hist[(sh.hist_n - 1) % SHELL_HISTORY]))) {
+	return;
+  }
+  shell_strcpy(sh.hist[sh.hist_n % SHELL_HISTORY], sh.line);
+  sh.hist_n++;
+}
+
+static void shell_enter() {
+  printf("\n");
+  shell_history_add();
+  shell_exec(sh.line);
+  shell_reset_line();
+  printf(SHELL_PROMPT);
+}
+
+/**
+ * Decode the VT100 keys: arrows (ESC [ A-D), Home/End (ESC [ H/F,
+ * ESC O H/F, ESC [ 1/7 ~, ESC [ 4/8 ~) and Delete (ESC [ 3 ~)
+ */
+static void shell_escape(char c) {
+  switch (sh.esc) {
+  case ESC_START:
+	sh.esc = (c == '[' || c == 'O') ? ESC_CSI : ESC_NONE;
+	return;
+  case ESC_CSI:
+	sh.esc = ESC_NONE;
+	if (c >= '0' && c <= '9') {
+	  sh.esc_param = c;
+	  sh.esc = ESC_PARAM;
+	} else if (c == 'A') {
+	  shell_history(1);
+	} else if (c == 'B') {
+	  shell_history(-1);
+	} else if (c == 'C' && sh.cur < sh.len) {
+	  shell_move(sh.cur + 1);
+	} else if (c == 'D' && sh.cur > 0) {
+	  shell_move(sh.cur - 1);
+	} else if (c == 'H') {
+	  shell_move(0);
+	} else if (c == 'F') {
+	  shell_move(sh.len);
+	}
+	return;
+  case ESC_PARAM:
+	sh.esc = ESC_NONE;
+	if (c != '~') {
+	  return;
+	}
+	if (sh.esc_param == '1' || sh.esc_param == '7') {
+	  shell_move(0);
+	} else if (sh.esc_param == '4' || sh.esc_param == '8') {
+	  shell_move(sh.len);
+	} else if (sh.esc_param == '3') {
+	  shell_delete(sh.cur);
+	}
+	return;
+  default:
+	sh.esc = ESC_NONE;
+  }
+}
+
+void shell_init(pl011_uart *uart) {
+  sh.uart = uart;
+  sh.esc = ESC_NONE;
+  sh.last = 0;
+  shell_reset_line();
+  printf("\n" SHELL_PROMPT);
+}
+
+/**
+ * Line editor
+ * - Escape sequences go to the decoder
+ * - CR or LF runs the line (the LF of a CR LF pair is dropped)
+ * - Control keys edit; printable chars are inserted at the cursor
+ */
+void shell_input(char c) {
+  char last = sh.last;
+
+  sh.last = c;
+  if (sh.esc != ESC_NONE) {
+	shell_escape(c);
+	return;
+  }
+
+  switch (c) {
+  case '\n':
+	if (last == '\r') {
+	  return;
+	}
+	/* fall through */
+  case '\r':
+	shell_enter();
+	break;
+  case KEY_ESC:
+	sh.esc = ESC_START;
+	break;
+  case KEY_DEL:
+  case '\b':
+	if (sh.cur > 0) {
+	  shell_delete(sh.cur - 1);
+	}
+	break;
+  case KEY_CTRL('A'):
+	shell_move(0);
+	break;
+  case KEY_CTRL('E'):
+	shell_move(sh.len);
+	break;
+  case KEY_CTRL('B'):
+	if (sh.cur > 0) {
+	  shell_move(sh.cur - 1);
+	}
+	break;
+  case KEY_CTRL('F'):
+	if (sh.cur < sh.len) {
+	  shell_move(sh.cur + 1);
+	}
+	break;
+  case KEY_CTRL('U'):
+	shell_set_line("");
+	break;
+  case KEY_CTRL('C'):
+	printf("^C\n" SHELL_PROMPT);
+	shell_reset_line();
+	break;
+  default:
+	if (c >= ' ' && c < KEY_DEL) {
+	  shell_insert(c);
+	}
+  }
+}
+
+/**
+ * help: list the commands, or show one
+ */
+SHELL_CMD(help, "[command]", "list the commands") {
+  const struct shell_cmd *cmd;
+
+  if (argc > 2) {
+	return -1;
+  }
+  for (cmd = __shell_cmds_start; cmd < __shell_cmds_end; cmd++) {
+	if (argc == 2 && !shell_streq(argv[1], cmd->name)) {
+	  continue;
+	}
+	printf("  %s %s\n      %s\n", cmd->name, cmd->args, cmd->help);
+  }
+  return 0;
+}
+
+/**
+ * peek: 32-bit reads (MMIO safe: one access per word, no caching in C)
+ */
+SHELL_CMD(peek, "<addr> [words]", "read 32-bit words (MMIO or RAM)") {
+  u64 addr, count = 1, i;
+
+  if (argc < 2 || argc > 3 || shell_parse_u64(argv[1], &addr) ||
+	  (argc == 3 && shell_parse_u64(argv[2], &count))) {
+	return -1;
+  }
+  if (addr & 3) {
+	printf("peek: address not word aligned\n");
+	return 1;
+  }
+  for (i = 0; i < count; i++) {
+	if (i % 4 == 0) {
+	  printf("%s%lx:", i ? "\n" : "", addr + 4 * i);
+	}
+	printf(" %08x", ((volatile u32 *)addr)[i]);
+  }
+  printf("\n");
+  return 0;
+}
+
+/**
+ * poke: one 32-bit write, then read back (registers may not keep it)
+ */
+SHELL_CMD(poke, "<addr> <value>", "write a 32-bit word (MMIO or RAM)") {
+  u64 addr, val;
+
+  if (argc != 3 || shell_parse_u64(argv[1], &addr) ||
+	  shell_parse_u64(argv[2], &val)) {
+	return -1;
+  }
+  if (addr & 3) {
+	printf("poke: address not word aligned\n");
+	return 1;
+  }
+  *(volatile u32 *)addr = (u32)val;
+  printf("%lx: %08x\n", addr, *(volatile u32 *)addr);
+  return 0;
+}
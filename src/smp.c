@@ -0,0 +1,286 @@
+/**
+ * @file smp.c
+ * @author Jose Pires
+ * @date 2024-10-16
+ *
+ * @brief Secondary core bring-up
+ *
+ * The firmware (armstub8) parks cores 1-3 polling a spin table at
+ * 0xD8 + 8 * core, and jumps to the address written there after an
+ * event (SEV). Once released, a core runs event_loop(): it sleeps in
+ * WFI until an IPI (a cross-core call, or a job posted with smp_run()
+ * as a work item) or one of its own timer events wakes it.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "smp.h"
+#include "cache.h"
+#include "event.h"
+#include "fpsimd.h"
+#include "irq.h"
+#include "percpu.h"
+#include "printf.h"
+#include "shell.h"
+#include "timer.h"
+#include "trace.h"
+
+#define SMP_BOOT_TIMEOUT_US 10000 /**< Time given to a core to come up */
+
+extern char secondary_entry[]; /**< boot.S */
+
+/**
+ * @brief Work slot of a core (one function at a time)
+ *
+ * One cache line each: the poster and the target core both write it,
+ * and neighbouring cores must not see those writes as contention
+ */
+struct smp_job {
+  struct work work; /**< Runs fn on the core's event loop */
+  smp_fn fn;
+  void *arg;
+  u32 pending; /**< 1 while fn is posted or running */
+} ____cacheline_aligned;
+
+static struct smp_job jobs[NR_CPUS];
+static u32 cpu_online[NR_CPUS];
+
+struct smp_msg {
+  smp_fn fn;
+  void *arg;
+};
+
+/**
+ * @brief Calls from one sender to one target
+ *
+ * head is written by the sender only, tail by the target only; each on
+ * its own cache line
+ */
+struct smp_queue {
+  u32 head ____cacheline_aligned;
+  u32 tail ____cacheline_aligned;
+  struct smp_msg msg[SMP_QUEUE_SIZE] ____cacheline_aligned;
+};
+
+/**
+ * @brief Doorbell state of a target: 1 from the IPI sent until its
+ * handler starts draining
+ */
+struct smp_doorbell {
+  u32 rung;
+} ____cacheline_aligned;
+
+static struct smp_queue smp_queues[NR_CPUS][NR_CPUS]; /**< [target][sender] */
+static struct smp_doorbell smp_doorbells[NR_CPUS];
+static DEFINE_PER_CPU(u64, smp_calls);
+static DEFINE_PER_CPU(u64, smp_ipis);
+
+/**
+ * IPI handler: run the queued calls
+ * - Acknowledge, then lower the doorbell before draining: a post that
+ *   finds it still up is drained below, a later one rings again
+ * - Drain every sender's queue in order, freeing each slot before the
+ *   call so the sender can reuse it
+ */
+static void smp_ipi(void *arg, struct pt_regs *regs) {
+  u32 core = smp_processor_id();
+  struct smp_queue *q;
+  struct smp_msg msg;
+  u32 src, tail;
+
+  irq_ack_ipi();
+  this_cpu_add(smp_ipis, 1);
+  __atomic_store_n(&smp_doorbells[core].rung, 0, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  for (src = 0; src < NR_CPUS; src++) {
+	q = &smp_queues[core][src];
+	tail = q->tail;
+	while (tail != __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+	  msg = q->msg[tail % SMP_QUEUE_SIZE];
+	  __atomic_store_n(&q->tail, ++tail, __ATOMIC_RELEASE);
+	  TRACE(SMP_START, src);
+	  msg.fn(msg.arg);
+	  TRACE(SMP_DONE, src);
+	  this_cpu_add(smp_calls, 1);
+	}
+  }
+}
+
+/**
+ * Job work: run it, then release the slot and wake the poster (waiting
+ * in smp_wait())
+ */
+static void smp_job_run(void *arg) {
+  struct smp_job *job = arg;
+
+  TRACE(SMP_START);
+  job->fn(job->arg);
+  TRACE(SMP_DONE);
+  __atomic_store_n(&job->pending, 0, __ATOMIC_RELEASE);
+  asm volatile("dsb sy\n\tsev" ::: "memory");
+}
+
+/**
+ * Wait for work
+ * - Point TPIDR_EL1 at our per-CPU copy, install the vectors, arm the
+ *   lazy FP/SIMD trap, start the event stream
+ * - Announce we are online
+ * - Run the event loop: asleep in WFI until something is queued
+ */
+void secondary_main(u32 core) {
+  percpu_init_cpu(core);
+  irq_init_cpu();
+  fpsimd_init_cpu();
+  timer_init_cpu();
+  irq_enable(IRQ_IPI);
+  __atomic_store_n(&cpu_online[core], 1, __ATOMIC_RELEASE);
+  asm volatile("sev");
+  irq_local_enable();
+
+  event_loop();
+}
+
+/**
+ * Release a core
+ * - Set up its job work item
+ * - Write the entry point in its spin table slot
+ * - Clean it to the point of coherency (the core polls with caches off)
+ * - Wake it up and wait for it to come online
+ */
+static void smp_boot_cpu(u32 core) {
+  volatile u64 *slot = (volatile u64 *)(u64)(SMP_SPIN_TABLE + 8 * core);
+  u64 start = timer_get_ticks();
+  u64 timeout = SMP_BOOT_TIMEOUT_US * timer_get_freq() / USEC_PER_SEC;
+
+  jobs[core].work.fn = smp_job_run;
+  jobs[core].work.arg = &jobs[core];
+  *slot = (u64)secondary_entry;
+  dcache_clean_invalidate_range((const void *)slot, sizeof(*slot));
+  asm volatile("sev" ::: "memory");
+
+  while (!__atomic_load_n(&cpu_online[core], __ATOMIC_ACQUIRE) &&
+		 timer_get_ticks() - start < timeout) {
+	;
+  }
+}
+
+void smp_init() {
+  u32 core;
+
+  cpu_online[0] = 1;
+  irq_register(IRQ_IPI, smp_ipi, NULL);
+  irq_enable(IRQ_IPI);
+  for (core = 1; core < NR_CPUS; core++) {
+	smp_boot_cpu(core);
+  }
+}
+
+int smp_cpu_online(u32 core) {
+  return core < NR_CPUS && __atomic_load_n(&cpu_online[core], __ATOMIC_ACQUIRE);
+}
+
+int smp_run(u32 core, smp_fn fn, void *arg) {
+  struct smp_job *job;
+
+  if (core == 0 || !smp_cpu_online(core)) {
+	return -1;
+  }
+  job = &jobs[core];
+  if (__atomic_load_n(&job->pending, __ATOMIC_ACQUIRE)) {
+	return -1;
+  }
+
+  job->fn = fn;
+  job->arg = arg;
+  __atomic_store_n(&job->pending, 1, __ATOMIC_RELEASE);
+  work_queue_on(core, &job->work);
+  TRACE(SMP_POST, core);
+  return 0;
+}
+
+void smp_wait(u32 core) {
+  if (core >= NR_CPUS) {
+	return;
+  }
+  while (__atomic_load_n(&jobs[core].pending, __ATOMIC_ACQUIRE)) {
+	asm volatile("wfe");
+  }
+}
+
+/**
+ * Post a call
+ * - IRQs masked: an IRQ handler on this core posting to the same target
+ *   would be a second producer on the queue
+ * - Fill the slot, then publish it with the head
+ */
+int smp_post(u32 core, smp_fn fn, void *arg) {
+  u32 self = smp_processor_id();
+  struct smp_queue *q;
+  u32 head;
+  u64 flags;
+
+  if (core == self || !smp_cpu_online(core)) {
+	return -1;
+  }
+  q = &smp_queues[core][self];
+
+  flags = irq_local_save();
+  head = q->head;
+  if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) == SMP_QUEUE_SIZE) {
+	irq_local_restore(flags);
+	return -1;
+  }
+  q->msg[head % SMP_QUEUE_SIZE].fn = fn;
+  q->msg[head % SMP_QUEUE_SIZE].arg = arg;
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+  irq_local_restore(flags);
+
+  TRACE(SMP_POST, core);
+  return 0;
+}
+
+/**
+ * Ring the doorbell
+ * - Order the posts before the doorbell check (pairs with the fence in
+ *   smp_ipi())
+ * - Only the sender that raises it sends the IPI: several senders may
+ *   race for it, hence the exchange (an exclusive pair: the doorbells
+ *   are in Normal memory once boot.S has turned the MMU on, mmu.h)
+ */
+void smp_kick(u32 core) {
+  if (core >= NR_CPUS) {
+	return;
+  }
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_exchange_n(&smp_doorbells[core].rung, 1, __ATOMIC_SEQ_CST)) {
+	irq_send_ipi(core);
+  }
+}
+
+int smp_call_function(u32 core, smp_fn fn, void *arg) {
+  if (smp_post(core, fn, arg)) {
+	return -1;
+  }
+  smp_kick(core);
+  return 0;
+}
+
+u64 smp_calls_handled(u32 core) {
+  return per_cpu(smp_calls, core);
+}
+
+u64 smp_ipis_handled(u32 core) {
+  return per_cpu(smp_ipis, core);
+}
+
+SHELL_CMD(smp, "", "cores and cross-core call stats") {
+  u32 core;
+
+  for (core = 0; core < NR_CPUS; core++) {
+	printf("core %u: %s, %lu calls in %lu IPIs\n", core,
+		   smp_cpu_online(core) ? "online" : "offline",
+		   smp_calls_handled(core), smp_ipis_handled(core));
+  }
+  return 0;
+}
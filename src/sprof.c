@@ -0,0 +1,159 @@
+/**
+ * @file sprof.c
+ * @author Jose Pires
+ * @date 2024-10-15
+ *
+ * @brief Statistical sampling profiler implementation
+ *
+ * Each ring has a single producer (the PMU IRQ of its core) and a
+ * single consumer (sprof_stream()), so it needs no lock: the producer
+ * publishes with a release store of head, the consumer frees slots with
+ * a release store of tail.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "sprof.h"
+#include "irq.h"
+#include "pmu.h"
+#include "printf.h"
+#include "sections.h"
+#include "shell.h"
+#include "smp.h"
+
+/**
+ * @brief Per-core sample ring
+ *
+ * The producer (the sampled core, in the IRQ) and the consumer (the
+ * console core) fields sit on separate cache lines, and so do the rings
+ */
+struct sprof_ring {
+  u32 head;                  /**< Next slot to write (producer) */
+  u32 dropped;               /**< Samples lost to a full ring */
+  u32 period;                /**< Sampling period (cycles) */
+  u32 tail ____cacheline_aligned; /**< Next slot to read (consumer) */
+  u64 pc[SPROF_RING_SIZE] ____cacheline_aligned; /**< Sampled PCs */
+} ____cacheline_aligned;
+
+static struct sprof_ring rings[NR_CPUS];
+
+/**
+ * Load the counter so it overflows after period cycles
+ */
+static inline void sprof_arm(u32 period) {
+  asm volatile("msr pmevcntr5_el0, %0" :: "r"((u64)(0U - period)));
+}
+
+/**
+ * PMU overflow IRQ
+ * - Ignore overflows of other counters
+ * - Clear the overflow flag and re-arm before recording, so the period
+ *   does not stretch by the handler time
+ * - Record ELR_EL1 (the interrupted PC), dropping it if the ring is full
+ */
+static void sprof_irq(void *arg, struct pt_regs *regs) {
+  struct sprof_ring *ring = arg;
+  u64 ovs;
+  u32 head;
+
+  asm volatile("mrs %0, pmovsclr_el0" : "=r"(ovs));
+  if (!(ovs & (1 << SPROF_COUNTER))) {
+	return;
+  }
+  asm volatile("msr pmovsclr_el0, %0" :: "r"((u64)(1 << SPROF_COUNTER)));
+  sprof_arm(ring->period);
+
+  head = ring->head;
+  if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= SPROF_RING_SIZE) {
+	ring->dropped++;
+	return;
+  }
+  ring->pc[head & (SPROF_RING_SIZE - 1)] = regs->elr;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Start sampling
+ * - Counter SPROF_COUNTER counts CPU cycles, overflow IRQ enabled
+ * - The PMU IRQ is per core: route it to the calling core
+ */
+int sprof_start(u32 period) {
+  u32 core = smp_processor_id();
+  struct sprof_ring *ring = &rings[core];
+
+  if (SPROF_COUNTER >= pmu_num_counters() || period == 0) {
+	return -1;
+  }
+
+  ring->period = period;
+  ring->dropped = 0;
+  pmu_set_event(SPROF_COUNTER, PMU_EVT_CPU_CYCLES);
+  sprof_arm(period);
+
+  irq_register(IRQ_PMU(core), sprof_irq, ring);
+  irq_enable(IRQ_PMU(core));
+  asm volatile("msr pmintenset_el1, %0" :: "r"((u64)(1 << SPROF_COUNTER)));
+
+  return 0;
+}
+
+void sprof_stop() {
+  u32 core = smp_processor_id();
+
+  asm volatile("msr pmintenclr_el1, %0" :: "r"((u64)(1 << SPROF_COUNTER)));
+  irq_disable(IRQ_PMU(core));
+  rings[core].period = 0;
+}
+
+int sprof_active() {
+  return rings[smp_processor_id()].period != 0;
+}
+
+/**
+ * Drain every ring
+ * - Snapshot head (acquire), print up to it, then release the slots
+ * - Report samples dropped since the last call
+ */
+u32 sprof_stream() {
+  u32 core, head, tail, sent = 0;
+
+  for (core = 0; core < NR_CPUS; core++) {
+	struct sprof_ring *ring = &rings[core];
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	for (tail = ring->tail; tail != head; tail++, sent++) {
+	  printf("sprof: %u %lx\n", core, ring->pc[tail & (SPROF_RING_SIZE - 1)]);
+	}
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+	if (ring->dropped) {
+	  printf("sprof: %u dropped %u\n", core, ring->dropped);
+	  ring->dropped = 0;
+	}
+  }
+  return sent;
+}
+
+SHELL_CMD(sprof, "start [period] | stop", "sample the PC of this core") {
+  u64 period = SPROF_DEFAULT_PERIOD;
+
+  if (argc >= 2 && shell_streq(argv[1], "start")) {
+	if (argc > 3 || (argc == 3 && shell_parse_u64(argv[2], &period))) {
+	  return -1;
+	}
+	if (period == 0 || period > 0xFFFFFFFFU) {
+	  printf("sprof: period must be 1-%u cycles\n", 0xFFFFFFFFU);
+	  return 1;
+	}
+	if (sprof_start(period)) {
+	  printf("sprof: no PMU counter %u\n", SPROF_COUNTER);
+	  return 1;
+	}
+  } else if (argc == 2 && shell_streq(argv[1], "stop")) {
+	sprof_stop();
+	sprof_stream();
+  } else {
+	return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file timer.c
+ * @author Jose Pires
+ * @date 2024-10-09
+ *
+ * @brief ARM generic timer implementation
+ *
+ * Timer event lists are per core and only touched by their core, in
+ * thread context with IRQs masked or in the timer interrupt, so they
+ * need no lock. Deadlines are compared directly: the 64-bit counter
+ * does not wrap in the lifetime of the board.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "timer.h"
+#include "irq.h"
+#include "smp.h"
+#include "sysregs.h"
+
+#define CNTP_CTL_ENABLE (1 << 0)
+#define CNTP_CTL_IMASK (1 << 1)
+
+/**
+ * @brief Timer events of a core
+ */
+struct timer_base {
+  struct timer_event *head; /**< Earliest deadline first */
+  u32 irq_on;
+  u64 evstream;             /**< Event stream period (ticks), 0: off */
+} ____cacheline_aligned;
+
+static struct timer_base timer_bases[NR_CPUS];
+
+/**
+ * Event stream
+ * - An event is generated on every 0->1 edge of counter bit EVNTI, so
+ *   the period is 2^(EVNTI + 1) ticks: take the largest one that is not
+ *   above TIMER_EVSTREAM_US
+ * - Keep the other CNTKCTL_EL1 bits (EL0 access) as they are
+ */
+void timer_init_cpu() {
+  struct timer_base *tb = &timer_bases[smp_processor_id()];
+  u64 max = timer_us_to_ticks(TIMER_EVSTREAM_US);
+  u64 ctl;
+  u32 evnti = 0;
+
+  while (evnti < 15 && (2ULL << (evnti + 1)) <= max) {
+	evnti++;
+  }
+  asm volatile("mrs %0, cntkctl_el1" : "=r"(ctl));
+  ctl &= ~(u64)CNTKCTL_EVNTI_MASK;
+  ctl |= CNTKCTL_EVNTEN | (evnti << CNTKCTL_EVNTI_SHIFT);
+  asm volatile("msr cntkctl_el1, %0\n\tisb" :: "r"(ctl));
+  tb->evstream = 2ULL << evnti;
+}
+
+/**
+ * Wait on the system counter
+ * - Convert the delay to counter ticks once
+ * - Compare the elapsed ticks (wrap-safe unsigned subtraction)
+ * - Sleep in WFE while a whole event stream period is left: the next
+ *   event (or any other) wakes the core before the deadline
+ */
+void udelay(u64 us) {
+  u64 evstream = timer_bases[smp_processor_id()].evstream;
+  u64 start = timer_get_ticks();
+  u64 ticks = timer_us_to_ticks(us);
+  u64 elapsed;
+
+  while ((elapsed = timer_get_ticks() - start) < ticks) {
+	if (evstream && ticks - elapsed > evstream) {
+	  asm volatile("wfe");
+	}
+  }
+}
+
+u64 timer_next_deadline() {
+  struct timer_base *tb = &timer_bases[smp_processor_id()];
+
+  return tb->head ? tb->head->expires : 0;
+}
+
+/**
+ * Program CNTP for the earliest deadline, or stop it (a deadline
+ * already past fires at once)
+ */
+static void timer_program(struct timer_base *tb) {
+  if (tb->head) {
+	asm volatile("msr cntp_cval_el0, %0" :: "r"(tb->head->expires));
+	asm volatile("msr cntp_ctl_el0, %0" :: "r"((u64)CNTP_CTL_ENABLE));
+  } else {
+	asm volatile("msr cntp_ctl_el0, %0" :: "r"((u64)0));
+  }
+  asm volatile("isb");
+}
+
+/**
+ * Insert in deadline order, after the events with the same deadline
+ */
+static void timer_insert(struct timer_base *tb, struct timer_event *t) {
+  struct timer_event **pp = &tb->head;
+
+  while (*pp && (*pp)->expires <= t->expires) {
+	pp = &(*pp)->next;
+  }
+  t->next = *pp;
+  *pp = t;
+  t->armed = 1;
+}
+
+static void timer_remove(struct timer_base *tb, struct timer_event *t) {
+  struct timer_event **pp = &tb->head;
+
+  while (*pp && *pp != t) {
+	pp = &(*pp)->next;
+  }
+  if (*pp) {
+	*pp = t->next;
+  }
+  t->armed = 0;
+}
+
+/**
+ * Timer interrupt
+ * - Queue the work of every expired event
+ * - Periodic events go back in at their next deadline; one that fell a
+ *   whole period behind skips the missed expiries
+ * - Program the next deadline (this also clears the interrupt)
+ */
+static void timer_irq(void *arg, struct pt_regs *regs) {
+  struct timer_base *tb = &timer_bases[smp_processor_id()];
+  u64 now = timer_get_ticks();
+  struct timer_event *t;
+
+  while ((t = tb->head) && t->expires <= now) {
+	tb->head = t->next;
+	t->armed = 0;
+	work_queue(&t->work);
+	if (t->period) {
+	  t->expires += t->period;
+	  if (t->expires <= now) {
+		t->expires = now + t->period;
+	  }
+	  timer_insert(tb, t);
+	}
+  }
+  timer_program(tb);
+}
+
+/**
+ * Arm
+ * - The interrupt is per core (PPI): register and enable it on the
+ *   core's first event
+ * - IRQs masked while the list changes
+ */
+void timer_event_start(struct timer_event *t, u64 delay_us, u64 period_us) {
+  struct timer_base *tb = &timer_bases[smp_processor_id()];
+  u64 flags;
+
+  if (!tb->irq_on) {
+	tb->irq_on = 1;
+	irq_register(IRQ_TIMER_CNTPNS, timer_irq, NULL);
+	irq_enable(IRQ_TIMER_CNTPNS);
+  }
+
+  flags = irq_local_save();
+  if (t->armed) {
+	timer_remove(tb, t);
+  }
+  t->expires = timer_get_ticks() + timer_us_to_ticks(delay_us);
+  t->period = timer_us_to_ticks(period_us);
+  timer_insert(tb, t);
+  timer_program(tb);
+  irq_local_restore(flags);
+}
+
+void timer_event_stop(struct timer_event *t) {
+  struct timer_base *tb = &timer_bases[smp_processor_id()];
+  u64 flags = irq_local_save();
+
+  if (t->armed) {
+	timer_remove(tb, t);
+	timer_program(tb);
+  }
+  irq_local_restore(flags);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file trace.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Event trace buffer implementation
+ *
+ * A ring is written by one core only, but thread context and the IRQ
+ * handlers of that core may interleave: a writer interrupted between
+ * reading head and publishing it would otherwise lose its slot to the
+ * handler. Slots are therefore reserved with a compare-and-swap (which
+ * fails, and is retried, if an IRQ took the slot), and each record
+ * carries its own commit word (seq), so a slot reserved by thread
+ * context and still being filled holds the drainer back without
+ * blocking the handler that interrupted it.
+ *
+ * The CAS and the dropped count are exclusives (LDXR/STXR), which only
+ * work on Normal memory: a core can trace once boot.S has turned its
+ * MMU on (mmu.h), which is before kernel_main or secondary_main run.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "trace.h"
+#include "printf.h"
+#include "shell.h"
+
+struct trace_ring trace_rings[NR_CPUS];
+
+static const char *const trace_event_names[TRACE_EV_NR] = {
+  [TRACE_EV_IRQ_ENTRY] = "irq_entry",
+  [TRACE_EV_IRQ_EXIT] = "irq_exit",
+  [TRACE_EV_SMP_POST] = "smp_post",
+  [TRACE_EV_SMP_START] = "smp_start",
+  [TRACE_EV_SMP_DONE] = "smp_done",
+  [TRACE_EV_FREQ] = "freq",
+  [TRACE_EV_USER] = "user",
+};
+
+const char *trace_event_name(u32 event) {
+  return event < TRACE_EV_NR ? trace_event_names[event] : "?";
+}
+
+/**
+ * Append a record
+ * - Reserve: timestamp, check room, CAS head; an IRQ that traced in
+ *   between makes the CAS fail, and the retry takes a later timestamp
+ * - Fill the slot, then publish it with a release store of seq
+ */
+int trace_ring_write(struct trace_ring *ring, u32 core, u32 event, u32 nargs,
+					 u32 a0, u32 a1, u32 a2, u32 a3) {
+  struct trace_rec *rec;
+  u32 head;
+  u64 ts;
+
+  do {
+	ts = trace_clock();
+	head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+	  __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+	  return -1;
+	}
+  } while (!__atomic_compare_exchange_n(&ring->head, &head, head + 1, 0,
+										__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  rec = &ring->rec[head & (TRACE_RING_SIZE - 1)];
+  rec->ts = ts;
+  rec->event = event;
+  rec->core = core;
+  rec->nargs = nargs;
+  rec->args[0] = a0;
+  rec->args[1] = a1;
+  rec->args[2] = a2;
+  rec->args[3] = a3;
+  __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/**
+ * Oldest complete record of a ring, or NULL
+ */
+static struct trace_rec *trace_ring_peek(struct trace_ring *ring) {
+  u32 tail = ring->tail;
+  struct trace_rec *rec = &ring->rec[tail & (TRACE_RING_SIZE - 1)];
+
+  if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+	return NULL;
+  }
+  return rec;
+}
+
+/**
+ * K-way merge
+ * - Pick the ring whose oldest complete record has the lowest timestamp
+ * - Hand a copy to the sink, then free the slot (release store of tail)
+ *   so a writer can reuse it while the sink is still busy
+ * - The nr of rings is small: a linear scan beats a heap
+ */
+u32 trace_drain(struct trace_ring *rings, u32 n, u32 max, trace_sink sink,
+				void *arg) {
+  struct trace_rec *rec, *best;
+  struct trace_rec copy;
+  u32 i, best_i = 0, count;
+
+  for (count = 0; count < max; count++) {
+	best = NULL;
+	for (i = 0; i < n; i++) {
+	  rec = trace_ring_peek(&rings[i]);
+	  if (rec && (!best || rec->ts < best->ts)) {
+		best = rec;
+		best_i = i;
+	  }
+	}
+	if (!best) {
+	  break;
+	}
+	copy = *best;
+	__atomic_store_n(&rings[best_i].tail, rings[best_i].tail + 1,
+					 __ATOMIC_RELEASE);
+	sink(&copy, arg);
+  }
+  return count;
+}
+
+u32 trace_ring_dropped(struct trace_ring *ring) {
+  return __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * Console sink: one line per record
+ */
+static void trace_print(const struct trace_rec *rec, void *arg) {
+  u32 i;
+
+  printf("trace: %lu %u %s", rec->ts, rec->core, trace_event_name(rec->event));
+  for (i = 0; i < rec->nargs && i < TRACE_MAX_ARGS; i++) {
+	printf(" %x", rec->args[i]);
+  }
+  printf("\n");
+}
+
+/**
+ * Drain to the sink, then report the drops of each ring on the console
+ */
+u32 trace_stream_to(u32 max, trace_sink sink, void *arg) {
+  u32 core, dropped;
+  u32 sent = trace_drain(trace_rings, NR_CPUS, max, sink, arg);
+
+  for (core = 0; core < NR_CPUS; core++) {
+	dropped = trace_ring_dropped(&trace_rings[core]);
+	if (dropped) {
+	  printf("trace: %u dropped %u\n", core, dropped);
+	}
+  }
+  return sent;
+}
+
+u32 trace_stream(u32 max) {
+  return trace_stream_to(max, trace_print, NULL);
+}
+
+SHELL_CMD(trace, "", "print the buffered trace records") {
+  trace_stream(~0U);
+  return 0;
+}
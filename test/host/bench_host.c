@@ -0,0 +1,71 @@
+/**
+ * @file bench_host.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief Host micro-benchmarks of the pure driver/library logic
+ *
+ * Same workloads as src/benchmarks.c where they make sense on a host, so
+ * algorithmic changes can be compared before flashing a board.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "gpio.h"
+#include "pl011.h"
+#include "printf.h"
+#include "trace.h"
+
+static char buf[128];
+
+HOST_BENCH(printf_format) {
+  uint64_t i;
+
+  for (i = 0; i < iters; i++) {
+	sprintf(buf, "%s %d %x %lu\n", "bench", -12345, 0xBEEF, 1234567890123UL);
+  }
+  return iters;
+}
+
+HOST_BENCH(pl011_set_br) {
+  static const uart_gpio gpio = {.tx = 14, .rx = 15, .func = GFAlt0};
+  pl011_uart uart = {.regs = (pl011_regs *)UART0, .gpio = &gpio};
+  uint64_t i;
+
+  for (i = 0; i < iters; i++) {
+	pl011_set_br(&uart, 115200 + (i & 0xff));
+  }
+  return iters;
+}
+
+HOST_BENCH(gpio_set_func) {
+  uint64_t i;
+
+  for (i = 0; i < iters; i++) {
+	gpio_pin_set_func(i % 54, (i & 1) ? GFAlt0 : GFInput);
+  }
+  return iters;
+}
+
+static void trace_discard(const struct trace_rec *rec, void *arg) {
+  (void)rec;
+  (void)arg;
+}
+
+/**
+ * One record written per op, drained in batches like trace_stream()
+ */
+HOST_BENCH(trace_write) {
+  static struct trace_ring ring;
+  uint64_t i;
+
+  for (i = 0; i < iters; i++) {
+	trace_ring_write(&ring, 0, TRACE_EV_USER, 2, i, i >> 32, 0, 0);
+	if ((i & (TRACE_STREAM_BATCH - 1)) == TRACE_STREAM_BATCH - 1) {
+	  trace_drain(&ring, 1, TRACE_STREAM_BATCH, trace_discard, NULL);
+	}
+  }
+  return iters;
+}
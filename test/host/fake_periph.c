@@ -0,0 +1,44 @@
+/**
+ * @file fake_periph.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief Fake peripherals and assembly stubs for the host build
+ *
+ * With HOST_TEST, PBASE points at host_periph (see peripherals/base.h),
+ * so the drivers' REGS_* accesses land in this block, where the tests
+ * can inspect them. The utils.S routines are replaced by C versions.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "common.h"
+#include "peripherals/base.h"
+#include "test.h"
+#include "utils.h"
+
+unsigned char host_periph[HOST_PERIPH_SIZE] __attribute__((aligned(4096)));
+
+void fake_periph_reset(void) {
+  memset(host_periph, 0, sizeof(host_periph));
+}
+
+void delay(u64 ticks) {
+  (void)ticks;
+}
+
+void put32(u64 addr, u32 val) {
+  *(volatile u32 *)addr = val;
+}
+
+u32 get32(u64 address) {
+  return *(volatile u32 *)address;
+}
+
+u32 get_el() {
+  return 1;
+}
+
+void memzero(unsigned long src, unsigned int n) {
+  memset((void *)src, 0, n);
+}
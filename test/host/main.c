@@ -0,0 +1,93 @@
+/**
+ * @file main.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief Host test runner
+ *
+ * - test-host [filter]       run the tests whose name contains filter
+ * - test-host --bench [f]    run the micro-benchmarks instead
+ *
+ * Each test starts from a cleared fake peripheral block. The exit code
+ * is the nr of failed tests.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+
+#define BENCH_MIN_NS 200000000ULL /**< Grow iters until a run takes 0.2 s */
+
+extern const struct test_case __start_test_cases[];
+extern const struct test_case __stop_test_cases[];
+extern const struct host_bench __start_host_benches[];
+extern const struct host_bench __stop_host_benches[];
+
+int test_failed;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int run_tests(const char *filter) {
+  const struct test_case *t;
+  int run = 0, failed = 0;
+
+  for (t = __start_test_cases; t < __stop_test_cases; t++) {
+	if (filter && !strstr(t->name, filter)) {
+	  continue;
+	}
+	fake_periph_reset();
+	test_failed = 0;
+	t->fn();
+	run++;
+	if (test_failed) {
+	  failed++;
+	}
+	printf("%s %s (%s)\n", test_failed ? "FAIL" : "PASS", t->name, t->file);
+  }
+
+  printf("%d tests, %d failed\n", run, failed);
+  return failed;
+}
+
+/**
+ * Run each benchmark with a growing nr of iterations until one run is
+ * long enough to be measured reliably, then report ns per operation
+ */
+static int run_benches(const char *filter) {
+  const struct host_bench *b;
+
+  for (b = __start_host_benches; b < __stop_host_benches; b++) {
+	uint64_t iters = 1000, ops, ns;
+
+	if (filter && !strstr(b->name, filter)) {
+	  continue;
+	}
+	for (;;) {
+	  uint64_t t0 = now_ns();
+	  ops = b->fn(iters);
+	  ns = now_ns() - t0;
+	  if (ns >= BENCH_MIN_NS || iters >= (1ULL << 40)) {
+		break;
+	  }
+	  iters *= 4;
+	}
+	printf("BENCH name=%s ops=%llu ns=%llu ns_per_op=%.2f\n", b->name,
+		   (unsigned long long)ops, (unsigned long long)ns,
+		   ops ? (double)ns / ops : 0.0);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+	return run_benches(argc > 2 ? argv[2] : NULL);
+  }
+  return run_tests(argc > 1 ? argv[1] : NULL);
+}
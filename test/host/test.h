@@ -0,0 +1,89 @@
+/**
+ * @file test.h
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief Minimal host unit-test and micro-benchmark framework
+ *
+ * Tests and benchmarks register themselves in a linker section, like
+ * the kernel's .bench/.prof_sites registries, and main.c walks them.
+ *
+ *   TEST(printf_decimal) {
+ *     CHECK_STR(buf, "42");
+ *   }
+ *
+ *   HOST_BENCH(printf_decimal) { for (...) ...; return iters; }
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+struct test_case {
+  const char *name;
+  const char *file;
+  void (*fn)(void);
+};
+
+struct host_bench {
+  const char *name;
+  uint64_t (*fn)(uint64_t iters); /**< Returns the nr of operations */
+};
+
+/**< Set by the CHECK macros when a check fails */
+extern int test_failed;
+
+#define TEST(id)														\
+  static void test_##id(void);										\
+  static const struct test_case test_case_##id						\
+  __attribute__((section("test_cases"), used, aligned(8))) =			\
+	{#id, __FILE__, test_##id};										\
+  static void test_##id(void)
+
+#define HOST_BENCH(id)													\
+  static uint64_t host_bench_##id(uint64_t iters);					\
+  static const struct host_bench host_bench_case_##id				\
+  __attribute__((section("host_benches"), used, aligned(8))) =		\
+	{#id, host_bench_##id};											\
+  static uint64_t host_bench_##id(uint64_t iters)
+
+#define TEST_FAIL(fmt, ...)											\
+  do {																	\
+	fprintf(stderr, "  %s:%d: " fmt "\n", __FILE__, __LINE__, __VA_ARGS__); \
+	test_failed = 1;													\
+	return;															\
+  } while (0)
+
+#define CHECK(cond)													\
+  do {																	\
+	if (!(cond)) {														\
+	  TEST_FAIL("CHECK(%s) failed", #cond);							\
+	}																	\
+  } while (0)
+
+#define CHECK_EQ(a, b)													\
+  do {																	\
+	unsigned long long a_ = (unsigned long long)(a);					\
+	unsigned long long b_ = (unsigned long long)(b);					\
+	if (a_ != b_) {													\
+	  TEST_FAIL("CHECK_EQ(%s, %s): 0x%llx != 0x%llx", #a, #b, a_, b_);	\
+	}																	\
+  } while (0)
+
+#define CHECK_STR(a, b)												\
+  do {																	\
+	const char *a_ = (a);												\
+	const char *b_ = (b);												\
+	if (strcmp(a_, b_) != 0) {											\
+	  TEST_FAIL("CHECK_STR(%s, %s): \"%s\" != \"%s\"", #a, #b, a_, b_);	\
+	}																	\
+  } while (0)
+
+/**
+ * @brief Clear the fake peripheral block (fake_periph.c)
+ */
+void fake_periph_reset(void);
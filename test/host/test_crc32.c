@@ -0,0 +1,51 @@
+/**
+ * @file test_crc32.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief CRC-32 tests (check values from zlib)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "crc32.h"
+
+TEST(crc32_check_value) {
+  CHECK_EQ(crc32("123456789", 9), 0xCBF43926);
+}
+
+TEST(crc32_empty) {
+  CHECK_EQ(crc32("", 0), 0);
+}
+
+TEST(crc32_chained) {
+  const char *s = "The quick brown fox jumps over the lazy dog";
+  u32 crc = crc32_update(0, s, 10);
+
+  crc = crc32_update(crc, s + 10, strlen(s) - 10);
+  CHECK_EQ(crc, 0x414FA339);
+  CHECK_EQ(crc32(s, strlen(s)), 0x414FA339);
+}
+
+TEST(crc32_all_bytes) {
+  u8 buf[256];
+  int i;
+
+  for (i = 0; i < 256; i++) {
+	buf[i] = i;
+  }
+  CHECK_EQ(crc32(buf, sizeof(buf)), 0x29058C73);
+}
+
+HOST_BENCH(crc32_4k) {
+  static u8 buf[4096];
+  uint64_t i;
+  u32 crc = 0;
+
+  for (i = 0; i < iters; i++) {
+	crc = crc32_update(crc, buf, sizeof(buf));
+  }
+  return iters * sizeof(buf) + (crc & 0);
+}
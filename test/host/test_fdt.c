@@ -0,0 +1,155 @@
+/**
+ * @file test_fdt.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Device tree lookup tests
+ *
+ * The DTB is built here token by token (big endian), with the nodes the
+ * firmware patches: /chosen holding the initramfs location.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "fdt.h"
+
+static uint8_t dtb[1024];
+static uint32_t dt_len;            /**< Structure block so far */
+static char dt_strings[256];
+static uint32_t dt_strings_len;
+
+#define DT_STRUCT 64 /**< Structure block offset (header + empty memreserve) */
+
+static void be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void dt_u32(uint32_t v) {
+  be32(dtb + DT_STRUCT + dt_len, v);
+  dt_len += 4;
+}
+
+static void dt_bytes(const void *p, uint32_t len) {
+  memcpy(dtb + DT_STRUCT + dt_len, p, len);
+  dt_len += len;
+  while (dt_len & 3) {
+	dtb[DT_STRUCT + dt_len++] = 0;
+  }
+}
+
+static void dt_begin(const char *name) {
+  dt_u32(1);
+  dt_bytes(name, strlen(name) + 1);
+}
+
+static void dt_end(void) {
+  dt_u32(2);
+}
+
+static void dt_prop(const char *name, const void *val, uint32_t len) {
+  dt_u32(3);
+  dt_u32(len);
+  dt_u32(dt_strings_len);
+  strcpy(dt_strings + dt_strings_len, name);
+  dt_strings_len += strlen(name) + 1;
+  dt_bytes(val, len);
+}
+
+static void dt_prop_cells(const char *name, uint32_t hi, uint32_t lo, int two) {
+  uint8_t v[8];
+
+  be32(v, two ? hi : lo);
+  be32(v + 4, lo);
+  dt_prop(name, v, two ? 8 : 4);
+}
+
+/**
+ * Header (version 17), then the structure and strings blocks
+ */
+static void dt_finish(void) {
+  uint32_t strings = DT_STRUCT + dt_len;
+
+  memset(dtb, 0, DT_STRUCT);
+  memcpy(dtb + strings, dt_strings, dt_strings_len);
+  be32(dtb + 0, FDT_MAGIC);
+  be32(dtb + 4, strings + dt_strings_len);
+  be32(dtb + 8, DT_STRUCT);
+  be32(dtb + 12, strings);
+  be32(dtb + 16, 40);
+  be32(dtb + 20, 17);
+  be32(dtb + 24, 16);
+  be32(dtb + 32, dt_strings_len);
+  be32(dtb + 36, dt_len);
+}
+
+static void dt_build(void) {
+  dt_len = dt_strings_len = 0;
+  dt_begin("");
+  dt_prop_cells("#address-cells", 0, 2, 0);
+  dt_begin("memory@0");
+  dt_prop_cells("reg", 0, 0x3b400000, 1);
+  dt_end();
+  dt_begin("soc");
+  dt_begin("chosen"); /**< Not /chosen */
+  dt_prop_cells("linux,initrd-start", 0, 0xdead, 0);
+  dt_end();
+  dt_end();
+  dt_begin("chosen");
+  dt_prop("bootargs", "console=ttyS0", 14);
+  dt_u32(4); /**< NOP */
+  dt_prop_cells("linux,initrd-start", 0, 0x2000000, 0);
+  dt_prop_cells("linux,initrd-end", 0, 0x2001000, 1);
+  dt_end();
+  dt_end();
+  dt_u32(9);
+  dt_finish();
+}
+
+TEST(fdt_check_header) {
+  dt_build();
+  CHECK_EQ(fdt_check(dtb), 0);
+  CHECK_EQ(fdt_size(dtb), DT_STRUCT + dt_len + dt_strings_len);
+  dtb[0] ^= 1;
+  CHECK_EQ(fdt_check(dtb), -1);
+  CHECK_EQ(fdt_check(NULL), -1);
+  dt_build();
+  be32(dtb + 36, 4096); /**< Structure block past the blob */
+  CHECK_EQ(fdt_check(dtb), -1);
+}
+
+TEST(fdt_chosen_initrd) {
+  const char *args;
+  uint64_t start, end;
+  uint32_t len;
+
+  dt_build();
+  CHECK_EQ(fdt_getprop_u64(dtb, "/chosen", "linux,initrd-start", &start), 0);
+  CHECK_EQ(start, 0x2000000);
+  CHECK_EQ(fdt_getprop_u64(dtb, "/chosen", "linux,initrd-end", &end), 0);
+  CHECK_EQ(end, 0x2001000);
+  args = fdt_getprop(dtb, "/chosen", "bootargs", &len);
+  CHECK(args != NULL);
+  CHECK_EQ(len, 14);
+  CHECK_STR(args, "console=ttyS0");
+}
+
+TEST(fdt_paths) {
+  uint64_t val;
+
+  dt_build();
+  CHECK_EQ(fdt_getprop_u64(dtb, "/", "#address-cells", &val), 0);
+  CHECK_EQ(val, 2);
+  CHECK_EQ(fdt_getprop_u64(dtb, "/memory", "reg", &val), 0); /**< memory@0 */
+  CHECK_EQ(val, 0x3b400000);
+  CHECK_EQ(fdt_getprop_u64(dtb, "/soc/chosen", "linux,initrd-start", &val), 0);
+  CHECK_EQ(val, 0xdead);
+  CHECK(fdt_getprop(dtb, "/chosen", "linux,initrd-size", NULL) == NULL);
+  CHECK(fdt_getprop(dtb, "/soc", "linux,initrd-start", NULL) == NULL);
+  CHECK(fdt_getprop(dtb, "/aliases", "serial0", NULL) == NULL);
+  CHECK_EQ(fdt_getprop_u64(dtb, "/chosen", "bootargs", &val), -1);
+}
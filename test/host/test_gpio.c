@@ -0,0 +1,79 @@
+/**
+ * @file test_gpio.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief GPIO function-select packing tests
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "gpio.h"
+
+TEST(gpio_func_low_pin) {
+  gpio_pin_set_func(0, GFAlt0);
+  CHECK_EQ(REGS_GPIO->func_select[0], GFAlt0);
+}
+
+TEST(gpio_func_register_split) {
+  /* Pin 9 is the last of GPFSEL0, pin 10 the first of GPFSEL1 */
+  gpio_pin_set_func(9, GFAlt4);
+  gpio_pin_set_func(10, GFOutput);
+  CHECK_EQ(REGS_GPIO->func_select[0], (u32)GFAlt4 << 27);
+  CHECK_EQ(REGS_GPIO->func_select[1], GFOutput);
+}
+
+TEST(gpio_func_preserves_neighbours) {
+  REGS_GPIO->func_select[1] = 0x3fffffff;
+  gpio_pin_set_func(12, GFAlt4);
+  CHECK_EQ(REGS_GPIO->func_select[1], (0x3fffffff & ~(7 << 6)) | (GFAlt4 << 6));
+}
+
+TEST(gpio_func_all_pins) {
+  u8 pin;
+
+  for (pin = 0; pin < 54; pin++) {
+	gpio_pin_set_func(pin, GFAlt3);
+  }
+  for (pin = 0; pin < 5; pin++) {
+	CHECK_EQ(REGS_GPIO->func_select[pin], 0x3fffffff);
+  }
+  CHECK_EQ(REGS_GPIO->func_select[5], 0xfff);
+}
+
+TEST(gpio_enable_leaves_pud_clock_clear) {
+  gpio_pin_enable(40);
+  CHECK_EQ(REGS_GPIO->pupd_enable, GPUD_Off);
+  CHECK_EQ(REGS_GPIO->pupd_enable_clocks[1], 0);
+}
+
+TEST(gpio_read_level) {
+  REGS_GPIO->level.data[0] = 1 << 15;
+  REGS_GPIO->level.data[1] = 1 << (40 - 32);
+  CHECK_EQ(gpio_pin_read(15), 1);
+  CHECK_EQ(gpio_pin_read(14), 0);
+  CHECK_EQ(gpio_pin_read(40), 1);
+}
+
+TEST(gpio_edge_select) {
+  REGS_GPIO->fe_detect_enable.data[1] = 1 << 3;
+  gpio_pin_set_edge(4, GPIO_EDGE_RISING | GPIO_EDGE_FALLING);
+  gpio_pin_set_edge(35, GPIO_EDGE_RISING);
+  CHECK_EQ(REGS_GPIO->re_detect_enable.data[0], 1 << 4);
+  CHECK_EQ(REGS_GPIO->fe_detect_enable.data[0], 1 << 4);
+  CHECK_EQ(REGS_GPIO->re_detect_enable.data[1], 1 << 3);
+  CHECK_EQ(REGS_GPIO->fe_detect_enable.data[1], 0);
+  gpio_pin_set_edge(4, 0);
+  CHECK_EQ(REGS_GPIO->re_detect_enable.data[0], 0);
+  CHECK_EQ(REGS_GPIO->fe_detect_enable.data[0], 0);
+}
+
+TEST(gpio_events_take) {
+  /* The fake registers are plain memory: the W1C write reads back */
+  REGS_GPIO->ev_detect_status.data[1] = (1 << 2) | (1 << 9);
+  CHECK_EQ(gpio_events_take(1), (1 << 2) | (1 << 9));
+  REGS_GPIO->ev_detect_status.data[0] = 0;
+  CHECK_EQ(gpio_events_take(0), 0);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file test_initramfs.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Initramfs index tests
+ *
+ * Archives are built in memory the way cpio -H newc and tar (ustar)
+ * lay them out.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "initramfs.h"
+
+static uint8_t blob[65536] __attribute__((aligned(512)));
+static uint32_t blob_len;
+
+static void pad(uint32_t align) {
+  while (blob_len % align) {
+	blob[blob_len++] = 0;
+  }
+}
+
+static void cpio_add(const char *name, uint32_t mode, const char *data) {
+  uint32_t len = data ? strlen(data) : 0;
+
+  blob_len += sprintf((char *)blob + blob_len,
+					  "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X"
+					  "%08X%08X", 1, mode, 0, 0, 1, 0, len, 0, 0, 0, 0,
+					  (uint32_t)strlen(name) + 1, 0);
+  strcpy((char *)blob + blob_len, name);
+  blob_len += strlen(name) + 1;
+  pad(4);
+  memcpy(blob + blob_len, data, len);
+  blob_len += len;
+  pad(4);
+}
+
+static void cpio_build(void) {
+  blob_len = 0;
+  cpio_add(".", 0040755, NULL);
+  cpio_add("./etc", 0040755, NULL);
+  cpio_add("./etc/config.txt", 0100644, "rate=115200\n");
+  cpio_add("./table.bin", 0100644, "abc");
+  cpio_add("./empty", 0100644, "");
+  cpio_add("./link", 0120777, "table.bin");
+  cpio_add("./table.bin", 0100644, "abcd"); /**< Appended: wins */
+  cpio_add("TRAILER!!!", 0, NULL);
+}
+
+static void tar_add(const char *name, const char *prefix, const char *data) {
+  uint8_t *hdr = blob + blob_len;
+  uint32_t len = strlen(data);
+
+  memset(hdr, 0, 512);
+  strncpy((char *)hdr, name, 100);
+  sprintf((char *)hdr + 124, "%011o", len);
+  hdr[156] = '0';
+  memcpy(hdr + 257, "ustar", 6);
+  memcpy(hdr + 263, "00", 2);
+  if (prefix) {
+	strcpy((char *)hdr + 345, prefix);
+  }
+  blob_len += 512;
+  memcpy(blob + blob_len, data, len);
+  blob_len += len;
+  pad(512);
+}
+
+TEST(initramfs_cpio_lookup) {
+  const struct file *f;
+  const char *data;
+  uint64_t size;
+
+  cpio_build();
+  CHECK_EQ(initramfs_init(blob, blob_len), 3);
+
+  data = file_map("etc/config.txt", &size);
+  CHECK(data != NULL);
+  CHECK_EQ(size, 12);
+  CHECK(memcmp(data, "rate=115200\n", 12) == 0);
+  CHECK_EQ((uintptr_t)data % 4, 0);
+  CHECK(file_map("/etc/config.txt", NULL) == data);
+  CHECK(file_map("./etc/config.txt", NULL) == data);
+
+  f = file_open("table.bin");
+  CHECK(f != NULL);
+  CHECK_EQ(f->size, 4);
+  CHECK(memcmp(f->data, "abcd", 4) == 0);
+  CHECK_EQ(f->name_len, 9);
+
+  f = file_open("empty");
+  CHECK(f != NULL);
+  CHECK_EQ(f->size, 0);
+
+  CHECK(file_open("etc") == NULL);  /**< Directory */
+  CHECK(file_open("link") == NULL); /**< Symlink */
+  CHECK(file_open("etc/missing") == NULL);
+  CHECK(file_open("") == NULL);
+
+  CHECK_EQ(initramfs_count(), 3);
+  CHECK(initramfs_file(0) == file_open("etc/config.txt"));
+  CHECK(initramfs_file(3) == NULL);
+}
+
+TEST(initramfs_cpio_truncated) {
+  cpio_build();
+  /* ".", "./etc", config.txt take 112 + 116 + 140 bytes; cut inside
+   * the data of table.bin: only config.txt is indexed */
+  CHECK_EQ(initramfs_init(blob, 368 + 124 + 2), 1);
+  CHECK(file_open("etc/config.txt") != NULL);
+  CHECK(file_open("table.bin") == NULL);
+}
+
+TEST(initramfs_tar_lookup) {
+  const char *data;
+  uint64_t size;
+
+  blob_len = 0;
+  tar_add("./lut/sine.txt", NULL, "0 1 0 -1\n");
+  tar_add("long.txt", "very/long/directory", "x");
+  tar_add("notes", NULL, "");
+  memset(blob + blob_len, 0, 1024);
+  blob_len += 1024;
+
+  CHECK_EQ(initramfs_init(blob, blob_len), 2);
+  data = file_map("lut/sine.txt", &size);
+  CHECK(data != NULL);
+  CHECK_EQ(size, 9);
+  CHECK_EQ((uintptr_t)data % 512, 0);
+  CHECK(file_open("long.txt") == NULL); /**< Prefix field: skipped */
+  CHECK(file_open("notes") != NULL);
+}
+
+TEST(initramfs_unknown_format) {
+  memset(blob, 0x5A, 1024);
+  CHECK_EQ(initramfs_init(blob, 1024), -1);
+  CHECK_EQ(initramfs_count(), 0);
+  CHECK(file_open("etc/config.txt") == NULL);
+}
+
+TEST(initramfs_many_files) {
+  char name[32];
+  uint32_t i;
+
+  blob_len = 0;
+  for (i = 0; i < INITRAMFS_MAX_FILES + 8; i++) {
+	sprintf(name, "f%u", i);
+	cpio_add(name, 0100644, "");
+  }
+  cpio_add("TRAILER!!!", 0, NULL);
+  CHECK_EQ(initramfs_init(blob, blob_len), INITRAMFS_MAX_FILES);
+  CHECK(file_open("f0") != NULL);
+  CHECK(file_open("f255") != NULL);
+  CHECK(file_open("f256") == NULL);
+}
+
+HOST_BENCH(initramfs_file_open) {
+  static const char *names[] = {"etc/config.txt", "table.bin", "empty",
+								"missing"};
+  static const struct file *volatile sink;
+  uint64_t i;
+
+  cpio_build();
+  initramfs_init(blob, blob_len);
+  for (i = 0; i < iters; i++) {
+	sink = file_open(names[i & 3]);
+  }
+  (void)sink;
+  return iters;
+}
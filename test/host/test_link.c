@@ -0,0 +1,205 @@
+/**
+ * @file test_link.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief COBS and framed link tests
+ *
+ * Two links are wired back to back through a byte buffer ("wire"); the
+ * tests corrupt or drop bytes on it to exercise the receive checks and
+ * the retransmission.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "crc32.h"
+#include "link.h"
+
+static struct link board, host;
+static u8 wire[8192];
+static u32 wire_len;
+
+static void wire_write(void *arg, const u8 *buf, u32 len) {
+  (void)arg;
+  while (len-- && wire_len < sizeof(wire)) {
+	wire[wire_len++] = *buf++;
+  }
+}
+
+/**
+ * Feed the wire to a link; collect the data frames' payloads
+ */
+static u32 wire_deliver(struct link *to, u8 *out, u32 *frames) {
+  u8 bytes[8192];
+  struct link_frame f;
+  u32 i, n = wire_len, len = 0;
+
+  memcpy(bytes, wire, n);
+  wire_len = 0;
+  *frames = 0;
+  for (i = 0; i < n; i++) {
+	if (link_input(to, bytes[i], &f)) {
+	  memcpy(out + len, f.data, f.len);
+	  len += f.len;
+	  (*frames)++;
+	}
+  }
+  return len;
+}
+
+/**
+ * Move what one side sent to the other side; the replies stay on the wire
+ */
+static void wire_to(struct link *to) {
+  u8 bytes[8192];
+  struct link_frame f;
+  u32 i, n = wire_len;
+
+  memcpy(bytes, wire, n);
+  wire_len = 0;
+  for (i = 0; i < n; i++) {
+	link_input(to, bytes[i], &f);
+  }
+}
+
+static void setup(void) {
+  wire_len = 0;
+  link_init(&board, wire_write, NULL);
+  link_init(&host, wire_write, NULL);
+}
+
+static void cobs_round_trip(const u8 *data, u32 len) {
+  u8 enc[LINK_ENC_MAX + 64], dec[LINK_ENC_MAX + 64];
+  u32 n = cobs_encode(data, len, enc), i;
+
+  CHECK(n <= len + len / 254 + 1);
+  for (i = 0; i < n; i++) {
+	CHECK(enc[i] != 0);
+  }
+  CHECK_EQ(cobs_decode(enc, n, dec), len);
+  CHECK(memcmp(dec, data, len) == 0);
+}
+
+TEST(cobs_vectors) {
+  const u8 zero[] = {0}, two[] = {0, 0}, mixed[] = {0x11, 0x22, 0, 0x33};
+  u8 enc[8];
+
+  CHECK_EQ(cobs_encode(zero, 1, enc), 2);
+  CHECK(enc[0] == 1 && enc[1] == 1);
+  CHECK_EQ(cobs_encode(two, 2, enc), 3);
+  CHECK(enc[0] == 1 && enc[1] == 1 && enc[2] == 1);
+  CHECK_EQ(cobs_encode(mixed, 4, enc), 5);
+  CHECK(enc[0] == 3 && enc[1] == 0x11 && enc[2] == 0x22 && enc[3] == 2 &&
+		enc[4] == 0x33);
+}
+
+TEST(cobs_long_runs) {
+  u8 data[LINK_ENC_MAX];
+  u32 i;
+
+  for (i = 0; i < sizeof(data); i++) {
+	data[i] = i % 255 + 1; /**< No zeros: 0xFF blocks */
+  }
+  cobs_round_trip(data, 254);
+  cobs_round_trip(data, 255);
+  data[100] = 0;
+  cobs_round_trip(data, sizeof(data));
+  cobs_round_trip(data, 0);
+}
+
+TEST(cobs_decode_rejects) {
+  const u8 zero_in[] = {3, 1, 0}, short_block[] = {5, 1, 2};
+  u8 dec[8];
+
+  CHECK_EQ(cobs_decode(zero_in, 3, dec), -1);
+  CHECK_EQ(cobs_decode(short_block, 3, dec), -1);
+}
+
+TEST(link_channels_and_split) {
+  u8 bulk[600], out[1024];
+  u32 frames, i;
+
+  setup();
+  for (i = 0; i < sizeof(bulk); i++) {
+	bulk[i] = i;
+  }
+  CHECK_EQ(link_send(&board, LINK_CH_BULK, bulk, sizeof(bulk)), 0);
+  CHECK_EQ(wire_deliver(&host, out, &frames), sizeof(bulk));
+  CHECK_EQ(frames, 3); /**< 248 + 248 + 104 */
+  CHECK(memcmp(out, bulk, sizeof(bulk)) == 0);
+
+  CHECK_EQ(link_send(&board, LINK_CH_NR, bulk, 1), -1);
+  CHECK_EQ(board.tx_frames, 3);
+}
+
+TEST(link_drops_corrupt_frames) {
+  struct link_frame f;
+  u8 out[64];
+  u32 frames, i;
+
+  setup();
+  link_send(&board, LINK_CH_CONSOLE, "hello", 5);
+  wire[2] ^= 0x40; /**< Payload bit flip: CRC mismatch */
+  link_send(&board, LINK_CH_CONSOLE, "world", 5);
+  CHECK_EQ(wire_deliver(&host, out, &frames), 5);
+  CHECK(memcmp(out, "world", 5) == 0);
+  CHECK_EQ(host.rx_bad, 1);
+
+  /* Garbage before a frame is dropped at the first delimiter */
+  for (i = 0; i < 300; i++) {
+	link_input(&host, 0x55, &f);
+  }
+  link_send(&board, LINK_CH_CONSOLE, "again", 5);
+  CHECK_EQ(wire_deliver(&host, out, &frames), 5);
+  CHECK_EQ(frames, 1);
+  CHECK_EQ(host.rx_bad, 2);
+}
+
+TEST(link_nak_retransmits) {
+  u8 nak[2] = {LINK_CTL_NAK, 1}, out[64];
+  u32 frames;
+
+  setup();
+  link_send(&board, LINK_CH_CONSOLE, "a", 1);
+  link_send(&board, LINK_CH_CONSOLE, "b", 1);
+  wire_len = 0; /**< Both lost on the way */
+
+  link_send(&host, LINK_CH_CTL, nak, 2);
+  wire_to(&board);
+  CHECK_EQ(board.retransmits, 1);
+  CHECK_EQ(board.tx_frames, 2); /**< Same frame, same seq */
+
+  CHECK_EQ(wire_deliver(&host, out, &frames), 1);
+  CHECK_EQ(out[0], 'b');
+}
+
+TEST(link_nak_lost) {
+  u8 nak[2] = {LINK_CTL_NAK, 0}, out[64];
+  u32 frames, i;
+
+  setup();
+  for (i = 0; i < LINK_HISTORY + 1; i++) {
+	link_send(&board, LINK_CH_CONSOLE, "x", 1);
+  }
+  wire_len = 0;
+  link_send(&host, LINK_CH_CTL, nak, 2); /**< seq 0 was overwritten */
+  wire_to(&board);
+  CHECK_EQ(board.lost, 1);
+  /* The LOST answer is a control frame: handled, not returned */
+  CHECK_EQ(wire_deliver(&host, out, &frames), 0);
+  CHECK_EQ(host.rx_frames, 1);
+}
+
+HOST_BENCH(link_send_1k) {
+  static u8 buf[1024];
+  uint64_t i;
+
+  setup();
+  for (i = 0; i < iters; i++) {
+	link_send(&board, LINK_CH_BULK, buf, sizeof(buf));
+	wire_len = 0;
+  }
+  return iters * sizeof(buf);
+}
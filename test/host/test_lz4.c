@@ -0,0 +1,138 @@
+/**
+ * @file test_lz4.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief LZ4 decompressor tests, and round trips through the host
+ * compressor (tools/lz4_compress.c)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include <stdlib.h>
+
+#include "test.h"
+
+#include "lz4.h"
+#include "lz4_compress.h"
+
+#define LZ4_TEST_SIZE (256 * 1024)
+
+static u8 raw[LZ4_TEST_SIZE];
+static u8 comp[LZ4_COMPRESS_BOUND(LZ4_TEST_SIZE)];
+static u8 out[LZ4_TEST_SIZE];
+
+/**
+ * Compress raw[0, n), decompress it and compare; returns the
+ * compressed size, or -1 on any mismatch
+ */
+static int roundtrip(u32 n) {
+  int c = lz4_compress(raw, n, comp, sizeof(comp));
+
+  if (c < 0 || lz4_decompress(comp, c, out, n) != (int)n ||
+	  memcmp(raw, out, n) != 0) {
+	return -1;
+  }
+  return c;
+}
+
+TEST(lz4_known_block) {
+  /* "abcd" + match (offset 4, length 8), then an empty last sequence */
+  static const u8 block[] = {0x44, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x00};
+  char buf[16] = {0};
+
+  CHECK_EQ(lz4_decompress(block, sizeof(block), (u8 *)buf, sizeof(buf)), 12);
+  CHECK_STR(buf, "abcdabcdabcd");
+}
+
+TEST(lz4_overlapping_match) {
+  /* "a" + match at offset 1, length 4 + 15 + 1: a run of 21 'a' */
+  static const u8 block[] = {0x1F, 'a', 0x01, 0x00, 0x01, 0x00};
+  u8 buf[32];
+  int i;
+
+  CHECK_EQ(lz4_decompress(block, sizeof(block), buf, sizeof(buf)), 21);
+  for (i = 0; i < 21; i++) {
+	CHECK_EQ(buf[i], 'a');
+  }
+}
+
+TEST(lz4_rejects_bad_offset) {
+  static const u8 block[] = {0x10, 'a', 0x02, 0x00, 0x00};
+  u8 buf[32];
+
+  CHECK_EQ(lz4_decompress(block, sizeof(block), buf, sizeof(buf)), -1);
+}
+
+TEST(lz4_rejects_overflow) {
+  static const u8 block[] = {0x44, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x00};
+  u8 buf[11];
+
+  CHECK_EQ(lz4_decompress(block, sizeof(block), buf, sizeof(buf)), -1);
+}
+
+TEST(lz4_rejects_truncated) {
+  static const u8 block[] = {0xF0, 0xFF};
+  u8 buf[512];
+
+  CHECK_EQ(lz4_decompress(block, sizeof(block), buf, sizeof(buf)), -1);
+}
+
+TEST(lz4_roundtrip_empty_and_tiny) {
+  raw[0] = 'x';
+  CHECK(roundtrip(0) >= 0);
+  CHECK(roundtrip(1) >= 0);
+  CHECK(roundtrip(13) >= 0);
+}
+
+TEST(lz4_roundtrip_zeros) {
+  int c;
+
+  memset(raw, 0, LZ4_TEST_SIZE);
+  c = roundtrip(LZ4_TEST_SIZE);
+  CHECK(c > 0);
+  CHECK(c < LZ4_TEST_SIZE / 100);
+}
+
+TEST(lz4_roundtrip_random) {
+  u32 i, x = 12345;
+
+  for (i = 0; i < LZ4_TEST_SIZE; i++) {
+	x = x * 1103515245 + 12345;
+	raw[i] = x >> 24;
+  }
+  CHECK(roundtrip(LZ4_TEST_SIZE) > 0);
+}
+
+TEST(lz4_roundtrip_mixed) {
+  u32 i, x = 1;
+
+  /* Short repeats, long repeats and noise, like code and tables */
+  for (i = 0; i < LZ4_TEST_SIZE; i++) {
+	x = x * 1103515245 + 12345;
+	if ((i / 4096) % 3 == 0) {
+	  raw[i] = i % 7;
+	} else if ((i / 4096) % 3 == 1) {
+	  raw[i] = raw[i - 4096 + (x >> 30)];
+	} else {
+	  raw[i] = x >> 24;
+	}
+  }
+  CHECK(roundtrip(LZ4_TEST_SIZE) > 0);
+  CHECK(roundtrip(LZ4_TEST_SIZE - 3) > 0);
+}
+
+HOST_BENCH(lz4_decompress) {
+  uint64_t i;
+  u32 j;
+  int c;
+
+  for (j = 0; j < LZ4_TEST_SIZE; j++) {
+	raw[j] = (j % 61) ^ (j >> 11);
+  }
+  c = lz4_compress(raw, LZ4_TEST_SIZE, comp, sizeof(comp));
+  for (i = 0; i < iters / 1000 + 1; i++) {
+	lz4_decompress(comp, c, out, LZ4_TEST_SIZE);
+  }
+  return (iters / 1000 + 1) * LZ4_TEST_SIZE;
+}
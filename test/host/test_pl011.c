@@ -0,0 +1,205 @@
+/**
+ * @file test_pl011.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief PL011 baud divisor and init tests
+ *
+ * The UART registers live in the fake peripheral block, so pl011_init()
+ * and pl011_set_br() can run unmodified and the tests read the
+ * resulting IBRD/FBRD/LCRH/CR values back.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "pl011.h"
+
+static const uart_gpio test_gpio = {.tx = 14, .rx = 15, .func = GFAlt0};
+static pl011_uart test_uart = {.regs = (pl011_regs *)UART0,
+							   .gpio = &test_gpio};
+
+static void check_br(u32 baud, u32 ibrd, u32 fbrd) {
+  pl011_set_uartclk(PL011_FSYSCLK);
+  pl011_set_br(&test_uart, baud);
+  CHECK_EQ(test_uart.regs->ibrd, ibrd);
+  CHECK_EQ(test_uart.regs->fbrd, fbrd);
+}
+
+TEST(pl011_br_115200) {
+  /* 48 MHz / (16 * 115200) = 26.0417 -> 26 + 3/64 */
+  check_br(115200, 26, 3);
+}
+
+TEST(pl011_br_921600) {
+  /* 48 MHz / (16 * 921600) = 3.2552 -> 3 + 16/64 */
+  check_br(921600, 3, 16);
+}
+
+TEST(pl011_br_max) {
+  check_br(3000000, 1, 0);
+}
+
+TEST(pl011_br_rejects_invalid) {
+  pl011_set_uartclk(PL011_FSYSCLK);
+  test_uart.regs->ibrd = 0x55;
+  test_uart.regs->cr = 0x301;
+  pl011_set_br(&test_uart, 3000001);
+  pl011_set_br(&test_uart, 0);
+  CHECK_EQ(test_uart.regs->ibrd, 0x55);
+  CHECK_EQ(test_uart.regs->cr, 0x301);
+}
+
+TEST(pl011_br_uartclk) {
+  /* 3 MHz UARTCLK (as on older firmware): 3e6 / (16 * 115200) = 1.6276 */
+  pl011_set_uartclk(3000000);
+  pl011_set_br(&test_uart, 115200);
+  CHECK_EQ(test_uart.regs->ibrd, 1);
+  CHECK_EQ(test_uart.regs->fbrd, 40);
+  pl011_set_uartclk(PL011_FSYSCLK);
+  CHECK_EQ(pl011_get_uartclk(), PL011_FSYSCLK);
+}
+
+TEST(pl011_init_regs) {
+  pl011_set_uartclk(PL011_FSYSCLK);
+  pl011_init(&test_uart, 115200);
+  CHECK_EQ(test_uart.regs->ibrd, 26);
+  CHECK_EQ(test_uart.regs->lcrh, PL011_WLEN_8 << PL011_UARTLCRH_WLEN);
+  CHECK_EQ(test_uart.regs->cr, (1 << PL011_UARTCR_RXE) |
+		   (1 << PL011_UARTCR_TXE) | (1 << PL011_UARTCR_UARTEN));
+  /* GPIO 14/15 -> ALT0 in GPFSEL1 bits 12-17 */
+  CHECK_EQ(REGS_GPIO->func_select[1], (GFAlt0 << 12) | (GFAlt0 << 15));
+}
+
+TEST(pl011_send_writes_dr) {
+  pl011_send(&test_uart, 'A');
+  CHECK_EQ(test_uart.regs->dr, 'A');
+}
+
+TEST(pl011_set_baud_keeps_config) {
+  u32 lcrh = (PL011_WLEN_8 << PL011_UARTLCRH_WLEN) | (1 << PL011_UARTLCRH_FEN);
+  u32 cr = (1 << PL011_UARTCR_RXE) | (1 << PL011_UARTCR_TXE) |
+	(1 << PL011_UARTCR_UARTEN);
+
+  pl011_set_uartclk(PL011_FSYSCLK);
+  test_uart.regs->lcrh = lcrh;
+  test_uart.regs->cr = cr;
+  CHECK_EQ(pl011_set_baud(&test_uart, 921600), 0);
+  CHECK_EQ(test_uart.regs->ibrd, 3);
+  CHECK_EQ(test_uart.regs->fbrd, 16);
+  CHECK_EQ(test_uart.regs->lcrh, lcrh);
+  CHECK_EQ(test_uart.regs->cr, cr);
+
+  CHECK_EQ(pl011_set_baud(&test_uart, 4000000), -1);
+  CHECK_EQ(test_uart.regs->ibrd, 3);
+  CHECK_EQ(test_uart.regs->cr, cr);
+}
+
+TEST(pl011_baud_match) {
+  CHECK_EQ(pl011_baud_match(115200), 115200);
+  CHECK_EQ(pl011_baud_match(112000), 115200); /* -2.8 % */
+  CHECK_EQ(pl011_baud_match(2950000), 3000000);
+  CHECK_EQ(pl011_baud_match(9400), 9600);
+  CHECK_EQ(pl011_baud_match(100000), 0);      /* between 57600 and 115200 */
+  CHECK_EQ(pl011_baud_match(0), 0);
+}
+
+TEST(pl011_init_flow_control) {
+  static const uart_gpio flow_gpio = UART0_GPIO_FLOW;
+  pl011_uart uart = {.regs = (pl011_regs *)UART0, .gpio = &flow_gpio};
+
+  pl011_set_uartclk(PL011_FSYSCLK);
+  pl011_init(&uart, 921600);
+  CHECK_EQ(uart.regs->cr, (1 << PL011_UARTCR_RXE) | (1 << PL011_UARTCR_TXE) |
+		   (1 << PL011_UARTCR_UARTEN) | (1 << PL011_UARTCR_RTSEN) |
+		   (1 << PL011_UARTCR_CTSEN));
+  /* GPIO 14/15 -> ALT0, 16/17 (CTS/RTS) -> ALT3 */
+  CHECK_EQ(REGS_GPIO->func_select[1], (GFAlt0 << 12) | (GFAlt0 << 15) |
+		   (GFAlt3 << 18) | (GFAlt3 << 21));
+}
+
+TEST(pl011_tx_fill) {
+  static u8 buf[16];
+  struct ring r = RING_INIT(buf);
+
+  CHECK_EQ(ring_write(&r, "abc", 3), 3);
+  test_uart.regs->fr = 1 << PL011_UARTFR_TXFF; /* FIFO full, or CTS off */
+  CHECK_EQ(pl011_tx_fill(&test_uart, &r), 0);
+  CHECK_EQ(ring_count(&r), 3);
+
+  test_uart.regs->fr = 0;
+  CHECK_EQ(pl011_tx_fill(&test_uart, &r), 3);
+  CHECK_EQ(test_uart.regs->dr, 'c');
+  CHECK(ring_empty(&r));
+}
+
+TEST(pl011_rx_drain) {
+  static u8 buf[8];
+  struct ring r = RING_INIT(buf);
+
+  test_uart.regs->fr = 1 << PL011_UARTFR_RXFE;
+  CHECK_EQ(pl011_rx_drain(&test_uart, &r), 0);
+
+  /* The fake FIFO never empties: stops at a full ring */
+  test_uart.regs->fr = 0;
+  test_uart.regs->dr = 0x100 | 'x'; /* Error bits are dropped */
+  CHECK_EQ(pl011_rx_drain(&test_uart, &r), 8);
+  CHECK(ring_full(&r));
+  CHECK_EQ(ring_get(&r), 'x');
+}
+
+TEST(pl011_rx_irq) {
+  test_uart.regs->imsc = 1 << PL011_INT_TX;
+  pl011_rx_irq(&test_uart, 1);
+  CHECK_EQ(test_uart.regs->imsc,
+		   (1 << PL011_INT_TX) | (1 << PL011_INT_RX) | (1 << PL011_INT_RT));
+  pl011_rx_irq(&test_uart, 0);
+  CHECK_EQ(test_uart.regs->imsc, 1 << PL011_INT_TX);
+}
+
+PL011_DEFINE(tuart, UART0, 14, 15, GFAlt0)
+
+static int sent_len;
+
+TEST(pl011_define_instance) {
+  CHECK(tuart_dev()->regs == (pl011_regs *)UART0);
+  CHECK_EQ(tuart_dev()->gpio->rx, 15);
+
+  tuart_send('A');
+  CHECK_EQ(tuart_dev()->regs->dr, 'A');
+
+  tuart_dev()->regs->fr = 1 << PL011_UARTFR_RXFE;
+  CHECK_EQ(tuart_can_recv(), 0);
+  tuart_dev()->regs->fr = 0;
+  tuart_dev()->regs->dr = 0x200 | 'z';
+  CHECK_EQ(tuart_can_recv(), 1);
+  CHECK_EQ(tuart_recv(), 'z');
+}
+
+static void count_putc(void *p, char c) {
+  (void)p;
+  sent_len++;
+}
+
+/**
+ * The fake DR keeps only the last write: check output both within and
+ * past the stack buffer reaches it
+ */
+TEST(pl011_define_vprintf) {
+  char big[PL011_VPRINTF_BUF + 8];
+
+  memset(big, 'b', sizeof(big) - 1);
+  big[sizeof(big) - 1] = 0;
+
+  init_vprintf(tuart_vprintf);
+  printf("%s=%d\n", "n", 7);
+  CHECK_EQ(tuart_dev()->regs->dr, '\n');
+  printf("%s", big);
+  CHECK_EQ(tuart_dev()->regs->dr, 'b');
+
+  sent_len = 0;
+  init_printf(NULL, count_putc); /* Also drops the vprintf output */
+  printf("%s=%d\n", "n", 7);
+  CHECK_EQ(sent_len, 4);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file test_printf.c
+ * @author Jose Pires
+ * @date 2024-10-17
+ *
+ * @brief printf.c formatting tests
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "printf.h"
+
+static char buf[128];
+
+TEST(printf_decimal) {
+  sprintf(buf, "%d %d %d", 0, 42, -12345);
+  CHECK_STR(buf, "0 42 -12345");
+}
+
+TEST(printf_unsigned) {
+  sprintf(buf, "%u", 4294967295U);
+  CHECK_STR(buf, "4294967295");
+}
+
+TEST(printf_hex) {
+  sprintf(buf, "%x %X %x", 0xbeefU, 0xbeefU, 0U);
+  CHECK_STR(buf, "beef BEEF 0");
+}
+
+TEST(printf_width_padding) {
+  sprintf(buf, "[%5d] [%05d] [%08x] [%3s]", 42, 42, 0xabcU, "a");
+  CHECK_STR(buf, "[   42] [00042] [00000abc] [  a]");
+}
+
+TEST(printf_long) {
+  sprintf(buf, "%lu %lx %ld", 1234567890123UL, 0xfedcba9876543210UL, -5L);
+  CHECK_STR(buf, "1234567890123 fedcba9876543210 -5");
+}
+
+TEST(printf_long_max) {
+  sprintf(buf, "%lu", 18446744073709551615UL);
+  CHECK_STR(buf, "18446744073709551615");
+}
+
+TEST(printf_char_string_percent) {
+  sprintf(buf, "%c%s%%", 'x', "yz");
+  CHECK_STR(buf, "xyz%");
+}
+
+TEST(printf_truncated_format) {
+  sprintf(buf, "abc%");
+  CHECK_STR(buf, "abc");
+}
+
+TEST(printf_snprintf_truncates) {
+  memset(buf, 'z', sizeof(buf));
+  CHECK_EQ(snprintf(buf, 6, "%s-%d", "abcd", 1234), 9);
+  CHECK_STR(buf, "abcd-");
+  CHECK_EQ(snprintf(buf, 1, "%x", 0xffU), 2);
+  CHECK_STR(buf, "");
+  CHECK_EQ(snprintf(buf, sizeof(buf), "%05u", 42U), 5);
+  CHECK_STR(buf, "00042");
+}
+
+TEST(printf_snprintf_sizes) {
+  /* Nothing is written with n == 0: size, then format */
+  int len = snprintf(NULL, 0, "%lu|%s", 18446744073709551615UL, "end");
+
+  CHECK_EQ(len, 24);
+  CHECK_EQ(snprintf(buf, len + 1, "%lu|%s", 18446744073709551615UL, "end"),
+		   len);
+  CHECK_STR(buf, "18446744073709551615|end");
+}
+
+static char out[64];
+static int out_len;
+
+static void out_putc(void *p, char c) {
+  (void)p;
+  out[out_len++] = c;
+}
+
+TEST(printf_stdout_putf) {
+  out_len = 0;
+  init_printf(NULL, out_putc);
+  printf("%s=%d\n", "n", 7);
+  out[out_len] = 0;
+  CHECK_STR(out, "n=7\n");
+}
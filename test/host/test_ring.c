@@ -0,0 +1,88 @@
+/**
+ * @file test_ring.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief SPSC byte ring tests
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "ring.h"
+
+TEST(ring_put_get) {
+  static u8 buf[4];
+  struct ring r = RING_INIT(buf);
+  int i;
+
+  CHECK(ring_empty(&r));
+  CHECK_EQ(ring_get(&r), -1);
+  for (i = 0; i < 4; i++) {
+	CHECK_EQ(ring_put(&r, 0xF0 + i), 0);
+  }
+  CHECK(ring_full(&r));
+  CHECK_EQ(ring_put(&r, 0), -1);
+  CHECK_EQ(ring_get(&r), 0xF0); /* Bytes come back unsigned */
+  CHECK_EQ(ring_space(&r), 1);
+}
+
+TEST(ring_wraps) {
+  static u8 buf[8];
+  struct ring r = RING_INIT(buf);
+  int i;
+
+  /* Free-running indices across the u32 wrap */
+  r.head = r.tail = 0xFFFFFFFC;
+  for (i = 0; i < 20; i++) {
+	CHECK_EQ(ring_put(&r, i), 0);
+	CHECK_EQ(ring_put(&r, i + 100), 0);
+	CHECK_EQ(ring_count(&r), 2);
+	CHECK_EQ(ring_get(&r), i);
+	CHECK_EQ(ring_get(&r), i + 100);
+  }
+  CHECK(ring_empty(&r));
+}
+
+TEST(ring_write_partial) {
+  static u8 buf[8];
+  struct ring r;
+  char out[9] = {0};
+  int i;
+
+  ring_init(&r, buf, sizeof(buf));
+  CHECK_EQ(ring_write(&r, "012", 3), 3);
+  CHECK_EQ(ring_get(&r), '0');
+  CHECK_EQ(ring_write(&r, "3456789", 7), 6);
+  for (i = 0; i < 8; i++) {
+	out[i] = ring_get(&r);
+  }
+  CHECK_STR(out, "12345678");
+}
+
+TEST(ring_reserve_commit) {
+  static u8 buf[8];
+  struct ring r = RING_INIT(buf);
+  u32 len;
+  u8 *p;
+
+  r.head = r.tail = 5;
+  p = ring_reserve(&r, &len);
+  CHECK(p == &buf[5]);
+  CHECK_EQ(len, 3); /* Up to the end of the buffer only */
+  memcpy(p, "xy", 2);
+  CHECK(ring_empty(&r)); /* Not visible before the commit */
+  ring_commit(&r, 2);
+  CHECK_EQ(ring_count(&r), 2);
+
+  p = ring_reserve(&r, &len);
+  CHECK_EQ(len, 1);
+  ring_commit(&r, 1);
+  p = ring_reserve(&r, &len);
+  CHECK(p == &buf[0]);
+  CHECK_EQ(len, 5);
+  CHECK_EQ(ring_get(&r), 'x');
+  p = ring_reserve(&r, &len);
+  CHECK_EQ(len, 6);
+}
@@ -0,0 +1,208 @@
+/**
+ * @file test_shell.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Shell line editor and command tests
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "test.h"
+
+#include "peripherals/base.h"
+#include "printf.h"
+#include "shell.h"
+
+static char out[4096];
+static int out_len;
+
+static int args_argc;
+static char args_line[SHELL_LINE_MAX];
+static int args_runs;
+
+static void out_putc(void *p, char c) {
+  (void)p;
+  if (out_len < (int)sizeof(out) - 1) {
+	out[out_len++] = c;
+  }
+  out[out_len] = 0;
+}
+
+/**
+ * Records its arguments, joined by '|'
+ */
+SHELL_CMD(t_args, "[arg ...]", "test: record the arguments") {
+  int i;
+
+  args_argc = argc;
+  args_runs++;
+  args_line[0] = 0;
+  for (i = 1; i < argc; i++) {
+	if (i > 1) {
+	  strcat(args_line, "|");
+	}
+	strcat(args_line, argv[i]);
+  }
+  return 0;
+}
+
+SHELL_CMD(t_usage, "<x>", "test: always a usage error") {
+  return -1;
+}
+
+static void setup(void) {
+  out_len = 0;
+  out[0] = 0;
+  args_argc = 0;
+  args_runs = 0;
+  args_line[0] = 0;
+  init_printf(NULL, out_putc);
+  shell_init(NULL);
+  out_len = 0;
+}
+
+static void feed(const char *s) {
+  while (*s) {
+	shell_input(*s++);
+  }
+}
+
+TEST(shell_parse_u64) {
+  u64 v = 0;
+
+  CHECK_EQ(shell_parse_u64("42", &v), 0);
+  CHECK_EQ(v, 42);
+  CHECK_EQ(shell_parse_u64("0xFe000000", &v), 0);
+  CHECK_EQ(v, 0xFE000000);
+  CHECK_EQ(shell_parse_u64("0x", &v), -1);
+  CHECK_EQ(shell_parse_u64("", &v), -1);
+  CHECK_EQ(shell_parse_u64("12a", &v), -1);
+}
+
+TEST(shell_exec_splits_args) {
+  char line[] = "  t_args a  bb c ";
+
+  setup();
+  CHECK_EQ(shell_exec(line), 0);
+  CHECK_EQ(args_argc, 4);
+  CHECK_STR(args_line, "a|bb|c");
+}
+
+TEST(shell_exec_errors) {
+  char unknown[] = "nope 1";
+  char usage[] = "t_usage";
+  char many[] = "t_args 1 2 3 4 5 6 7 8";
+  char empty[] = "   ";
+
+  setup();
+  CHECK_EQ(shell_exec(unknown), -1);
+  CHECK(strstr(out, "nope: unknown command") != NULL);
+  CHECK_EQ(shell_exec(usage), -1);
+  CHECK(strstr(out, "usage: t_usage <x>") != NULL);
+  CHECK_EQ(shell_exec(many), -1);
+  CHECK_EQ(args_runs, 0);
+  CHECK_EQ(shell_exec(empty), 0);
+}
+
+TEST(shell_line_crlf) {
+  setup();
+  feed("t_args x\r\n");
+  CHECK_EQ(args_runs, 1);
+  CHECK_STR(args_line, "x");
+  feed("t_args y\n");
+  CHECK_EQ(args_runs, 2);
+  CHECK_STR(args_line, "y");
+}
+
+TEST(shell_line_editing) {
+  setup();
+  feed("t_argsX\x7f ac\x1b[Db\r");
+  CHECK_STR(args_line, "abc");
+
+  feed("t_args abc\x01\x1b[3~\x05d\r"); /**< Home, Delete, End */
+  CHECK_EQ(args_runs, 1);
+  CHECK(strstr(out, "_args: unknown command") != NULL);
+
+  feed("junk\x15t_args u\r"); /**< Ctrl-U */
+  CHECK_STR(args_line, "u");
+  feed("junk\x03"); /**< Ctrl-C drops the line */
+  feed("t_args v\r");
+  CHECK_STR(args_line, "v");
+}
+
+TEST(shell_line_max) {
+  int i;
+
+  setup();
+  feed("t_args ");
+  for (i = 0; i < 2 * SHELL_LINE_MAX; i++) {
+	shell_input('a' + i % 26);
+  }
+  feed("\r");
+  CHECK_EQ(args_runs, 1);
+  CHECK_EQ(strlen(args_line), SHELL_LINE_MAX - 1 - strlen("t_args "));
+}
+
+TEST(shell_history) {
+  setup();
+  feed("t_args one\r");
+  feed("t_args two\r");
+  feed("t_args two\r"); /**< Repeats are not kept */
+  feed("\x1b[A\x1b[A\r");
+  CHECK_STR(args_line, "one");
+  feed("\x1b[A\x1b[A\x1b[B\r");
+  CHECK_STR(args_line, "one");
+  args_runs = 0;
+  feed("\x1b[A\x1b[B\r"); /**< Past the newest: empty line */
+  CHECK_EQ(args_runs, 0);
+}
+
+TEST(shell_history_wraps) {
+  char cmd[32];
+  int i;
+
+  setup();
+  for (i = 0; i < SHELL_HISTORY + 3; i++) {
+	sprintf(cmd, "t_args %d\r", i);
+	feed(cmd);
+  }
+  for (i = 0; i < SHELL_HISTORY + 5; i++) {
+	feed("\x1b[A"); /**< Stops at the oldest kept line */
+  }
+  feed("\r");
+  sprintf(cmd, "%d", 3);
+  CHECK_STR(args_line, cmd);
+}
+
+TEST(shell_peek_poke) {
+  char line[64];
+  u32 *word = (u32 *)&host_periph[0x100];
+
+  setup();
+  sprintf(line, "poke 0x%lx 0xcafe", (unsigned long)word);
+  CHECK_EQ(shell_exec(line), 0);
+  CHECK_EQ(*word, 0xcafe);
+
+  word[1] = 0x12345678;
+  out_len = 0;
+  sprintf(line, "peek 0x%lx 2", (unsigned long)word);
+  CHECK_EQ(shell_exec(line), 0);
+  CHECK(strstr(out, "0000cafe 12345678") != NULL);
+
+  sprintf(line, "peek 0x%lx", (unsigned long)word + 2);
+  CHECK_EQ(shell_exec(line), 1);
+  sprintf(line, "poke 0x%lx", (unsigned long)word);
+  CHECK_EQ(shell_exec(line), -1);
+}
+
+TEST(shell_help) {
+  char line[] = "help";
+
+  setup();
+  CHECK_EQ(shell_exec(line), 0);
+  CHECK(strstr(out, "peek <addr> [words]") != NULL);
+  CHECK(strstr(out, "t_args") != NULL);
+  CHECK(shell_find("poke") != NULL);
+  CHECK(shell_find("pok") == NULL);
+}
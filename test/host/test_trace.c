@@ -0,0 +1,188 @@
+/**
+ * @file test_trace.c
+ * @author Jose Pires
+ * @date 2024-10-19
+ *
+ * @brief Trace ring and merge tests
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "test.h"
+
+#include "trace.h"
+
+#define TRACE_TEST_RINGS 3
+#define TRACE_TEST_MAX 1024
+
+static struct trace_ring rings[TRACE_TEST_RINGS];
+static struct trace_rec out[TRACE_TEST_MAX];
+static u32 nout;
+static u64 ticks;
+
+/**< Host timestamp source (trace.h): a shared counter */
+u64 trace_clock() {
+  return __atomic_add_fetch(&ticks, 1, __ATOMIC_RELAXED);
+}
+
+static void collect(const struct trace_rec *rec, void *arg) {
+  (void)arg;
+  if (nout < TRACE_TEST_MAX) {
+	out[nout] = *rec;
+  }
+  nout++;
+}
+
+static void reset(void) {
+  memset(rings, 0, sizeof(rings));
+  nout = 0;
+  ticks = 0;
+}
+
+TEST(trace_record_fields) {
+  reset();
+  CHECK_EQ(sizeof(struct trace_rec), 32);
+  CHECK_EQ(trace_ring_write(&rings[0], 0, TRACE_EV_FREQ, 2, 600, 1500, 0, 0), 0);
+  CHECK_EQ(trace_drain(rings, 1, 10, collect, NULL), 1);
+  CHECK_EQ(out[0].ts, 1);
+  CHECK_EQ(out[0].event, TRACE_EV_FREQ);
+  CHECK_EQ(out[0].nargs, 2);
+  CHECK_EQ(out[0].args[0], 600);
+  CHECK_EQ(out[0].args[1], 1500);
+  CHECK_STR(trace_event_name(out[0].event), "freq");
+  CHECK_STR(trace_event_name(TRACE_EV_NR), "?");
+  CHECK_EQ(trace_drain(rings, 1, 10, collect, NULL), 0);
+}
+
+TEST(trace_full_ring_drops) {
+  u32 i;
+
+  reset();
+  for (i = 0; i < TRACE_RING_SIZE; i++) {
+	CHECK_EQ(trace_ring_write(&rings[0], 0, TRACE_EV_USER, 1, i, 0, 0, 0), 0);
+  }
+  for (i = 0; i < 5; i++) {
+	CHECK_EQ(trace_ring_write(&rings[0], 0, TRACE_EV_USER, 1, i, 0, 0, 0), -1);
+  }
+  CHECK_EQ(trace_ring_dropped(&rings[0]), 5);
+  CHECK_EQ(trace_ring_dropped(&rings[0]), 0);
+
+  /**< Draining frees the slots, and the ring wraps */
+  CHECK_EQ(trace_drain(rings, 1, 10, collect, NULL), 10);
+  for (i = 0; i < 10; i++) {
+	CHECK_EQ(trace_ring_write(&rings[0], 0, TRACE_EV_USER, 1, 1000 + i, 0, 0, 0), 0);
+  }
+  CHECK_EQ(trace_drain(rings, 1, TRACE_TEST_MAX, collect, NULL),
+		   TRACE_RING_SIZE);
+  CHECK_EQ(out[nout - 1].args[0], 1009);
+}
+
+TEST(trace_merge_by_timestamp) {
+  static const u8 order[] = {0, 2, 1, 1, 0, 2, 2, 0, 1, 0};
+  u32 i;
+
+  reset();
+  for (i = 0; i < sizeof(order); i++) {
+	trace_ring_write(&rings[order[i]], order[i], TRACE_EV_USER, 1, i, 0, 0, 0);
+  }
+  CHECK_EQ(trace_drain(rings, TRACE_TEST_RINGS, 100, collect, NULL),
+		   sizeof(order));
+  for (i = 0; i < sizeof(order); i++) {
+	CHECK_EQ(out[i].args[0], i);
+	CHECK_EQ(out[i].core, order[i]);
+  }
+}
+
+TEST(trace_drain_max) {
+  u32 i;
+
+  reset();
+  for (i = 0; i < 8; i++) {
+	trace_ring_write(&rings[i % 2], i % 2, TRACE_EV_USER, 1, i, 0, 0, 0);
+  }
+  CHECK_EQ(trace_drain(rings, 2, 3, collect, NULL), 3);
+  CHECK_EQ(trace_drain(rings, 2, 100, collect, NULL), 5);
+  CHECK_EQ(out[3].args[0], 3);
+}
+
+/**
+ * A slot reserved but not yet published (a writer interrupted between
+ * the CAS and the seq store) holds back its ring, not the others
+ */
+TEST(trace_unpublished_slot) {
+  reset();
+  trace_ring_write(&rings[0], 0, TRACE_EV_USER, 1, 0, 0, 0, 0);
+  rings[0].head++; /**< reserved, being written */
+  trace_ring_write(&rings[0], 0, TRACE_EV_USER, 1, 2, 0, 0, 0);
+  trace_ring_write(&rings[1], 1, TRACE_EV_USER, 1, 3, 0, 0, 0);
+
+  CHECK_EQ(trace_drain(rings, 2, 100, collect, NULL), 2);
+  CHECK_EQ(out[0].args[0], 0);
+  CHECK_EQ(out[1].args[0], 3);
+
+  rings[0].rec[1].ts = 2;
+  rings[0].rec[1].args[0] = 1;
+  __atomic_store_n(&rings[0].rec[1].seq, 2, __ATOMIC_RELEASE);
+  CHECK_EQ(trace_drain(rings, 2, 100, collect, NULL), 2);
+  CHECK_EQ(out[2].args[0], 1);
+  CHECK_EQ(out[3].args[0], 2);
+}
+
+#define TRACE_THREAD_RECORDS 100000
+
+static void *trace_producer(void *arg) {
+  u32 core = (u32)(uintptr_t)arg;
+  u32 i;
+
+  for (i = 0; i < TRACE_THREAD_RECORDS; i++) {
+	while (trace_ring_write(&rings[core], core, TRACE_EV_USER, 1, i, 0, 0, 0)) {
+	  ;
+	}
+  }
+  return NULL;
+}
+
+struct trace_check {
+  u32 next[TRACE_TEST_RINGS];
+  u32 errors;
+};
+
+static void check_sequence(const struct trace_rec *rec, void *arg) {
+  struct trace_check *c = arg;
+
+  if (rec->core >= TRACE_TEST_RINGS || rec->args[0] != c->next[rec->core]) {
+	c->errors++;
+	return;
+  }
+  c->next[rec->core]++;
+}
+
+/**
+ * One producer thread per ring and the drainer running concurrently:
+ * every record comes out exactly once, in order within its ring
+ */
+TEST(trace_concurrent_producers) {
+  pthread_t threads[TRACE_TEST_RINGS];
+  struct trace_check check;
+  u32 core, total = 0;
+
+  reset();
+  memset(&check, 0, sizeof(check));
+  for (core = 0; core < TRACE_TEST_RINGS; core++) {
+	pthread_create(&threads[core], NULL, trace_producer, (void *)(uintptr_t)core);
+  }
+  while (total < TRACE_TEST_RINGS * TRACE_THREAD_RECORDS) {
+	total += trace_drain(rings, TRACE_TEST_RINGS, 64, check_sequence, &check);
+  }
+  for (core = 0; core < TRACE_TEST_RINGS; core++) {
+	pthread_join(threads[core], NULL);
+  }
+
+  CHECK_EQ(check.errors, 0);
+  for (core = 0; core < TRACE_TEST_RINGS; core++) {
+	CHECK_EQ(check.next[core], TRACE_THREAD_RECORDS);
+  }
+}
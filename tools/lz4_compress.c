@@ -0,0 +1,127 @@
+/**
+ * @file lz4_compress.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief LZ4 block compression
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz4_compress.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 /**< The block ends with at least 5 literals */
+#define LZ4_MF_LIMIT 12 /**< No match starts in the last 12 bytes */
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 16
+
+struct lz4_out {
+  uint8_t *p;
+  uint8_t *end;
+};
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t lz4_hash(uint32_t v) {
+  return (v * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static int put_byte(struct lz4_out *o, uint8_t b) {
+  if (o->p >= o->end) {
+	return 0;
+  }
+  *o->p++ = b;
+  return 1;
+}
+
+/**
+ * Extended length: 255s, then the remainder
+ */
+static int put_length(struct lz4_out *o, uint32_t len) {
+  for (; len >= 255; len -= 255) {
+	if (!put_byte(o, 255)) {
+	  return 0;
+	}
+  }
+  return put_byte(o, len);
+}
+
+/**
+ * Emit one sequence: token, literals and, unless mlen is 0 (last
+ * sequence), the offset and match length
+ */
+static int put_sequence(struct lz4_out *o, const uint8_t *lit, uint32_t nlit,
+						uint32_t offset, uint32_t mlen) {
+  uint32_t mcode = mlen ? mlen - LZ4_MIN_MATCH : 0;
+  uint8_t token = ((nlit < 15 ? nlit : 15) << 4) | (mcode < 15 ? mcode : 15);
+
+  if (!put_byte(o, token)) {
+	return 0;
+  }
+  if (nlit >= 15 && !put_length(o, nlit - 15)) {
+	return 0;
+  }
+  if ((uint32_t)(o->end - o->p) < nlit) {
+	return 0;
+  }
+  memcpy(o->p, lit, nlit);
+  o->p += nlit;
+
+  if (mlen == 0) {
+	return 1;
+  }
+  if (!put_byte(o, offset & 0xFF) || !put_byte(o, offset >> 8)) {
+	return 0;
+  }
+  return mcode < 15 || put_length(o, mcode - 15);
+}
+
+/**
+ * Compress
+ * - Hash the 4 bytes at each position; the table keeps the last
+ *   position (+1, 0 = empty) seen with that hash
+ * - On a 4-byte match within 64 KiB, extend it forwards (stopping short
+ *   of the last literals), emit the pending literals and the match
+ * - Emit whatever is left as literals
+ */
+int lz4_compress(const uint8_t *src, uint32_t n, uint8_t *dst, uint32_t cap) {
+  struct lz4_out o = {dst, dst + cap};
+  uint32_t *table = calloc(1 << LZ4_HASH_LOG, sizeof(*table));
+  uint32_t anchor = 0, i = 0;
+  int ok = table != NULL;
+
+  while (ok && n > LZ4_MF_LIMIT && i < n - LZ4_MF_LIMIT) {
+	uint32_t v = read32(src + i);
+	uint32_t h = lz4_hash(v);
+	uint32_t cand = table[h];
+	uint32_t mlen;
+
+	table[h] = i + 1;
+	if (cand == 0 || i - (cand - 1) > LZ4_MAX_OFFSET ||
+		read32(src + cand - 1) != v) {
+	  i++;
+	  continue;
+	}
+	cand--;
+
+	mlen = LZ4_MIN_MATCH;
+	while (i + mlen < n - LZ4_LAST_LITERALS && src[cand + mlen] == src[i + mlen]) {
+	  mlen++;
+	}
+	ok = put_sequence(&o, src + anchor, i - anchor, i - cand, mlen);
+	i += mlen;
+	anchor = i;
+  }
+
+  ok = ok && put_sequence(&o, src + anchor, n - anchor, 0, 0);
+  free(table);
+  return ok ? (int)(o.p - dst) : -1;
+}
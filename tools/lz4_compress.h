@@ -0,0 +1,34 @@
+/**
+ * @file lz4_compress.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief LZ4 block compression (host side, see lz4.h)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Worst-case compressed size (incompressible input)
+ * @param n: input size
+ */
+#define LZ4_COMPRESS_BOUND(n) ((n) + (n) / 255 + 16)
+
+/**
+ * @brief Compress into one LZ4 block
+ * @param src: input
+ * @param n: input size
+ * @param dst: output
+ * @param cap: output size (LZ4_COMPRESS_BOUND(n) always fits)
+ * @return compressed size, or -1 if it does not fit in cap
+ *
+ * Greedy single-probe hash matcher, on par with the reference lz4
+ * default level. Follows the block
+ * format end rules (last 5 bytes literal, no match in the last 12), so
+ * the reference decompressors accept the output too.
+ */
+int lz4_compress(const uint8_t *src, uint32_t n, uint8_t *dst, uint32_t cap);
@@ -0,0 +1,93 @@
+/**
+ * @file lz4pack.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Compress a kernel image for the zboot stub (make COMPRESS=y)
+ *
+ *   lz4pack kernel8-raw.img kernel8.lz4
+ *
+ * Writes a struct lz4_image header and the LZ4 block, after checking the
+ * block decompresses back to the input with the kernel's decompressor.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz4.h"
+#include "lz4_compress.h"
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint8_t *read_file(const char *path, uint32_t *size) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *buf;
+  long n;
+
+  if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (n = ftell(f)) < 0) {
+	perror(path);
+	exit(1);
+  }
+  rewind(f);
+  buf = malloc(n ? n : 1);
+  if (buf == NULL || fread(buf, 1, n, f) != (size_t)n) {
+	perror(path);
+	exit(1);
+  }
+  fclose(f);
+  *size = n;
+  return buf;
+}
+
+int main(int argc, char **argv) {
+  uint8_t hdr[sizeof(struct lz4_image)] = {0};
+  uint8_t *raw, *comp, *check;
+  uint32_t raw_size, cap;
+  int comp_size;
+  FILE *out;
+
+  if (argc != 3) {
+	fprintf(stderr, "usage: %s <image> <image.lz4>\n", argv[0]);
+	return 2;
+  }
+
+  raw = read_file(argv[1], &raw_size);
+  cap = LZ4_COMPRESS_BOUND(raw_size);
+  comp = malloc(cap);
+  check = malloc(raw_size ? raw_size : 1);
+  if (comp == NULL || check == NULL) {
+	perror("malloc");
+	return 1;
+  }
+
+  comp_size = lz4_compress(raw, raw_size, comp, cap);
+  if (comp_size < 0 ||
+	  lz4_decompress(comp, comp_size, check, raw_size) != (int)raw_size ||
+	  memcmp(raw, check, raw_size) != 0) {
+	fprintf(stderr, "%s: compression self-check failed\n", argv[1]);
+	return 1;
+  }
+
+  put_le32(hdr + 0, LZ4_IMAGE_MAGIC);
+  put_le32(hdr + 4, raw_size);
+  put_le32(hdr + 8, comp_size);
+
+  out = fopen(argv[2], "wb");
+  if (out == NULL || fwrite(hdr, 1, sizeof(hdr), out) != sizeof(hdr) ||
+	  fwrite(comp, 1, comp_size, out) != (size_t)comp_size || fclose(out) != 0) {
+	perror(argv[2]);
+	return 1;
+  }
+
+  printf("lz4pack: %s %u -> %d bytes (%u%%)\n", argv[1], raw_size, comp_size,
+		 raw_size ? (unsigned)(100ULL * comp_size / raw_size) : 0);
+  return 0;
+}
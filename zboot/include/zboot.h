@@ -0,0 +1,41 @@
+/**
+ * @file zboot.h
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Compressed kernel stub memory layout (make COMPRESS=y)
+ *
+ * kernel8.img is the stub followed by the compressed kernel (lz4.h).
+ * The firmware loads it at ZBOOT_KERNEL_ADDR; the stub moves itself and
+ * the payload up to ZBOOT_BASE, unpacks the kernel into place with the
+ * caches on and runs it.
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#pragma once
+
+#define ZBOOT_KERNEL_ADDR 0x80000 /**< Where the kernel is linked */
+#define ZBOOT_BASE 0x4000000 /**< Where the stub runs (64 MiB) */
+#define ZBOOT_MAX_SIZE (ZBOOT_BASE - ZBOOT_KERNEL_ADDR)
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+/**
+ * @brief Build the EL2 identity map (zboot.c)
+ * @return level 1 table address, for TTBR0_EL2
+ *
+ * The first GiB in 2 MiB blocks: RAM write-back cacheable, the
+ * peripherals (RPi 3) device memory
+ */
+u64 zboot_map();
+
+/**
+ * @brief Unpack the kernel to ZBOOT_KERNEL_ADDR (zboot.c)
+ * @return size of the kernel, or 0 if the payload is corrupt
+ */
+u32 zboot_main();
+
+#endif
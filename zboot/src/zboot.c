@@ -0,0 +1,55 @@
+/**
+ * @file zboot.c
+ * @author Jose Pires
+ * @date 2024-10-18
+ *
+ * @brief Compressed kernel stub (see zboot.h, head.S)
+ *
+ * @copyright Jose Pires 2024
+ */
+
+#include "zboot.h"
+#include "lz4.h"
+#include "mmu.h"
+#include "peripherals/base.h"
+
+extern const u8 zboot_payload[]; /**< payload.S */
+
+static u64 __attribute__((aligned(PAGE_SIZE))) zboot_l1[MM_ENTRIES];
+static u64 __attribute__((aligned(PAGE_SIZE))) zboot_l2[MM_ENTRIES];
+
+/**
+ * Identity map the first GiB
+ * - Level 1 entry 0 -> level 2 table, the other GiBs stay unmapped
+ * - Level 2: 2 MiB blocks, device memory from the peripheral base up
+ */
+u64 zboot_map() {
+  u64 i, addr;
+
+  for (i = 0; i < MM_ENTRIES; i++) {
+	addr = i << MM_L2_SHIFT;
+	zboot_l2[i] = addr | (addr >= PBASE ? MMU_FLAGS_DEVICE :
+						MMU_FLAGS_NORMAL);
+	zboot_l1[i] = 0;
+  }
+  zboot_l1[0] = (u64)zboot_l2 | MM_TYPE_TABLE;
+  return (u64)zboot_l1;
+}
+
+/**
+ * Unpack
+ * - Check the header lz4pack wrote
+ * - Decompress straight to the kernel's link address; the size must
+ *   match exactly
+ */
+u32 zboot_main() {
+  const struct lz4_image *hdr = (const struct lz4_image *)zboot_payload;
+  int n;
+
+  if (hdr->magic != LZ4_IMAGE_MAGIC || hdr->raw_size > ZBOOT_MAX_SIZE) {
+	return 0;
+  }
+  n = lz4_decompress(zboot_payload + sizeof(*hdr), hdr->comp_size,
+					 (u8 *)ZBOOT_KERNEL_ADDR, ZBOOT_MAX_SIZE);
+  return n == (int)hdr->raw_size ? n : 0;
+}